@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <new>
+
+namespace cov {
+	/*
+	 * Bump allocator over large blocks.
+	 * Memory is only released as a whole by reset()/clear(), pointers stay valid until then.
+	 * Only trivially destructible objects may be placed in an arena.
+	 */
+	class arena final {
+		struct block {
+			std::unique_ptr<unsigned char[]> data;
+			std::size_t size;
+		};
+		// Blocks [0, _in_use) hold live allocations, the last one of them is being filled
+		std::vector<block> _blocks;
+		std::size_t _in_use = 0, _used = 0, _block_size;
+		void *bump(std::size_t n, std::size_t align) noexcept
+		{
+			block &b = _blocks[_in_use - 1];
+			auto base = reinterpret_cast<std::uintptr_t>(b.data.get());
+			std::size_t pos = ((base + _used + align - 1) & ~static_cast<std::uintptr_t>(align - 1)) - base;
+			if (pos + n > b.size)
+				return nullptr;
+			_used = pos + n;
+			return b.data.get() + pos;
+		}
+		void next_block(std::size_t n)
+		{
+			_used = 0;
+			// Prefer a block retained by reset()
+			for (std::size_t i = _in_use; i < _blocks.size(); ++i) {
+				if (_blocks[i].size >= n) {
+					std::swap(_blocks[i], _blocks[_in_use++]);
+					return;
+				}
+			}
+			std::size_t size = n > _block_size ? n : _block_size;
+			_blocks.insert(_blocks.begin() + _in_use++, block{std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+		}
+	public:
+		explicit arena(std::size_t block_size = 64 * 1024) : _block_size(block_size) {}
+		arena(const arena &) = delete;
+		arena(arena &&) noexcept = default;
+		arena &operator=(const arena &) = delete;
+		arena &operator=(arena &&) noexcept = default;
+		void *allocate(std::size_t n, std::size_t align = alignof(std::max_align_t))
+		{
+			if (_in_use > 0) {
+				if (void *ptr = bump(n, align))
+					return ptr;
+			}
+			next_block(n + align);
+			return bump(n, align);
+		}
+		template<typename T, typename... ArgsT>
+		T *make(ArgsT &&...args)
+		{
+			return new (allocate(sizeof(T), alignof(T))) T(std::forward<ArgsT>(args)...);
+		}
+		template<typename T>
+		T *make_array(std::size_t n)
+		{
+			return static_cast<T *>(allocate(sizeof(T) * n, alignof(T)));
+		}
+		std::string_view store(std::string_view str)
+		{
+			if (str.empty())
+				return std::string_view();
+			char *ptr = static_cast<char *>(allocate(str.size(), 1));
+			std::memcpy(ptr, str.data(), str.size());
+			return std::string_view(ptr, str.size());
+		}
+		// Forget all allocations but keep the blocks for reuse
+		void reset() noexcept
+		{
+			_in_use = 0;
+			_used = 0;
+		}
+		// Release all blocks
+		void clear() noexcept
+		{
+			_blocks.clear();
+			_in_use = 0;
+			_used = 0;
+		}
+		std::size_t capacity() const noexcept
+		{
+			std::size_t n = 0;
+			for (auto &b : _blocks)
+				n += b.size;
+			return n;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "cminus.hpp"
+#include "cminus_parser.hpp"
+#include "parse_driver.hpp"
+
+int main(int argc, const char *argv[])
+{
+	return cov::parse_main<cmcc::lexer, cmcc::parser>({"cparse", ".c-"}, argc, argv);
+}
\ No newline at end of file
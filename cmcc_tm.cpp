@@ -0,0 +1,123 @@
+#include "cminus.hpp"
+#include "cminus_parser.hpp"
+#include "cminus_codegen.hpp"
+#include "tm_machine.hpp"
+#include "parse_driver.hpp"
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+
+/*
+ * Compiles a C- program to TM code and runs it on the simulator, input() takes integers from the input file or stdin.
+ * A .tm file in the text format of the reference simulator is run as it is.
+ * With -s the TM code is printed instead of running it.
+ * With -c the run is counted: executed instructions, nominal cycles and the instructions of every opcode.
+ */
+
+static bool read_file(const std::string &path, std::string &text)
+{
+	std::ifstream ifs(path, std::ios::binary);
+	if (!ifs)
+		return false;
+	text.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	return true;
+}
+
+int main(int argc, const char *argv[])
+{
+	bool show = false, count = false, usage = false;
+	std::size_t words = 1 << 20;
+	std::string path, input_path;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (arg == "-s")
+			show = true;
+		else if (arg == "-c")
+			count = true;
+		else if (arg == "-m" && i + 1 < argc)
+			words = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+		else if (arg == "-i" && i + 1 < argc)
+			input_path = argv[++i];
+		else if ((arg.size() > 1 && arg[0] == '-') || !path.empty())
+			usage = true;
+		else
+			path = arg;
+	}
+	// Checking CLI input
+	if (usage || path.empty()) {
+		std::cout << "Usage: ctm [-s] [-c] [-m <WORDS>] [-i <INPUT>] <PROGRAM>.c-|<PROGRAM>.tm" << std::endl;
+		return -1;
+	}
+	std::vector<cov::tm_instruction> code;
+	if (path.size() > 3 && path.compare(path.size() - 3, 3, ".tm") == 0) {
+		std::string text, error;
+		if (!read_file(path, text)) {
+			std::cout << "Cannot open input file: " << path << std::endl;
+			return -1;
+		}
+		if (!cov::tm_read(text, code, error)) {
+			std::cout << error << std::endl;
+			return -1;
+		}
+		if (show)
+			cov::tm_write(std::cout, code);
+	}
+	else {
+		cmcc::lexer lex;
+		if (!lex.lex_file(path)) {
+			std::cout << "Cannot open input file: " << path << std::endl;
+			return -1;
+		}
+		cmcc::parser parser;
+		if (!parser.parse(lex) || !lex.get_errors().empty()) {
+			cov::print_errors(std::cout, lex, parser);
+			return -1;
+		}
+		cmcc::codegen gen;
+		if (!gen.generate(lex, parser)) {
+			for (auto &e : gen.get_errors())
+				cov::print_caret(std::cout, lex.get_source(), e.line, e.pos, e.offset, std::string(cmcc::codegen::get_error(e.type)) + " \"" + e.text + "\"");
+			return -1;
+		}
+		if (show)
+			gen.write(std::cout);
+		code = gen.get_code();
+	}
+	if (show)
+		return 0;
+	std::string input;
+	if (!input_path.empty() && !read_file(input_path, input)) {
+		std::cout << "Cannot open input file: " << input_path << std::endl;
+		return -1;
+	}
+	cov::tm_machine machine(words);
+	machine.load(code);
+	cov::tm_machine::status status;
+	double time = 0;
+	{
+		// Stdin is only read once the program calls input()
+		cov::io_buffer io = input_path.empty() ? cov::io_buffer(stdin, stdout) : cov::io_buffer(input, stdout);
+		time = cov::best_time(1, [&] {
+			status = machine.run(io, count);
+		});
+	}
+	if (count) {
+		// Executions and cycles per opcode
+		std::uint64_t ops[17] = {}, cycles = 0;
+		for (std::size_t i = 0; i < code.size() && i < machine.get_counts().size(); ++i) {
+			ops[static_cast<std::size_t>(code[i].op)] += machine.get_counts()[i];
+			cycles += machine.get_counts()[i] * cov::tm_machine::get_cost(code[i].op);
+		}
+		std::cout << code.size() << " instructions, " << machine.get_steps() << " steps, " << cycles << " cycles" << std::endl;
+		for (std::size_t op = 0; op < std::size(ops); ++op) {
+			if (ops[op] > 0)
+				std::cout << "  " << cov::tm_op_name(static_cast<cov::tm_op>(op)) << ": " << ops[op] << std::endl;
+		}
+		std::cout << "Run Time: " << time * 1e3 << " ms, " << machine.get_steps() / time / 1e6 << " M steps/s" << std::endl;
+	}
+	if (status != cov::tm_machine::status::halted) {
+		std::cout << "Runtime Error: " << cov::tm_machine::get_error(status) << std::endl;
+		return -1;
+	}
+	return 0;
+}
\ No newline at end of file
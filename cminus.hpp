@@ -1,202 +1,195 @@
 #pragma once
 
+#include "mapped_file.hpp"
+#include "line_index.hpp"
+#include "symbol_pool.hpp"
+#include "thread_pool.hpp"
+#include "token_cache.hpp"
+#include <string_view>
+#include <iterator>
+#include <cstdint>
+#include <fstream>
 #include <string>
 #include <vector>
 
 namespace cmcc {
-	enum class action_type {
+	enum class action_type : unsigned char {
 		_null, _if, _else, _return, _while,
 		_int, _void
 	};
 
-	enum class signal_type {
+	enum class signal_type : unsigned char {
 		_null, _expect, _annotation, _add, _sub, _mul, _div,
         _und, _ueq, _abo, _aeq, _equ, _neq, _asi, _com,
         _sem, _slb, _srb, _mlb, _mrb, _llb, _lrb,
 	};
 
-	enum class token_type {
+	enum class token_type : unsigned char {
 		_null, _action, _signal, _literal, _identifier
 	};
 
-	enum class literal_type {
+	enum class literal_type : unsigned char {
 		_null, _number
 	};
 
-	action_type get_action(const std::string &);
+	action_type get_action(std::string_view);
 
-	signal_type get_signal(const std::string &);
+	signal_type get_signal(std::string_view);
 
-	class token_base {
-		std::size_t _line = 0, _pos = 0;
-	public:
-		token_base() = default;
-		token_base(std::size_t l, std::size_t p) : _line(l), _pos(p) {}
-		virtual ~token_base() = default;
-		virtual token_type get_type() const noexcept
-		{
-			return token_type::_null;
-		}
-		virtual std::string to_string() const = 0;
-		inline std::size_t get_line() const noexcept
-		{
-			return _line;
-		}
-		inline std::size_t get_pos() const noexcept
-		{
-			return _pos;
-		}
+	/*
+	 * Compact token record of 16 bytes, the text is referenced by its byte range in the lexed source (up to 4 GiB).
+	 * Lines and columns are looked up in the line index of the source only when they are asked for.
+	 */
+	struct token {
+		token_type type = token_type::_null;
+		// action_type, signal_type or literal_type depending on type
+		unsigned char subtype = 0;
+		// Interned text of identifiers and literals
+		std::uint32_t symbol = 0;
+		std::uint32_t offset = 0, length = 0;
 	};
 
-	class token_action final : public token_base {
-		action_type _type = action_type::_null;
+	// Accessors of a token together with its source text and symbols
+	class token_view final {
+		const token *_tok = nullptr;
+		std::string_view _src;
+		const cov::symbol_pool *_sym = nullptr;
+		const cov::line_index *_lines = nullptr;
 	public:
-		token_action(action_type t, std::size_t l, std::size_t p) : token_base(l, p), _type(t) {}
-		std::string to_string() const override
-		{
-			switch (_type) {
-			case action_type::_if:
-				return "reserved word: if";
-			case action_type::_else:
-				return "reserved word: else";
-			case action_type::_return:
-				return "reserved word: return";
-			case action_type::_while:
-				return "reserved word: while";
-			case action_type::_int:
-				return "reserved word: int";
-			case action_type::_void:
-				return "reserved word: void";
-			}
-		}
-		token_type get_type() const noexcept override
+		token_view() = default;
+		token_view(const token &t, std::string_view src, const cov::symbol_pool &sym, const cov::line_index &lines) : _tok(&t), _src(src), _sym(&sym), _lines(&lines) {}
+		inline token_type get_type() const noexcept
 		{
-			return token_type::_action;
+			return _tok->type;
 		}
 		inline action_type get_action() const noexcept
 		{
-			return _type;
+			return static_cast<action_type>(_tok->subtype);
 		}
-	};
-
-	class token_signal final : public token_base {
-		signal_type _type = signal_type::_null;
-	public:
-		token_signal(signal_type t, std::size_t l, std::size_t p) : token_base(l, p), _type(t) {}
-		std::string to_string() const override
-		{
-			switch (_type) {
-			case signal_type::_add:
-				return "+";
-			case signal_type::_sub:
-				return "-";
-			case signal_type::_mul:
-				return "*";
-			case signal_type::_div:
-				return "/";
-			case signal_type::_und:
-				return "<";
-			case signal_type::_ueq:
-				return "<=";
-			case signal_type::_abo:
-				return ">";
-			case signal_type::_aeq:
-				return ">=";
-			case signal_type::_equ:
-				return "==";
-			case signal_type::_neq:
-				return "~=";
-            case signal_type::_asi:
-				return "=";
-            case signal_type::_sem:
-				return ";";
-            case signal_type::_com:
-				return ",";
-            case signal_type::_slb:
-				return "(";
-            case signal_type::_srb:
-				return ")";
-            case signal_type::_mlb:
-				return "[";
-            case signal_type::_mrb:
-				return "]";
-            case signal_type::_llb:
-				return "{";
-            case signal_type::_lrb:
-				return "}";
-			}
+		inline signal_type get_signal() const noexcept
+		{
+			return static_cast<signal_type>(_tok->subtype);
 		}
-		token_type get_type() const noexcept override
+		inline literal_type get_lit_type() const noexcept
 		{
-			return token_type::_signal;
+			return static_cast<literal_type>(_tok->subtype);
 		}
-		inline signal_type get_signal() const noexcept
+		inline std::string_view get_text() const noexcept
 		{
-			return _type;
+			return _src.substr(_tok->offset, _tok->length);
 		}
-	};
-
-	class token_literal final : public token_base {
-		literal_type _type = literal_type::_number;
-		std::string _lit;
-	public:
-		token_literal(literal_type t, std::string lit, std::size_t l, std::size_t p) : token_base(l, p), _type(t), _lit(std::move(lit)) {}
-		token_type get_type() const noexcept override
+		inline std::uint32_t get_symbol() const noexcept
 		{
-			return token_type::_literal;
+			return _tok->symbol;
 		}
-		std::string to_string() const override
+		inline std::string_view get_id() const noexcept
 		{
-			return std::string("NUM, val = ") + _lit;
+			return _sym->get(_tok->symbol);
 		}
-		inline const std::string &get_literal() const noexcept
+		inline std::string_view get_literal() const noexcept
 		{
-			return _lit;
+			return _sym->get(_tok->symbol);
 		}
-		inline literal_type get_lit_type() const noexcept
+		// 0-based line of the token
+		inline std::size_t get_line() const
 		{
-			return _type;
+			return _lines->line(_tok->offset);
 		}
-	};
-
-	class token_identifier final : public token_base {
-		std::string _id;
-	public:
-		token_identifier(std::string id, std::size_t l, std::size_t p) : token_base(l, p), _id(std::move(id)) {}
-		token_type get_type() const noexcept override
+		// Column of the last character counting from 1, tokens never span lines
+		inline std::size_t get_pos() const
+		{
+			return _lines->column(_tok->offset + _tok->length);
+		}
+		inline std::size_t get_offset() const noexcept
 		{
-			return token_type::_identifier;
+			return _tok->offset;
 		}
-		std::string to_string() const override
+		inline std::size_t get_length() const noexcept
 		{
-			return std::string("ID, name = ") + _id;
+			return _tok->length;
 		}
-		inline const std::string &get_id() const noexcept
+		// Identifiers and literals carry an interned symbol
+		inline bool has_symbol() const noexcept
 		{
-			return _id;
+			return _tok->type == token_type::_literal || _tok->type == token_type::_identifier;
 		}
+		// Fixed part of to_string(), followed by the symbol text when has_symbol()
+		std::string_view get_label() const noexcept;
+		std::string to_string() const;
 	};
 
+	class token_range;
+
 	class lexer final {
-		std::vector<token_base *> results;
-		std::string last_buffer, buffer;
-		std::size_t line = 0, pos = 0;
-		token_base *result = nullptr;
 	public:
 		enum class state : unsigned char {
 			unexpected_character = 0b1001, incomplete_signal = 0b1010, unexpected_signal = 0b1011,
 			ready = 0b0000, output = 0b0001, incom = 0b0010, expcom = 0b0011, insig = 0b0100, inlit = 0b0101, inidn = 0b0110
 		};
+		// Errors recovered while lexing a whole buffer
+		struct error_info {
+			state type;
+			std::string text;
+			// Line counting from 0 and column counting from 1 of the offending character
+			std::size_t line, pos;
+			// Offset of the offending character in the source
+			std::size_t offset;
+			// Number of tokens produced before the error
+			std::size_t index;
+		};
+		// Result of edit(): tokens [first, first + inserted) replace the old [first, first + removed), later tokens were shifted
+		struct token_change {
+			std::size_t first, removed, inserted;
+		};
 	private:
+		std::vector<token> results;
+		std::vector<error_info> errors;
+		std::string last_buffer, buffer;
+		// Characters consumed by read_next, the end of the source after whole-buffer lexing
+		std::size_t offset = 0;
 		state _s = state::ready;
+		// Characters consumed by read_next, token offsets refer to it in that mode
+		std::string feed;
+		cov::symbol_pool symbols;
+		// Whole-buffer lexing
+		cov::mapped_file file;
+		std::string_view source;
+		std::size_t start = 0;
+		// Line starts of source, only scanned for once positions are needed
+		cov::line_index lines;
+		// Tokens used in place from a cache file instead of results
+		cov::token_cache cache;
+		cov::span<const token> cached;
+		// Owned copy of the source once it has been edited
+		std::string edited;
+		// Pull-based lexing: the current block behind the text of a token crossing into it
+		std::ifstream stream_file;
+		std::istream *stream = nullptr;
+		std::string window;
+		std::size_t block_size = 0, cursor = 0;
+		std::uint64_t base = 0;
+		void push(token_type, unsigned char, std::size_t, std::size_t, std::uint32_t = 0);
+		void error(state, std::string, std::size_t);
+		void locate_errors();
+		bool flush(std::size_t);
+		void reset(std::string_view);
+		void run(std::size_t, std::size_t);
+		void finish();
+		bool refill();
+		// A line end read as a blank or inside a comment, not one ending a token or consumed by an error
+		inline bool at_line_start() const
+		{
+			return offset == 0 || (source[offset - 1] == '\n' && !error_state() && _s != state::output);
+		}
 	public:
-		inline std::size_t get_line() const noexcept
+		// Position of the last character read, the column counting from 1 as for the errors of lex()
+		inline std::size_t get_line() const
 		{
-			return line;
+			return at_line_start() ? lines.line(offset) : lines.line(offset - 1);
 		}
-		inline std::size_t get_pos() const noexcept
+		inline std::size_t get_pos() const
 		{
-			return pos;
+			return at_line_start() ? 0 : lines.column(offset - 1) + 1;
 		}
 		inline state get_state() const noexcept
 		{
@@ -213,26 +206,149 @@ namespace cmcc {
 			else
 				return buffer;
 		}
-		const char *get_error() const noexcept;
+		static const char *get_error(state) noexcept;
+		inline const char *get_error() const noexcept
+		{
+			return get_error(_s);
+		}
 		void reset_status()
 		{
 			_s = state::ready;
 			buffer.clear();
 		}
-		inline token_base * get_output() noexcept
+		// Views are invalidated by further input
+		inline token_view view(const token &t) const noexcept
+		{
+			return token_view(t, source, symbols, lines);
+		}
+		inline const cov::line_index &get_lines() const noexcept
+		{
+			return lines;
+		}
+		inline token_view get_output() noexcept
 		{
 			if (_s == state::output)
 				_s = state::ready;
-			return results.back();
+			return view(results.back());
+		}
+		inline cov::span<const token> get_results() const noexcept
+		{
+			return cache.is_open() ? cached : cov::span<const token>(results);
+		}
+		inline const std::vector<error_info> & get_errors() const noexcept
+		{
+			return errors;
+		}
+		inline const cov::symbol_pool &get_symbols() const noexcept
+		{
+			return symbols;
 		}
-		inline const std::vector<token_base *> & get_results() const noexcept
+		inline std::string_view get_source() const noexcept
 		{
-			return results;
+			return source;
 		}
 		inline void clear_output() noexcept
 		{
 			results.clear();
+			errors.clear();
+			cache.close();
 		}
+		// Character-feeding interface, the caller must feed the same character again with next = false after an output
 		state read_next(char, bool = true);
+		// Lex a whole buffer, the buffer must outlive the tokens
+		void lex(std::string_view);
+		/*
+		 * Same result as lex(), for large buffers: newline-aligned chunks are lexed speculatively on the pool,
+		 * both from the ready state and from inside a comment, then stitched together in order.
+		 * chunk_size = 0 picks a size from the buffer size and the number of workers.
+		 */
+		void lex(std::string_view, cov::thread_pool &, std::size_t chunk_size = 0);
+		/*
+		 * Whole-buffer lexing in steps for pipelines: lex_begin(), then lex_more() until it returns false.
+		 * Every call lexes up to the given number of bytes further and appends to get_results(), the end result is that of lex().
+		 */
+		void lex_begin(std::string_view);
+		bool lex_more(std::size_t);
+		// Lex a file through a read-only mapping owned by the lexer
+		bool lex_file(const std::string &);
+		bool lex_file(const std::string &, cov::thread_pool &);
+		/*
+		 * Like lex_file(), but tokens are taken from <path>.tkc when it was written for the same content,
+		 * otherwise the file is lexed and the cache (re)written. A hit maps the tokens in place,
+		 * only symbols and errors are copied.
+		 */
+		bool lex_cached(const std::string &);
+		/*
+		 * Replace removed characters at offset with inserted and re-lex incrementally: lexing restarts at the last token
+		 * before the edit and stops as soon as it is back in step with the old token stream, which is then only shifted.
+		 * The first edit copies the source into the lexer. Symbol ids of kept tokens stay valid, the pool is never compacted.
+		 */
+		token_change edit(std::size_t offset, std::size_t removed, std::string_view inserted);
+		/*
+		 * Pull-based lexing of a stream read in blocks of block_size bytes, next_token() hands out one token at a time.
+		 * Only the tokens of the current block and the text of a token crossing its end are kept, so memory is bounded
+		 * by the block size, the longest token and the distinct symbols whatever the size of the input.
+		 * Offsets are relative to get_source(), the current block, which starts at get_base() in the stream.
+		 * get_errors() holds the errors of the current block, their index counts its tokens.
+		 */
+		bool open_stream(const std::string &, std::size_t block_size = 64 * 1024);
+		void open_stream(std::istream &, std::size_t block_size = 64 * 1024);
+		// Next token, nullptr at the end of input, valid until the next call; walks get_results() after lex()
+		const token *next_token();
+		inline std::uint64_t get_base() const noexcept
+		{
+			return base;
+		}
+		// Single pass over next_token() for range-for
+		token_range tokens() noexcept;
 	};
+
+	// Input range of the tokens still to come from lexer::next_token(), views are invalidated by advancing
+	class token_range final {
+		lexer *lex;
+	public:
+		class iterator final {
+			lexer *lex = nullptr;
+			const token *cur = nullptr;
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = token_view;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = token_view;
+			iterator() = default;
+			iterator(lexer *l, const token *t) : lex(l), cur(t) {}
+			inline token_view operator*() const noexcept
+			{
+				return lex->view(*cur);
+			}
+			inline iterator &operator++()
+			{
+				cur = lex->next_token();
+				return *this;
+			}
+			inline bool operator==(const iterator &other) const noexcept
+			{
+				return cur == other.cur;
+			}
+			inline bool operator!=(const iterator &other) const noexcept
+			{
+				return cur != other.cur;
+			}
+		};
+		explicit token_range(lexer &l) noexcept : lex(&l) {}
+		inline iterator begin()
+		{
+			return iterator(lex, lex->next_token());
+		}
+		inline iterator end() noexcept
+		{
+			return iterator(lex, nullptr);
+		}
+	};
+
+	inline token_range lexer::tokens() noexcept
+	{
+		return token_range(*this);
+	}
 }
\ No newline at end of file
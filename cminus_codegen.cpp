@@ -0,0 +1,552 @@
+#include "cminus_codegen.hpp"
+#include <algorithm>
+
+namespace cmcc {
+	using cov::tm_op;
+
+	// Registers of the generated code
+	constexpr int ac = 0, ac1 = 1, sp = 4, zero = 5, fp = 6, pc = 7;
+
+	const char *codegen::get_error(error_type type) noexcept
+	{
+		switch (type) {
+		case error_type::undeclared:
+			return "未声明的标识符";
+		case error_type::redeclared:
+			return "重复声明的标识符";
+		case error_type::type_mismatch:
+			return "类型不匹配";
+		case error_type::argument_count:
+			return "参数个数不匹配";
+		case error_type::missing_main:
+			return "缺少main函数";
+		}
+		return "无错误";
+	}
+
+	void codegen::error(error_type type, std::uint32_t node)
+	{
+		error_info e{type, "main", 0, 1, 0};
+		if (node != npos) {
+			// Declarations start with their type, the name follows
+			std::size_t index = tree->token[node];
+			switch (tree->kind[node]) {
+			case node_kind::_var_decl:
+			case node_kind::_array_decl:
+			case node_kind::_fun_decl:
+			case node_kind::_param:
+			case node_kind::_array_param:
+				if (index + 1 < tokens.size())
+					++index;
+				break;
+			default:
+				break;
+			}
+			const token &t = tokens[index];
+			e.text = source.substr(t.offset, t.length);
+			lines.locate(t.offset + t.length, e.line, e.pos);
+			e.offset = t.offset + t.length - 1;
+		}
+		else if (!tokens.empty()) {
+			const token &t = tokens[tokens.size() - 1];
+			lines.locate(t.offset + t.length, e.line, e.pos);
+			++e.pos;
+			e.offset = t.offset + t.length;
+		}
+		errors.push_back(std::move(e));
+	}
+
+	std::size_t codegen::emit(tm_op op, int r, int s, int t, std::int32_t d, const char *comment)
+	{
+		code.push_back(cov::tm_instruction{op, static_cast<unsigned char>(r), static_cast<unsigned char>(s), static_cast<unsigned char>(t), d});
+		comments.push_back(comment);
+		return code.size() - 1;
+	}
+
+	std::size_t codegen::emit_ro(tm_op op, int r, int s, int t, const char *comment)
+	{
+		return emit(op, r, s, t, 0, comment);
+	}
+
+	std::size_t codegen::emit_rm(tm_op op, int r, std::int32_t d, int s, const char *comment)
+	{
+		return emit(op, r, s, 0, d, comment);
+	}
+
+	// Point a forward jump relative to pc at the next instruction
+	void codegen::patch_jump(std::size_t at)
+	{
+		code[at].d = static_cast<std::int32_t>(code.size() - (at + 1));
+	}
+
+	std::uint32_t codegen::declare(entry_kind kind, std::uint32_t node, std::int32_t address, std::int32_t size)
+	{
+		std::uint32_t symbol = tree->value[node];
+		if (symbol >= binding.size())
+			return npos;
+		std::uint32_t prev = binding[symbol];
+		if (prev != npos && prev >= scopes.back())
+			error(error_type::redeclared, node);
+		entries.push_back(entry{kind, scopes.size() == 1, address, size, -1, symbol, prev});
+		binding[symbol] = static_cast<std::uint32_t>(entries.size() - 1);
+		return binding[symbol];
+	}
+
+	const codegen::entry *codegen::lookup(std::uint32_t node)
+	{
+		std::uint32_t symbol = tree->value[node];
+		if (symbol < binding.size() && binding[symbol] != npos)
+			return &entries[binding[symbol]];
+		error(error_type::undeclared, node);
+		return nullptr;
+	}
+
+	void codegen::enter_scope()
+	{
+		scopes.push_back(entries.size());
+	}
+
+	void codegen::leave_scope()
+	{
+		for (std::size_t i = entries.size(); i > scopes.back(); --i)
+			binding[entries[i - 1].symbol] = entries[i - 1].shadowed;
+		entries.resize(scopes.back());
+		scopes.pop_back();
+	}
+
+	void codegen::push()
+	{
+		emit_rm(tm_op::_st, ac, 0, sp, "push");
+		emit_rm(tm_op::_lda, sp, -1, sp, nullptr);
+	}
+
+	void codegen::pop(int reg)
+	{
+		emit_rm(tm_op::_lda, sp, 1, sp, "pop");
+		emit_rm(tm_op::_ld, reg, 0, sp, nullptr);
+	}
+
+	// Operands loaded with a single instruction, no need to save the other one
+	bool codegen::simple(std::uint32_t node)
+	{
+		if (tree->kind[node] == node_kind::_const)
+			return true;
+		if (tree->kind[node] != node_kind::_var)
+			return false;
+		std::uint32_t symbol = tree->value[node];
+		return symbol < binding.size() && binding[symbol] != npos && entries[binding[symbol]].kind == entry_kind::_var;
+	}
+
+	void codegen::load_simple(int reg, std::uint32_t node)
+	{
+		if (tree->kind[node] == node_kind::_const) {
+			emit_rm(tm_op::_ldc, reg, static_cast<std::int32_t>(tree->value[node]), 0, "load const");
+			return;
+		}
+		const entry &e = entries[binding[tree->value[node]]];
+		if (e.global)
+			emit_rm(tm_op::_ld, reg, e.address, zero, "load global");
+		else
+			emit_rm(tm_op::_ld, reg, -e.address, fp, "load local");
+	}
+
+	void codegen::array_base(int reg, const entry &e)
+	{
+		if (e.kind == entry_kind::_array_param)
+			emit_rm(tm_op::_ld, reg, -e.address, fp, "load array param");
+		else if (e.global)
+			emit_rm(tm_op::_lda, reg, e.address, zero, "global array");
+		else
+			emit_rm(tm_op::_lda, reg, -e.address, fp, "local array");
+	}
+
+	// Both operands of a binary operation, the register holding the left one is returned, the other holds the right one
+	int codegen::operands(std::uint32_t node)
+	{
+		std::uint32_t lhs = tree->child(node, 0), rhs = tree->child(node, 1);
+		expression(lhs);
+		if (simple(rhs)) {
+			load_simple(ac1, rhs);
+			return ac;
+		}
+		push();
+		expression(rhs);
+		pop(ac1);
+		return ac1;
+	}
+
+	// Jump taken by a relation, read from the difference of the operands
+	static tm_op relation_jump(unsigned char sig, bool negate)
+	{
+		switch (static_cast<signal_type>(sig)) {
+		case signal_type::_und:
+			return negate ? tm_op::_jge : tm_op::_jlt;
+		case signal_type::_ueq:
+			return negate ? tm_op::_jgt : tm_op::_jle;
+		case signal_type::_abo:
+			return negate ? tm_op::_jle : tm_op::_jgt;
+		case signal_type::_aeq:
+			return negate ? tm_op::_jlt : tm_op::_jge;
+		case signal_type::_equ:
+			return negate ? tm_op::_jne : tm_op::_jeq;
+		default:
+			return negate ? tm_op::_jeq : tm_op::_jne;
+		}
+	}
+
+	static bool is_relation(unsigned char sig)
+	{
+		switch (static_cast<signal_type>(sig)) {
+		case signal_type::_und:
+		case signal_type::_ueq:
+		case signal_type::_abo:
+		case signal_type::_aeq:
+		case signal_type::_equ:
+		case signal_type::_neq:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void codegen::expression(std::uint32_t node)
+	{
+		if (node == npos)
+			return;
+		switch (tree->kind[node]) {
+		case node_kind::_const:
+			load_simple(ac, node);
+			break;
+		case node_kind::_var: {
+			const entry *e = lookup(node);
+			if (e == nullptr)
+				break;
+			if (e->kind != entry_kind::_var)
+				error(error_type::type_mismatch, node);
+			else
+				load_simple(ac, node);
+			break;
+		}
+		case node_kind::_index:
+			index_address(node);
+			emit_rm(tm_op::_ld, ac, 0, ac, "load element");
+			break;
+		case node_kind::_call:
+			call(node);
+			break;
+		case node_kind::_assign: {
+			std::uint32_t lhs = tree->child(node, 0), rhs = tree->child(node, 1);
+			if (tree->kind[lhs] == node_kind::_index) {
+				index_address(lhs);
+				push();
+				expression(rhs);
+				pop(ac1);
+				emit_rm(tm_op::_st, ac, 0, ac1, "assign element");
+				break;
+			}
+			const entry *e = lookup(lhs);
+			expression(rhs);
+			if (e == nullptr)
+				break;
+			if (e->kind != entry_kind::_var)
+				error(error_type::type_mismatch, lhs);
+			else if (e->global)
+				emit_rm(tm_op::_st, ac, e->address, zero, "assign global");
+			else
+				emit_rm(tm_op::_st, ac, -e->address, fp, "assign local");
+			break;
+		}
+		case node_kind::_op: {
+			unsigned char sig = tree->subtype[node];
+			int lhs = operands(node), rhs = lhs == ac ? ac1 : ac;
+			switch (static_cast<signal_type>(sig)) {
+			case signal_type::_add:
+				emit_ro(tm_op::_add, ac, lhs, rhs, "op +");
+				break;
+			case signal_type::_sub:
+				emit_ro(tm_op::_sub, ac, lhs, rhs, "op -");
+				break;
+			case signal_type::_mul:
+				emit_ro(tm_op::_mul, ac, lhs, rhs, "op *");
+				break;
+			case signal_type::_div:
+				emit_ro(tm_op::_div, ac, lhs, rhs, "op /");
+				break;
+			default:
+				// 1 if the relation holds, 0 otherwise
+				emit_ro(tm_op::_sub, ac, lhs, rhs, "compare");
+				emit_rm(relation_jump(sig, false), ac, 2, pc, "true case");
+				emit_rm(tm_op::_ldc, ac, 0, 0, "false");
+				emit_rm(tm_op::_lda, pc, 1, pc, "skip true");
+				emit_rm(tm_op::_ldc, ac, 1, 0, "true");
+				break;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	// Address of an element in ac
+	void codegen::index_address(std::uint32_t node)
+	{
+		const entry *e = lookup(node);
+		expression(tree->child(node, 0));
+		if (e == nullptr)
+			return;
+		if (e->kind != entry_kind::_array && e->kind != entry_kind::_array_param) {
+			error(error_type::type_mismatch, node);
+			return;
+		}
+		array_base(ac1, *e);
+		emit_ro(tm_op::_add, ac, ac1, ac, "element address");
+	}
+
+	void codegen::call(std::uint32_t node)
+	{
+		const entry *e = lookup(node);
+		if (e == nullptr)
+			return;
+		std::size_t argc = 0;
+		for (std::uint32_t a = tree->first_child[node]; a != npos; a = tree->next_sibling[a])
+			++argc;
+		switch (e->kind) {
+		case entry_kind::_input:
+			if (argc != 0)
+				error(error_type::argument_count, node);
+			emit_ro(tm_op::_in, ac, 0, 0, "input");
+			return;
+		case entry_kind::_output:
+			if (argc != 1)
+				error(error_type::argument_count, node);
+			expression(tree->first_child[node]);
+			emit_ro(tm_op::_out, ac, 0, 0, "output");
+			return;
+		case entry_kind::_function:
+			break;
+		default:
+			error(error_type::type_mismatch, node);
+			return;
+		}
+		// Parameters are the children of the declaration before its body
+		auto decl = static_cast<std::uint32_t>(e->address);
+		std::int32_t entry_point = e->entry;
+		std::uint32_t callee = binding[tree->value[node]];
+		std::size_t paramc = 0;
+		for (std::uint32_t p = tree->first_child[decl]; p != npos && tree->next_sibling[p] != npos; p = tree->next_sibling[p])
+			++paramc;
+		if (argc != paramc) {
+			error(error_type::argument_count, node);
+			return;
+		}
+		emit_rm(tm_op::_lda, sp, -2, sp, "call: room for fp and return address");
+		std::uint32_t p = tree->first_child[decl];
+		for (std::uint32_t a = tree->first_child[node]; a != npos; a = tree->next_sibling[a], p = tree->next_sibling[p]) {
+			if (tree->kind[p] == node_kind::_array_param) {
+				// Arrays are passed by their address
+				const entry *arr = tree->kind[a] == node_kind::_var ? lookup(a) : nullptr;
+				if (arr != nullptr && (arr->kind == entry_kind::_array || arr->kind == entry_kind::_array_param))
+					array_base(ac, *arr);
+				else
+					error(error_type::type_mismatch, a);
+			}
+			else
+				expression(a);
+			emit_rm(tm_op::_st, ac, 0, sp, "argument");
+			emit_rm(tm_op::_lda, sp, -1, sp, nullptr);
+		}
+		emit_rm(tm_op::_lda, ac1, static_cast<std::int32_t>(2 + argc), sp, "new frame");
+		emit_rm(tm_op::_st, fp, 0, ac1, "save fp");
+		emit_rm(tm_op::_lda, fp, 0, ac1, nullptr);
+		emit_rm(tm_op::_lda, ac, 2, pc, "return address");
+		emit_rm(tm_op::_st, ac, -1, fp, nullptr);
+		std::size_t at = emit_rm(tm_op::_ldc, pc, entry_point, 0, "jump to function");
+		if (entry_point < 0)
+			fixups.emplace_back(at, callee);
+	}
+
+	std::size_t codegen::branch_false(std::uint32_t test)
+	{
+		if (tree->kind[test] == node_kind::_op && is_relation(tree->subtype[test])) {
+			int lhs = operands(test), rhs = lhs == ac ? ac1 : ac;
+			emit_ro(tm_op::_sub, ac, lhs, rhs, "compare");
+			return emit_rm(relation_jump(tree->subtype[test], true), ac, 0, pc, "jump if false");
+		}
+		expression(test);
+		return emit_rm(tm_op::_jeq, ac, 0, pc, "jump if false");
+	}
+
+	void codegen::return_sequence()
+	{
+		emit_rm(tm_op::_lda, sp, 0, fp, "return: drop the frame");
+		emit_rm(tm_op::_ld, ac1, -1, fp, nullptr);
+		emit_rm(tm_op::_ld, fp, 0, fp, nullptr);
+		emit_rm(tm_op::_lda, pc, 0, ac1, nullptr);
+	}
+
+	void codegen::local_declaration(std::uint32_t node)
+	{
+		if (tree->subtype[node] != static_cast<unsigned char>(action_type::_int))
+			error(error_type::type_mismatch, node);
+		if (tree->kind[node] == node_kind::_array_decl) {
+			auto size = static_cast<std::int32_t>(tree->value[tree->first_child[node]]);
+			declare(entry_kind::_array, node, frame + size - 1, size);
+			frame += size;
+		}
+		else
+			declare(entry_kind::_var, node, frame++);
+		frame_max = std::max(frame_max, frame);
+	}
+
+	// Declarations and statements of a block, its scope is opened by the caller
+	void codegen::compound(std::uint32_t node)
+	{
+		for (std::uint32_t c = tree->first_child[node]; c != npos; c = tree->next_sibling[c]) {
+			if (tree->kind[c] == node_kind::_var_decl || tree->kind[c] == node_kind::_array_decl)
+				local_declaration(c);
+			else
+				statement(c);
+		}
+	}
+
+	void codegen::statement(std::uint32_t node)
+	{
+		switch (tree->kind[node]) {
+		case node_kind::_compound: {
+			std::int32_t saved = frame;
+			enter_scope();
+			compound(node);
+			leave_scope();
+			// Cells of the block are free for its siblings
+			frame = saved;
+			break;
+		}
+		case node_kind::_if: {
+			std::uint32_t test = tree->child(node, 0), then_part = tree->child(node, 1), else_part = tree->child(node, 2);
+			std::size_t skip = branch_false(test);
+			statement(then_part);
+			if (else_part != npos) {
+				std::size_t end = emit_rm(tm_op::_lda, pc, 0, pc, "jump over else");
+				patch_jump(skip);
+				statement(else_part);
+				patch_jump(end);
+			}
+			else
+				patch_jump(skip);
+			break;
+		}
+		case node_kind::_while: {
+			auto top = static_cast<std::int32_t>(code.size());
+			std::size_t exit = branch_false(tree->child(node, 0));
+			statement(tree->child(node, 1));
+			emit_rm(tm_op::_lda, pc, top - static_cast<std::int32_t>(code.size() + 1), pc, "loop");
+			patch_jump(exit);
+			break;
+		}
+		case node_kind::_return:
+			expression(tree->first_child[node]);
+			return_sequence();
+			break;
+		case node_kind::_empty:
+			break;
+		default:
+			expression(node);
+			break;
+		}
+	}
+
+	void codegen::function(std::uint32_t node)
+	{
+		std::uint32_t index = declare(entry_kind::_function, node, static_cast<std::int32_t>(node));
+		if (index != npos)
+			entries[index].entry = static_cast<std::int32_t>(code.size());
+		enter_scope();
+		// Below fp: the caller's fp, the return address, then the parameters
+		frame = 2;
+		std::uint32_t body = npos;
+		for (std::uint32_t c = tree->first_child[node]; c != npos; c = tree->next_sibling[c]) {
+			if (tree->kind[c] == node_kind::_compound) {
+				body = c;
+				break;
+			}
+			if (tree->subtype[c] != static_cast<unsigned char>(action_type::_int))
+				error(error_type::type_mismatch, c);
+			declare(tree->kind[c] == node_kind::_array_param ? entry_kind::_array_param : entry_kind::_var, c, frame++);
+		}
+		frame_max = frame;
+		std::size_t prologue = emit_rm(tm_op::_lda, sp, 0, fp, "allocate the frame");
+		// The body shares the scope of the parameters
+		if (body != npos)
+			compound(body);
+		code[prologue].d = -frame_max;
+		return_sequence();
+		leave_scope();
+	}
+
+	void codegen::global_declaration(std::uint32_t node)
+	{
+		if (tree->subtype[node] != static_cast<unsigned char>(action_type::_int))
+			error(error_type::type_mismatch, node);
+		if (tree->kind[node] == node_kind::_array_decl) {
+			auto size = static_cast<std::int32_t>(tree->value[tree->first_child[node]]);
+			declare(entry_kind::_array, node, globals, size);
+			globals += size;
+		}
+		else
+			declare(entry_kind::_var, node, globals++);
+	}
+
+	bool codegen::generate(const syntax_tree &t, cov::span<const token> toks, std::string_view src, const cov::symbol_pool &syms)
+	{
+		tree = &t;
+		tokens = toks;
+		source = src;
+		lines.reset(src);
+		symbols = &syms;
+		entries.clear();
+		binding.assign(syms.size(), npos);
+		scopes.assign(1, 0);
+		code.clear();
+		comments.clear();
+		fixups.clear();
+		errors.clear();
+		// Location 0 holds the size of memory
+		globals = 1;
+		for (auto builtin : {std::make_pair("input", entry_kind::_input), std::make_pair("output", entry_kind::_output)}) {
+			std::uint32_t symbol = syms.find(builtin.first);
+			if (symbol != cov::symbol_pool::npos) {
+				entries.push_back(entry{builtin.second, true, 0, 0, -1, symbol, npos});
+				binding[symbol] = static_cast<std::uint32_t>(entries.size() - 1);
+			}
+		}
+		emit_rm(tm_op::_ld, fp, 0, zero, "prelude: top of memory");
+		emit_rm(tm_op::_st, zero, 0, zero, "clear location 0");
+		emit_rm(tm_op::_lda, sp, 0, fp, "empty stack");
+		// Call main() like any function without arguments, then stop
+		emit_rm(tm_op::_lda, sp, -2, sp, "call main");
+		emit_rm(tm_op::_lda, ac1, 2, sp, nullptr);
+		emit_rm(tm_op::_st, fp, 0, ac1, nullptr);
+		emit_rm(tm_op::_lda, fp, 0, ac1, nullptr);
+		emit_rm(tm_op::_lda, ac, 2, pc, nullptr);
+		emit_rm(tm_op::_st, ac, -1, fp, nullptr);
+		std::size_t main_call = emit_rm(tm_op::_ldc, pc, 0, 0, nullptr);
+		emit_ro(tm_op::_halt, 0, 0, 0, "end of program");
+		std::uint32_t root = tree->root();
+		for (std::uint32_t c = root == npos ? npos : tree->first_child[root]; c != npos; c = tree->next_sibling[c]) {
+			if (tree->kind[c] == node_kind::_fun_decl)
+				function(c);
+			else
+				global_declaration(c);
+		}
+		std::uint32_t main_symbol = syms.find("main");
+		std::uint32_t main_entry = main_symbol == cov::symbol_pool::npos ? npos : binding[main_symbol];
+		if (main_entry == npos || entries[main_entry].kind != entry_kind::_function)
+			error(error_type::missing_main, npos);
+		else
+			code[main_call].d = entries[main_entry].entry;
+		for (auto &fix : fixups)
+			code[fix.first].d = entries[fix.second].entry;
+		return errors.empty();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "cminus_parser.hpp"
+#include "tm_machine.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cmcc {
+	/*
+	 * Lowers the syntax tree of a parse without errors to TM code, checking names and types on the way.
+	 * Registers: 0 and 1 accumulators, 4 the stack pointer, 5 always zero, 6 the frame pointer, 7 pc.
+	 * Globals sit at absolute addresses from 1 up, the stack grows down from the top of memory.
+	 * A frame holds, downwards from fp, the caller's fp, the return address, the parameters and the
+	 * locals; arrays take consecutive cells with element 0 lowest, array parameters hold that address.
+	 * input() and output() are built in, main() is called by the prelude and HALT follows its return.
+	 */
+	class codegen final {
+	public:
+		enum class error_type : unsigned char {
+			undeclared, redeclared, type_mismatch, argument_count, missing_main
+		};
+		struct error_info {
+			error_type type;
+			// The name in question
+			std::string text;
+			std::size_t line, pos;
+			std::size_t offset;
+		};
+	private:
+		enum class entry_kind : unsigned char {
+			_var, _array, _array_param, _function, _input, _output
+		};
+		struct entry {
+			entry_kind kind;
+			bool global;
+			// Address of globals, offset below fp of locals, node of functions
+			std::int32_t address;
+			// Array size, or the size of the frame and the entry point of functions
+			std::int32_t size, entry;
+			std::uint32_t symbol, shadowed;
+		};
+		static constexpr std::uint32_t npos = UINT32_MAX;
+		const syntax_tree *tree = nullptr;
+		cov::span<const token> tokens;
+		std::string_view source;
+		// Line starts of source, only scanned once an error is reported
+		cov::line_index lines;
+		const cov::symbol_pool *symbols = nullptr;
+		std::vector<entry> entries;
+		// Innermost entry of every symbol, scopes are the entry counts to go back to
+		std::vector<std::uint32_t> binding;
+		std::vector<std::size_t> scopes;
+		std::int32_t globals = 0, frame = 0, frame_max = 0;
+		std::vector<cov::tm_instruction> code;
+		std::vector<const char *> comments;
+		// Calls of functions defined later, main() of the prelude: instruction, entry
+		std::vector<std::pair<std::size_t, std::uint32_t>> fixups;
+		std::vector<error_info> errors;
+		void error(error_type, std::uint32_t);
+		std::size_t emit(cov::tm_op, int, int, int, std::int32_t, const char * = nullptr);
+		std::size_t emit_ro(cov::tm_op, int, int, int, const char * = nullptr);
+		std::size_t emit_rm(cov::tm_op, int, std::int32_t, int, const char * = nullptr);
+		void patch_jump(std::size_t);
+		std::uint32_t declare(entry_kind, std::uint32_t, std::int32_t, std::int32_t = 0);
+		const entry *lookup(std::uint32_t);
+		void enter_scope();
+		void leave_scope();
+		void push();
+		void pop(int);
+		bool simple(std::uint32_t);
+		void load_simple(int, std::uint32_t);
+		void array_base(int, const entry &);
+		int operands(std::uint32_t);
+		void expression(std::uint32_t);
+		void index_address(std::uint32_t);
+		void call(std::uint32_t);
+		std::size_t branch_false(std::uint32_t);
+		void statement(std::uint32_t);
+		void compound(std::uint32_t);
+		void return_sequence();
+		void function(std::uint32_t);
+		void global_declaration(std::uint32_t);
+		void local_declaration(std::uint32_t);
+	public:
+		static const char *get_error(error_type) noexcept;
+		// True if the program passed the checks, the code is complete only then
+		bool generate(const syntax_tree &, cov::span<const token>, std::string_view, const cov::symbol_pool &);
+		template<typename lexer_t>
+		bool generate(const lexer_t &lex, const parser &p)
+		{
+			return generate(p.get_tree(), lex.get_results(), lex.get_source(), lex.get_symbols());
+		}
+		inline const std::vector<cov::tm_instruction> &get_code() const noexcept
+		{
+			return code;
+		}
+		inline const std::vector<error_info> &get_errors() const noexcept
+		{
+			return errors;
+		}
+		// TM text with the comments of the generator
+		void write(std::ostream &out) const
+		{
+			cov::tm_write(out, code, &comments);
+		}
+	};
+}
\ No newline at end of file
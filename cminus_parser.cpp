@@ -0,0 +1,613 @@
+#include "cminus_parser.hpp"
+
+namespace cmcc {
+	template<typename enum_t>
+	constexpr unsigned char sub(enum_t e)
+	{
+		return static_cast<unsigned char>(e);
+	}
+
+	constexpr std::uint32_t npos = syntax_tree::npos;
+
+	const char *parser::get_error(error_type type) noexcept
+	{
+		switch (type) {
+		case error_type::missing_token:
+			return "缺少记号";
+		case error_type::unexpected_token:
+			return "多余的记号";
+		case error_type::expect_declaration:
+			return "应为声明";
+		case error_type::expect_statement:
+			return "应为语句";
+		case error_type::expect_type:
+			return "应为类型";
+		case error_type::expect_factor:
+			return "应为表达式";
+		case error_type::invalid_assignment:
+			return "表达式不可赋值";
+		case error_type::too_deep:
+			return "嵌套过深";
+		}
+		return "无错误";
+	}
+
+	// The last children pending are linked in order and replaced by the new node, failed parts left npos behind
+	std::uint32_t parser::make(node_kind kind, std::size_t tok, std::size_t children, unsigned char subtype, std::uint32_t value)
+	{
+		std::uint32_t node = static_cast<std::uint32_t>(tree.size()), first = npos, prev = npos;
+		for (std::size_t i = pending.size() - children; i < pending.size(); ++i) {
+			std::uint32_t c = pending[i];
+			if (c == npos)
+				continue;
+			if (prev == npos)
+				first = c;
+			else
+				tree.next_sibling[prev] = c;
+			prev = c;
+		}
+		pending.resize(pending.size() - children);
+		pending.push_back(node);
+		tree.kind.push_back(kind);
+		tree.subtype.push_back(subtype);
+		tree.value.push_back(value);
+		tree.token.push_back(static_cast<std::uint32_t>(tok));
+		tree.first_child.push_back(first);
+		tree.next_sibling.push_back(npos);
+		return node;
+	}
+
+	void parser::error(error_type type, std::string_view expected)
+	{
+		// Errors caused by the last one are dropped until the parser is back in step
+		if (panic)
+			return;
+		panic = true;
+		error_info e{type, std::string(), 0, 1, 0, cur};
+		if (more()) {
+			const token &t = tokens[cur];
+			lines.locate(t.offset + t.length, e.line, e.pos);
+			e.offset = t.offset + t.length - 1;
+			e.text = source.substr(t.offset, t.length);
+		}
+		else {
+			if (!tokens.empty()) {
+				const token &t = tokens[tokens.size() - 1];
+				lines.locate(t.offset + t.length, e.line, e.pos);
+				++e.pos;
+				e.offset = t.offset + t.length;
+			}
+			e.text = "EOF";
+		}
+		if (type == error_type::missing_token)
+			e.text = expected;
+		errors.push_back(std::move(e));
+	}
+
+	bool parser::check(token_type type, unsigned char subtype)
+	{
+		return more() && tokens[cur].type == type && tokens[cur].subtype == subtype;
+	}
+
+	bool parser::check_signal(signal_type sig)
+	{
+		return check(token_type::_signal, sub(sig));
+	}
+
+	bool parser::check_action(action_type act)
+	{
+		return check(token_type::_action, sub(act));
+	}
+
+	bool parser::check_type()
+	{
+		return check_action(action_type::_int) || check_action(action_type::_void);
+	}
+
+	bool parser::match(token_type type, unsigned char subtype, std::string_view text)
+	{
+		if (check(type, subtype)) {
+			++cur;
+			panic = false;
+			return true;
+		}
+		// A single stray token in front of the expected one is dropped
+		if (more(1) && tokens[cur + 1].type == type && tokens[cur + 1].subtype == subtype) {
+			error(error_type::unexpected_token);
+			cur += 2;
+			panic = false;
+			return true;
+		}
+		error(error_type::missing_token, text);
+		return false;
+	}
+
+	constexpr std::string_view signal_text[] = {
+		"", "~", "/*", "+", "-", "*", "/", "<", "<=", ">", ">=", "==", "~=", "=", ",", ";", "(", ")", "[", "]", "{", "}"
+	};
+
+	bool parser::match_signal(signal_type sig)
+	{
+		return match(token_type::_signal, sub(sig), signal_text[sub(sig)]);
+	}
+
+	std::uint32_t parser::match_id()
+	{
+		if (more() && tokens[cur].type == token_type::_identifier) {
+			panic = false;
+			return tokens[cur++].symbol;
+		}
+		error(error_type::missing_token, "ID");
+		return cov::symbol_pool::npos;
+	}
+
+	// Skip the offending token and everything up to the end of its statement or block
+	void parser::synchronize()
+	{
+		if (more())
+			++cur;
+		for (; more(); ++cur) {
+			const token &t = tokens[cur];
+			if (t.type == token_type::_signal) {
+				if (t.subtype == sub(signal_type::_sem)) {
+					++cur;
+					return;
+				}
+				if (t.subtype == sub(signal_type::_lrb) || t.subtype == sub(signal_type::_llb))
+					return;
+			}
+			if (t.type == token_type::_action && t.subtype != sub(action_type::_else))
+				return;
+		}
+	}
+
+	// One more level of nesting, past max_depth the rest of the input is dropped and parsing ends
+	bool parser::enter()
+	{
+		if (depth < max_depth) {
+			++depth;
+			return true;
+		}
+		panic = false;
+		error(error_type::too_deep);
+		while (more())
+			++cur;
+		return false;
+	}
+
+	// declaration : type_specifier id (";" | "[" num "]" ";" | "(" params ")" compound_stmt)
+	void parser::declaration()
+	{
+		std::size_t tok = cur;
+		unsigned char type = tokens[cur++].subtype;
+		std::uint32_t name = match_id();
+		if (check_signal(signal_type::_slb)) {
+			++cur;
+			std::size_t mark = pending.size();
+			params();
+			match_signal(signal_type::_srb);
+			compound_stmt();
+			make(node_kind::_fun_decl, tok, pending.size() - mark, type, name);
+		}
+		else
+			var_declaration(tok, type, name);
+	}
+
+	// var_declaration : type_specifier id ["[" num "]"] ";"
+	void parser::var_declaration(std::size_t tok, unsigned char type, std::uint32_t name)
+	{
+		if (check_signal(signal_type::_mlb)) {
+			++cur;
+			std::size_t mark = pending.size();
+			if (more() && tokens[cur].type == token_type::_literal)
+				factor();
+			else
+				error(error_type::missing_token, "NUM");
+			match_signal(signal_type::_mrb);
+			match_signal(signal_type::_sem);
+			make(node_kind::_array_decl, tok, pending.size() - mark, type, name);
+			return;
+		}
+		match_signal(signal_type::_sem);
+		make(node_kind::_var_decl, tok, 0, type, name);
+	}
+
+	// params : "void" | param {"," param}, param : type_specifier id ["[" "]"]
+	void parser::params()
+	{
+		if (check_action(action_type::_void) && more(1) && tokens[cur + 1].type == token_type::_signal && tokens[cur + 1].subtype == sub(signal_type::_srb)) {
+			++cur;
+			return;
+		}
+		for (;;) {
+			std::size_t tok = cur;
+			unsigned char type = 0;
+			if (check_type())
+				type = tokens[cur++].subtype;
+			else
+				error(error_type::expect_type);
+			std::uint32_t name = match_id();
+			if (check_signal(signal_type::_mlb)) {
+				++cur;
+				match_signal(signal_type::_mrb);
+				make(node_kind::_array_param, tok, 0, type, name);
+			}
+			else
+				make(node_kind::_param, tok, 0, type, name);
+			if (!check_signal(signal_type::_com))
+				break;
+			++cur;
+		}
+	}
+
+	// compound_stmt : "{" {var_declaration | statement} "}"
+	void parser::compound_stmt()
+	{
+		std::size_t tok = cur, mark = pending.size();
+		match_signal(signal_type::_llb);
+		while (more() && !check_signal(signal_type::_lrb)) {
+			if (check_type()) {
+				// A function header means the "}" went missing, leave it to the top level
+				if (more(2) && tokens[cur + 2].type == token_type::_signal && tokens[cur + 2].subtype == sub(signal_type::_slb))
+					break;
+				std::size_t decl = cur;
+				unsigned char type = tokens[cur++].subtype;
+				std::uint32_t name = match_id();
+				var_declaration(decl, type, name);
+			}
+			else
+				statement();
+		}
+		match_signal(signal_type::_lrb);
+		make(node_kind::_compound, tok, pending.size() - mark);
+	}
+
+	// statement : expression_stmt | compound_stmt | selection_stmt | iteration_stmt | return_stmt
+	void parser::statement()
+	{
+		if (!enter())
+			return;
+		statement_body();
+		--depth;
+	}
+
+	void parser::statement_body()
+	{
+		std::size_t tok = cur, mark = pending.size();
+		if (more()) {
+			const token &t = tokens[cur];
+			switch (t.type) {
+			case token_type::_signal:
+				switch (static_cast<signal_type>(t.subtype)) {
+				// expression_stmt : ";" | expression ";"
+				case signal_type::_sem:
+					++cur;
+					panic = false;
+					make(node_kind::_empty, tok, 0);
+					return;
+				case signal_type::_llb:
+					compound_stmt();
+					return;
+				case signal_type::_slb:
+					expression();
+					match_signal(signal_type::_sem);
+					return;
+				default:
+					break;
+				}
+				break;
+			case token_type::_literal:
+			case token_type::_identifier:
+				expression();
+				match_signal(signal_type::_sem);
+				return;
+			case token_type::_action:
+				switch (static_cast<action_type>(t.subtype)) {
+				// selection_stmt : "if" "(" expression ")" statement ["else" statement]
+				case action_type::_if:
+					++cur;
+					match_signal(signal_type::_slb);
+					expression();
+					match_signal(signal_type::_srb);
+					statement();
+					if (check_action(action_type::_else)) {
+						++cur;
+						statement();
+					}
+					make(node_kind::_if, tok, pending.size() - mark);
+					return;
+				// iteration_stmt : "while" "(" expression ")" statement
+				case action_type::_while:
+					++cur;
+					match_signal(signal_type::_slb);
+					expression();
+					match_signal(signal_type::_srb);
+					statement();
+					make(node_kind::_while, tok, pending.size() - mark);
+					return;
+				// return_stmt : "return" [expression] ";"
+				case action_type::_return:
+					++cur;
+					if (!check_signal(signal_type::_sem))
+						expression();
+					match_signal(signal_type::_sem);
+					make(node_kind::_return, tok, pending.size() - mark);
+					return;
+				default:
+					break;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		error(error_type::expect_statement);
+		synchronize();
+	}
+
+	// expression : var "=" expression | simple_expression
+	void parser::expression()
+	{
+		if (!enter()) {
+			pending.push_back(npos);
+			return;
+		}
+		simple_expression();
+		if (check_signal(signal_type::_asi)) {
+			std::uint32_t lhs = pending.back();
+			if (lhs != npos && tree.kind[lhs] != node_kind::_var && tree.kind[lhs] != node_kind::_index)
+				error(error_type::invalid_assignment);
+			std::size_t tok = cur++;
+			expression();
+			make(node_kind::_assign, tok, 2);
+		}
+		--depth;
+	}
+
+	// simple_expression : additive_expression [relop additive_expression]
+	void parser::simple_expression()
+	{
+		additive_expression();
+		if (more() && tokens[cur].type == token_type::_signal) {
+			switch (static_cast<signal_type>(tokens[cur].subtype)) {
+			case signal_type::_und:
+			case signal_type::_ueq:
+			case signal_type::_abo:
+			case signal_type::_aeq:
+			case signal_type::_equ:
+			case signal_type::_neq: {
+				std::size_t tok = cur++;
+				additive_expression();
+				make(node_kind::_op, tok, 2, tokens[tok].subtype);
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+
+	// additive_expression : term {("+" | "-") term}
+	void parser::additive_expression()
+	{
+		term();
+		while (check_signal(signal_type::_add) || check_signal(signal_type::_sub)) {
+			std::size_t tok = cur++;
+			term();
+			make(node_kind::_op, tok, 2, tokens[tok].subtype);
+		}
+	}
+
+	// term : factor {("*" | "/") factor}, left associative as in the C- reference grammar
+	void parser::term()
+	{
+		factor();
+		while (check_signal(signal_type::_mul) || check_signal(signal_type::_div)) {
+			std::size_t tok = cur++;
+			factor();
+			make(node_kind::_op, tok, 2, tokens[tok].subtype);
+		}
+	}
+
+	// factor : "(" expression ")" | id ["[" expression "]" | "(" [args] ")"] | num
+	void parser::factor()
+	{
+		std::size_t tok = cur;
+		if (more()) {
+			const token &t = tokens[cur];
+			switch (t.type) {
+			case token_type::_literal: {
+				// Wraps around like the integers of the TM machine
+				std::uint32_t value = 0;
+				// Read from the source, the symbols may still be growing on the lexer thread
+				for (char c : source.substr(t.offset, t.length))
+					value = value * 10 + (c - '0');
+				++cur;
+				make(node_kind::_const, tok, 0, 0, value);
+				return;
+			}
+			case token_type::_identifier: {
+				std::uint32_t name = t.symbol;
+				++cur;
+				if (check_signal(signal_type::_mlb)) {
+					++cur;
+					expression();
+					match_signal(signal_type::_mrb);
+					make(node_kind::_index, tok, 1, 0, name);
+				}
+				else if (check_signal(signal_type::_slb)) {
+					// args : expression {"," expression}
+					++cur;
+					std::size_t mark = pending.size();
+					if (!check_signal(signal_type::_srb)) {
+						expression();
+						while (check_signal(signal_type::_com)) {
+							++cur;
+							expression();
+						}
+					}
+					match_signal(signal_type::_srb);
+					make(node_kind::_call, tok, pending.size() - mark, 0, name);
+				}
+				else
+					make(node_kind::_var, tok, 0, 0, name);
+				return;
+			}
+			case token_type::_signal:
+				if (t.subtype == sub(signal_type::_slb)) {
+					++cur;
+					expression();
+					match_signal(signal_type::_srb);
+					return;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		error(error_type::expect_factor);
+		pending.push_back(npos);
+	}
+
+	bool parser::receive(std::size_t k)
+	{
+		while (cur + k >= tokens.size()) {
+			if (ring->pop(received) == 0) {
+				// The lexer is done, everything is in received
+				ring = nullptr;
+				return false;
+			}
+			tokens = received;
+		}
+		return true;
+	}
+
+	// program : declaration {declaration}
+	bool parser::program(std::size_t expected)
+	{
+		tree.clear();
+		// Programs come out at about two nodes for every three tokens
+		tree.reserve(expected * 3 / 4 + 1);
+		cur = 0;
+		depth = 0;
+		panic = false;
+		errors.clear();
+		pending.clear();
+		while (more()) {
+			if (check_type()) {
+				declaration();
+				continue;
+			}
+			// Garbage between declarations is skipped up to the next type specifier
+			error(error_type::expect_declaration);
+			do
+				++cur;
+			while (more() && !check_type());
+		}
+		if (tokens.empty())
+			error(error_type::expect_declaration);
+		make(node_kind::_program, 0, pending.size());
+		return errors.empty();
+	}
+
+	bool parser::parse(cov::span<const token> toks, std::string_view src, const cov::symbol_pool &syms)
+	{
+		tokens = toks;
+		source = src;
+		lines.reset(src);
+		symbols = &syms;
+		ring = nullptr;
+		return program(toks.size());
+	}
+
+	bool parser::parse(cov::spsc_ring<token> &r, std::string_view src, const cov::symbol_pool &syms)
+	{
+		// The lexer's estimate of one token per eight bytes
+		received.clear();
+		received.reserve(src.size() / 8);
+		tokens = received;
+		source = src;
+		lines.reset(src);
+		symbols = &syms;
+		ring = &r;
+		return program(src.size() / 8);
+	}
+
+	constexpr std::string_view type_name(unsigned char type)
+	{
+		switch (static_cast<action_type>(type)) {
+		case action_type::_int:
+			return "int";
+		case action_type::_void:
+			return "void";
+		default:
+			return "?";
+		}
+	}
+
+	void parser::print_tree(std::ostream &out, std::uint32_t node, std::size_t indent) const
+	{
+		out << std::string(indent, ' ');
+		switch (tree.kind[node]) {
+		case node_kind::_program:
+			out << "Program\n";
+			break;
+		case node_kind::_var_decl:
+			out << "Var: " << get_name(node) << " (" << type_name(tree.subtype[node]) << ")\n";
+			break;
+		case node_kind::_array_decl:
+			out << "Array: " << get_name(node) << " (" << type_name(tree.subtype[node]) << ")\n";
+			break;
+		case node_kind::_fun_decl:
+			out << "Function: " << get_name(node) << " (" << type_name(tree.subtype[node]) << ")\n";
+			break;
+		case node_kind::_param:
+			out << "Param: " << get_name(node) << " (" << type_name(tree.subtype[node]) << ")\n";
+			break;
+		case node_kind::_array_param:
+			out << "Param: " << get_name(node) << "[] (" << type_name(tree.subtype[node]) << ")\n";
+			break;
+		case node_kind::_compound:
+			out << "Compound\n";
+			break;
+		case node_kind::_empty:
+			out << "Empty\n";
+			break;
+		case node_kind::_if:
+			out << "If\n";
+			break;
+		case node_kind::_while:
+			out << "While\n";
+			break;
+		case node_kind::_return:
+			out << "Return\n";
+			break;
+		case node_kind::_assign:
+			out << "Assign\n";
+			break;
+		case node_kind::_op:
+			out << "Op: " << signal_text[tree.subtype[node]] << '\n';
+			break;
+		case node_kind::_var:
+			out << "Id: " << get_name(node) << '\n';
+			break;
+		case node_kind::_index:
+			out << "Index: " << get_name(node) << '\n';
+			break;
+		case node_kind::_call:
+			out << "Call: " << get_name(node) << '\n';
+			break;
+		case node_kind::_const:
+			out << "Const: " << static_cast<std::int32_t>(tree.value[node]) << '\n';
+			break;
+		}
+		for (std::uint32_t c = tree.first_child[node]; c != npos; c = tree.next_sibling[c])
+			print_tree(out, c, indent + 2);
+	}
+
+	void parser::print_tree(std::ostream &out) const
+	{
+		if (tree.root() != npos)
+			print_tree(out, tree.root(), 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "cminus.hpp"
+#include "span.hpp"
+#include "spsc_ring.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cmcc {
+	enum class node_kind : unsigned char {
+		_program, _var_decl, _array_decl, _fun_decl, _param, _array_param,
+		_compound, _empty, _if, _while, _return,
+		_assign, _op, _var, _index, _call, _const
+	};
+
+	/*
+	 * Syntax tree as a structure of arrays, 18 bytes per node whatever the size of the translation unit.
+	 * Nodes refer to each other by 32-bit indices: the first child, then the next sibling of every child.
+	 * Children are always stored before their parent, so a forward sweep over the arrays is a bottom-up
+	 * traversal and the root is the last node.
+	 *   program:    declarations
+	 *   var_decl:   type in subtype, array_decl has the size as a const child
+	 *   fun_decl:   return type in subtype, params then the compound body
+	 *   param:      type in subtype, array_param for "type id[]"
+	 *   compound:   local declarations and statements in source order
+	 *   if:         test, then, [else]; while: test, body; return: [value]
+	 *   assign:     var or index, value; op: lhs, rhs with the signal in subtype
+	 *   index:      the subscript; call: the arguments
+	 * Names are symbol ids in value, const holds its number.
+	 */
+	class syntax_tree final {
+	public:
+		static constexpr std::uint32_t npos = UINT32_MAX;
+		std::vector<node_kind> kind;
+		// action_type of declarations, signal_type of op
+		std::vector<unsigned char> subtype;
+		std::vector<std::uint32_t> value;
+		// Index of the token the node starts with
+		std::vector<std::uint32_t> token;
+		std::vector<std::uint32_t> first_child;
+		std::vector<std::uint32_t> next_sibling;
+		inline std::size_t size() const noexcept
+		{
+			return kind.size();
+		}
+		inline std::uint32_t root() const noexcept
+		{
+			return kind.empty() ? npos : static_cast<std::uint32_t>(kind.size() - 1);
+		}
+		// Child i of node, npos if there are fewer children
+		std::uint32_t child(std::uint32_t node, std::size_t i) const noexcept
+		{
+			std::uint32_t c = first_child[node];
+			for (; i > 0 && c != npos; --i)
+				c = next_sibling[c];
+			return c;
+		}
+		std::size_t memory() const noexcept
+		{
+			return kind.capacity() * sizeof(node_kind) + subtype.capacity() + (value.capacity() + token.capacity() + first_child.capacity() + next_sibling.capacity()) * sizeof(std::uint32_t);
+		}
+		void clear() noexcept
+		{
+			kind.clear();
+			subtype.clear();
+			value.clear();
+			token.clear();
+			first_child.clear();
+			next_sibling.clear();
+		}
+		void reserve(std::size_t n)
+		{
+			kind.reserve(n);
+			subtype.reserve(n);
+			value.reserve(n);
+			token.reserve(n);
+			first_child.reserve(n);
+			next_sibling.reserve(n);
+		}
+	};
+
+	// Recursive descent over tokens of lexer or static_lexer, following cminus_syntax of covci.csc
+	class parser final {
+	public:
+		enum class error_type : unsigned char {
+			missing_token, unexpected_token, expect_declaration, expect_statement, expect_type, expect_factor, invalid_assignment, too_deep
+		};
+		// Nested expressions and statements are parsed by recursion, deeper input is rejected before the stack runs out
+		static constexpr std::size_t max_depth = 10000;
+		struct error_info {
+			error_type type;
+			// Expected token of missing_token, the offending token otherwise
+			std::string text;
+			// Position of the offending token in the convention of lexer, the end of input follows the last token
+			std::size_t line, pos;
+			std::size_t offset;
+			// Index of the offending token
+			std::size_t index;
+		};
+	private:
+		syntax_tree tree;
+		cov::span<const token> tokens;
+		std::string_view source;
+		// Line starts of source, only scanned once an error is reported
+		cov::line_index lines;
+		const cov::symbol_pool *symbols = nullptr;
+		std::size_t cur = 0, depth = 0;
+		// Set by an error, cleared once an expected token or a ";" is consumed
+		bool panic = false;
+		std::vector<error_info> errors;
+		// Children of the nodes under construction
+		std::vector<std::uint32_t> pending;
+		// Pipelined parsing: tokens arrive from the lexer thread through the ring and are kept in received
+		cov::spsc_ring<token> *ring = nullptr;
+		std::vector<token> received;
+		bool receive(std::size_t);
+		// Token cur + k exists, pipelined parsing waits for the lexer until it is published or the input ended
+		inline bool more(std::size_t k = 0)
+		{
+			return cur + k < tokens.size() || (ring != nullptr && receive(k));
+		}
+		std::uint32_t make(node_kind, std::size_t, std::size_t, unsigned char = 0, std::uint32_t = 0);
+		void error(error_type, std::string_view = std::string_view());
+		bool check(token_type, unsigned char);
+		bool check_signal(signal_type);
+		bool check_action(action_type);
+		bool match(token_type, unsigned char, std::string_view);
+		bool match_signal(signal_type);
+		std::uint32_t match_id();
+		void synchronize();
+		bool enter();
+		bool check_type();
+		void declaration();
+		void var_declaration(std::size_t, unsigned char, std::uint32_t);
+		void params();
+		void compound_stmt();
+		void statement();
+		void statement_body();
+		void expression();
+		void simple_expression();
+		void additive_expression();
+		void term();
+		void factor();
+		bool program(std::size_t);
+		void print_tree(std::ostream &, std::uint32_t, std::size_t) const;
+	public:
+		static const char *get_error(error_type) noexcept;
+		// The tokens, source and symbols have to outlive the tree, true if there was no syntax error
+		bool parse(cov::span<const token>, std::string_view, const cov::symbol_pool &);
+		template<typename lexer_t>
+		bool parse(const lexer_t &lex)
+		{
+			return parse(lex.get_results(), lex.get_source(), lex.get_symbols());
+		}
+		// Pipelined parsing of the tokens a lexer on another thread pushes into the ring, the symbols are not used before it closes the ring
+		bool parse(cov::spsc_ring<token> &, std::string_view, const cov::symbol_pool &);
+		inline const syntax_tree &get_tree() const noexcept
+		{
+			return tree;
+		}
+		inline const std::vector<error_info> &get_errors() const noexcept
+		{
+			return errors;
+		}
+		inline std::size_t get_node_count() const noexcept
+		{
+			return tree.size();
+		}
+		inline std::size_t get_memory() const noexcept
+		{
+			return tree.memory();
+		}
+		// Empty for a name which was missing
+		inline std::string_view get_name(std::uint32_t node) const noexcept
+		{
+			std::uint32_t sym = tree.value[node];
+			return sym < symbols->size() ? symbols->get(sym) : std::string_view();
+		}
+		void print_tree(std::ostream &) const;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "cminus.hpp"
+#include "static_lexer.hpp"
+#include "static_tables.hpp"
+#include "simd_scan.hpp"
+#include <algorithm>
+
+namespace cmcc {
+	// What a rule of static_rules produces
+	enum class static_kind : unsigned char {
+		blank, comment, action, signal, expect, identifier, number, unexpected_character
+	};
+
+	constexpr cov::static_rule make_rule(std::string_view regex, static_kind kind)
+	{
+		return {regex, static_cast<unsigned char>(kind), 0};
+	}
+
+	constexpr cov::static_rule make_rule(std::string_view regex, action_type act)
+	{
+		return {regex, static_cast<unsigned char>(static_kind::action), static_cast<unsigned char>(act)};
+	}
+
+	constexpr cov::static_rule make_rule(std::string_view regex, signal_type sig)
+	{
+		return {regex, static_cast<unsigned char>(static_kind::signal), static_cast<unsigned char>(sig)};
+	}
+
+	/*
+	 * The rules of lexer in priority order. Signals split by longest match, the opening of a comment
+	 * always swallows the next character, so a star right after it cannot close the comment.
+	 * A lone "~" is a token only when another signal follows it, which is left to static_lexer.
+	 */
+	struct static_rules {
+		static constexpr cov::static_rule rules[] = {
+			make_rule("if", action_type::_if),
+			make_rule("else", action_type::_else),
+			make_rule("return", action_type::_return),
+			make_rule("while", action_type::_while),
+			make_rule("int", action_type::_int),
+			make_rule("void", action_type::_void),
+			make_rule(R"([A-Za-z_]\w*)", static_kind::identifier),
+			make_rule(R"([0-9]+)", static_kind::number),
+			make_rule(R"(/\*([\s\S]([^*]|\*+[^*/])*(\*+/|\**))?)", static_kind::comment),
+			make_rule(R"(\+)", signal_type::_add),
+			make_rule(R"(-)", signal_type::_sub),
+			make_rule(R"(\*)", signal_type::_mul),
+			make_rule(R"(/)", signal_type::_div),
+			make_rule(R"(<)", signal_type::_und),
+			make_rule(R"(<=)", signal_type::_ueq),
+			make_rule(R"(>)", signal_type::_abo),
+			make_rule(R"(>=)", signal_type::_aeq),
+			make_rule(R"(==)", signal_type::_equ),
+			make_rule(R"(~=)", signal_type::_neq),
+			make_rule(R"(=)", signal_type::_asi),
+			make_rule(R"(,)", signal_type::_com),
+			make_rule(R"(;)", signal_type::_sem),
+			make_rule(R"(\()", signal_type::_slb),
+			make_rule(R"(\))", signal_type::_srb),
+			make_rule(R"(\[)", signal_type::_mlb),
+			make_rule(R"(\])", signal_type::_mrb),
+			make_rule(R"(\{)", signal_type::_llb),
+			make_rule(R"(\})", signal_type::_lrb),
+			make_rule(R"(~)", static_kind::expect),
+			make_rule(R"([\s\x00]+)", static_kind::blank),
+			make_rule(R"([\x00-\xff])", static_kind::unexpected_character)
+		};
+	};
+
+	/*
+	 * Whole-buffer C- lexer on a transition table built at compile time from static_rules.
+	 * Produces the same tokens, symbols and errors as lexer::lex(), without any startup cost.
+	 */
+	class static_lexer final {
+		static constexpr cov::char_table char_class = cov::make_char_table("+-*/<>=~;,()[]{}");
+	public:
+		using state = lexer::state;
+		using error_info = lexer::error_info;
+		using scanner = cov::static_scanner<static_rules>;
+	private:
+		std::vector<token> results;
+		std::vector<error_info> errors;
+		cov::symbol_pool symbols;
+		cov::mapped_file file;
+		std::string_view source;
+		cov::line_index lines;
+		void push(token_type type, unsigned char subtype, std::size_t off, std::size_t len, std::uint32_t sym = 0)
+		{
+			results.push_back({type, subtype, sym, static_cast<std::uint32_t>(off), static_cast<std::uint32_t>(len)});
+		}
+		// Positions are filled in once the whole buffer is lexed, as lexer::lex() does
+		void error(state s, std::string text, std::size_t off)
+		{
+			errors.push_back({s, std::move(text), 0, 0, off, results.size()});
+		}
+		// Same walk as the comment states of lexer::run, the character after the opening is swallowed
+		const char *comment(const char *p, const char *end)
+		{
+			p += 2;
+			if (p != end)
+				++p;
+			while (p != end) {
+				p = cov::find_char(p, end, '*');
+				while (p != end && *p == '*')
+					++p;
+				if (p == end || *p++ == '/')
+					break;
+			}
+			return p;
+		}
+	public:
+		static const char *get_error(state s) noexcept
+		{
+			return lexer::get_error(s);
+		}
+		inline token_view view(const token &t) const noexcept
+		{
+			return token_view(t, source, symbols, lines);
+		}
+		inline const cov::line_index &get_lines() const noexcept
+		{
+			return lines;
+		}
+		inline cov::span<const token> get_results() const noexcept
+		{
+			return results;
+		}
+		inline const std::vector<error_info> &get_errors() const noexcept
+		{
+			return errors;
+		}
+		inline const cov::symbol_pool &get_symbols() const noexcept
+		{
+			return symbols;
+		}
+		inline std::string_view get_source() const noexcept
+		{
+			return source;
+		}
+		// Lex a whole buffer, the buffer must outlive the tokens
+		void lex(std::string_view src)
+		{
+			results.clear();
+			errors.clear();
+			symbols.clear();
+			source = src;
+			lines.reset(src);
+			results.reserve(src.size() / 8);
+			const char *base = src.data(), *p = base, *end = base + src.size();
+			while (p != end) {
+				// Blanks and comments take the vectorized paths of lexer::run, a single separator is stepped over
+				// here since most runs between tokens are one byte long and not worth a call into the kernel
+				if (char_class[static_cast<unsigned char>(*p)] & cov::cc_blank) {
+					if (++p != end && (char_class[static_cast<unsigned char>(*p)] & cov::cc_blank))
+						p = cov::skip_blank(p, end);
+					continue;
+				}
+				if (*p == '/' && end - p > 1 && p[1] == '*') {
+					p = comment(p, end);
+					continue;
+				}
+				int rule;
+				// Any single character matches the last rule
+				const char *q = scanner::match(p, end, rule);
+				const cov::static_rule &r = static_rules::rules[rule];
+				std::size_t off = p - base, len = q - p;
+				std::string_view text(p, len);
+				switch (static_cast<static_kind>(r.kind)) {
+				case static_kind::blank:
+				case static_kind::comment:
+					break;
+				case static_kind::action:
+					push(token_type::_action, r.subtype, off, len);
+					break;
+				case static_kind::signal:
+					push(token_type::_signal, r.subtype, off, len);
+					break;
+				case static_kind::expect:
+					if (q != end && (char_class[static_cast<unsigned char>(*q)] & cov::cc_signal)) {
+						push(token_type::_signal, static_cast<unsigned char>(signal_type::_expect), off, len);
+						break;
+					}
+					// Ends the run of signals, the character after it is consumed by the error
+					error(state::incomplete_signal, std::string(text), q - base);
+					if (q != end)
+						++q;
+					break;
+				case static_kind::identifier:
+					push(token_type::_identifier, 0, off, len, symbols.intern(text));
+					break;
+				case static_kind::number:
+					push(token_type::_literal, static_cast<unsigned char>(literal_type::_number), off, len, symbols.intern(text));
+					break;
+				case static_kind::unexpected_character:
+					error(state::unexpected_character, std::string(text), off);
+					break;
+				}
+				p = q;
+			}
+			for (auto &e : errors) {
+				lines.locate(e.offset, e.line, e.pos);
+				++e.pos;
+			}
+		}
+		bool lex_file(const std::string &path)
+		{
+			if (!file.open(path))
+				return false;
+			lex(file.view());
+			return true;
+		}
+	};
+}
\ No newline at end of file
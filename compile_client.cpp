@@ -0,0 +1,124 @@
+#include "compile_protocol.hpp"
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <fstream>
+#include <chrono>
+#include <vector>
+
+/*
+ * Local client of the compile server: every input is sent as one request and the responses are printed in order.
+ * Files are sent by path unless -i sends their text, "-" sends the text of stdin. The language follows
+ * the extension unless -l names it. With -n every request is repeated and the rate seen by the client is printed.
+ * stats and shutdown are passed on to the server as they are.
+ */
+
+static std::string language_of(const std::string &path)
+{
+	std::string ext = std::filesystem::path(path).extension().string();
+	if (ext == ".tny")
+		return "tiny";
+	else if (ext == ".c-")
+		return "c-";
+	else if (ext == ".csc" || ext == ".csp" || ext == ".ecs")
+		return "peg/ecs-lang";
+	else
+		return std::string();
+}
+
+int main(int argc, const char *argv[])
+{
+	std::string socket_path, language, verb = "parse";
+	std::size_t repeat = 1;
+	bool send_text = false, usage = false;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (arg == "-s" && i + 1 < argc)
+			socket_path = argv[++i];
+		else if (arg == "-l" && i + 1 < argc)
+			language = argv[++i];
+		else if (arg == "-v" && i + 1 < argc)
+			verb = argv[++i];
+		else if (arg == "-n" && i + 1 < argc)
+			repeat = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+		else if (arg == "-i")
+			send_text = true;
+		else if (arg.size() > 1 && arg[0] == '-')
+			usage = true;
+		else
+			inputs.emplace_back(arg);
+	}
+	// Checking CLI input
+	if (usage || socket_path.empty() || inputs.empty()) {
+		std::cout << "Usage: compile_client -s <SOCKET> [-l <LANGUAGE>] [-v lex|parse|tree|tm] [-n <REPEAT>] [-i] <INPUT>...|-|stats|shutdown" << std::endl;
+		return -1;
+	}
+	int fd = cov::connect_unix(socket_path);
+	if (fd < 0) {
+		std::cout << "Cannot connect to " << socket_path << ": " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+	cov::frame_reader reader(fd);
+	std::string status, body;
+	auto exchange = [&](const cov::compile_request &req) {
+		if (cov::write_request(fd, req) && cov::read_response(reader, status, body) == cov::frame_status::ok)
+			return true;
+		std::cout << "Connection to the server lost" << std::endl;
+		return false;
+	};
+	int result = 0;
+	if (inputs.size() == 1 && (inputs.front() == "stats" || inputs.front() == "shutdown")) {
+		cov::compile_request req;
+		req.verb = inputs.front();
+		if (exchange(req))
+			std::cout << body << std::flush;
+		else
+			result = -1;
+		::close(fd);
+		return result;
+	}
+	std::size_t sent = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto &path : inputs) {
+		cov::compile_request req;
+		req.verb = verb;
+		req.language = language.empty() ? language_of(path) : language;
+		if (req.language.empty()) {
+			std::cout << "Unknown language of " << path << ", use -l" << std::endl;
+			result = -1;
+			continue;
+		}
+		if (path == "-")
+			req.payload.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+		else if (send_text) {
+			std::ifstream ifs(path, std::ios::binary);
+			if (!ifs) {
+				std::cout << "Cannot open input file: " << path << std::endl;
+				result = -1;
+				continue;
+			}
+			req.payload.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		}
+		else {
+			// The server may run in another directory
+			req.from_file = true;
+			req.payload = std::filesystem::absolute(path).string();
+		}
+		for (std::size_t i = 0; i < repeat; ++i, ++sent) {
+			if (!exchange(req)) {
+				::close(fd);
+				return -1;
+			}
+		}
+		std::cout << std::endl << path << ":" << std::endl << std::endl << body << std::flush;
+		if (status != "ok")
+			result = -1;
+	}
+	if (repeat > 1) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << sent << " requests in " << seconds * 1e3 << " ms, " << sent / seconds << " requests/s" << std::endl;
+	}
+	::close(fd);
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <cerrno>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace cov {
+	/*
+	 * Framing of the compile server, the same on a Unix domain socket and on stdin/stdout:
+	 *   request:  <verb> [<language> file|text <length>]\n, then length bytes of payload,
+	 *             which is the path of the source file or the source text itself
+	 *   response: ok|fail|bad <length>\n, then length bytes of text
+	 * fail comes with the diagnostics of a program with errors, bad with the reason a request was refused.
+	 */
+	struct compile_request {
+		std::string verb, language, payload;
+		bool from_file = false;
+	};
+
+	enum class frame_status : unsigned char {
+		ok, end, malformed
+	};
+
+	// Buffered reads from a file descriptor, a line or a number of bytes at a time
+	class frame_reader final {
+		int _fd;
+		char _buf[64 * 1024];
+		std::size_t _pos = 0, _len = 0;
+		bool fill()
+		{
+			ssize_t n;
+			do
+				n = ::read(_fd, _buf, sizeof(_buf));
+			while (n < 0 && errno == EINTR);
+			_pos = 0;
+			_len = n > 0 ? n : 0;
+			return _len > 0;
+		}
+	public:
+		explicit frame_reader(int fd) noexcept : _fd(fd) {}
+		frame_reader(const frame_reader &) = delete;
+		frame_reader &operator=(const frame_reader &) = delete;
+		// Line without its '\n', false at the end of input or if the line gets longer than max
+		bool read_line(std::string &line, std::size_t max = 4096)
+		{
+			line.clear();
+			for (;;) {
+				if (_pos == _len && !fill())
+					return false;
+				const char *first = _buf + _pos, *nl = static_cast<const char *>(std::memchr(first, '\n', _len - _pos));
+				std::size_t n = nl != nullptr ? nl - first : _len - _pos;
+				if (line.size() + n > max)
+					return false;
+				line.append(first, n);
+				_pos += n;
+				if (nl != nullptr) {
+					++_pos;
+					return true;
+				}
+			}
+		}
+		// The length comes from the peer, so only this much is reserved before the bytes actually arrive
+		static constexpr std::size_t max_reserve = 1 << 20;
+		bool read_bytes(std::string &data, std::size_t n)
+		{
+			data.clear();
+			data.reserve(std::min(n, max_reserve));
+			while (data.size() < n) {
+				if (_pos == _len && !fill())
+					return false;
+				std::size_t count = std::min(n - data.size(), _len - _pos);
+				data.append(_buf + _pos, count);
+				_pos += count;
+			}
+			return true;
+		}
+	};
+
+	inline bool write_all(int fd, std::string_view data)
+	{
+		while (!data.empty()) {
+			ssize_t n = ::write(fd, data.data(), data.size());
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			data.remove_prefix(n);
+		}
+		return true;
+	}
+
+	// Header of a frame, the first word and the length at the end of its line
+	inline frame_status read_header(frame_reader &in, std::string &line, std::size_t &length)
+	{
+		if (!in.read_line(line))
+			return line.empty() ? frame_status::end : frame_status::malformed;
+		std::size_t sp = line.rfind(' ');
+		length = 0;
+		if (sp == std::string::npos)
+			return frame_status::ok;
+		char *end = nullptr;
+		length = std::strtoull(line.c_str() + sp + 1, &end, 10);
+		if (end == line.c_str() + sp + 1 || *end != '\0')
+			return frame_status::malformed;
+		line.resize(sp);
+		return frame_status::ok;
+	}
+
+	// Payloads above max_payload are refused before anything is read
+	constexpr std::size_t max_payload = std::size_t(1) << 30;
+
+	inline frame_status read_request(frame_reader &in, compile_request &req)
+	{
+		std::string line;
+		std::size_t length;
+		frame_status s = read_header(in, line, length);
+		if (s != frame_status::ok)
+			return s;
+		std::size_t sp = line.find(' ');
+		req.verb = line.substr(0, sp);
+		req.language.clear();
+		req.payload.clear();
+		req.from_file = false;
+		if (sp == std::string::npos)
+			return length == 0 ? frame_status::ok : frame_status::malformed;
+		std::size_t kind = line.find(' ', sp + 1);
+		if (kind == std::string::npos || length > max_payload)
+			return frame_status::malformed;
+		req.language = line.substr(sp + 1, kind - sp - 1);
+		std::string_view source = std::string_view(line).substr(kind + 1);
+		if (source != "file" && source != "text")
+			return frame_status::malformed;
+		req.from_file = source == "file";
+		return in.read_bytes(req.payload, length) ? frame_status::ok : frame_status::malformed;
+	}
+
+	inline bool write_request(int fd, const compile_request &req)
+	{
+		std::string head = req.verb;
+		if (!req.language.empty())
+			head += ' ' + req.language + (req.from_file ? " file " : " text ") + std::to_string(req.payload.size());
+		head += '\n';
+		return write_all(fd, head) && write_all(fd, req.payload);
+	}
+
+	inline frame_status read_response(frame_reader &in, std::string &status, std::string &body)
+	{
+		std::size_t length;
+		frame_status s = read_header(in, status, length);
+		if (s != frame_status::ok)
+			return s;
+		if (status != "ok" && status != "fail" && status != "bad")
+			return frame_status::malformed;
+		return in.read_bytes(body, length) ? frame_status::ok : frame_status::malformed;
+	}
+
+	inline bool write_response(int fd, std::string_view status, std::string_view body)
+	{
+		std::string head(status);
+		head += ' ' + std::to_string(body.size()) + '\n';
+		return write_all(fd, head) && write_all(fd, body);
+	}
+
+	// Address of a Unix domain socket, false if the path does not fit
+	inline bool unix_address(const std::string &path, sockaddr_un &addr)
+	{
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+			errno = ENAMETOOLONG;
+			return false;
+		}
+		std::memcpy(addr.sun_path, path.c_str(), path.size());
+		return true;
+	}
+
+	// Socket connected to a server, -1 on failure with errno set
+	inline int connect_unix(const std::string &path)
+	{
+		sockaddr_un addr;
+		if (!unix_address(path, addr))
+			return -1;
+		int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+			int err = errno;
+			::close(fd);
+			errno = err;
+			return -1;
+		}
+		return fd;
+	}
+
+	// Listening socket, -1 on failure with errno set. A socket file left behind by a server which is gone is replaced
+	inline int listen_unix(const std::string &path, int backlog = 64)
+	{
+		sockaddr_un addr;
+		if (!unix_address(path, addr))
+			return -1;
+		struct stat st;
+		if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+			int probe = connect_unix(path);
+			if (probe >= 0) {
+				::close(probe);
+				errno = EADDRINUSE;
+				return -1;
+			}
+			::unlink(path.c_str());
+		}
+		int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, backlog) != 0) {
+			int err = errno;
+			::close(fd);
+			errno = err;
+			return -1;
+		}
+		return fd;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "tiny.hpp"
+#include "tiny_parser.hpp"
+#include "cminus.hpp"
+#include "cminus_parser.hpp"
+#include "cminus_codegen.hpp"
+#include "grammars.hpp"
+#include "parse_driver.hpp"
+#include "compile_protocol.hpp"
+#include <condition_variable>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <csignal>
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <pthread.h>
+
+/*
+ * Long-running compile server. Grammars are compiled once at startup and every request runs on a workspace
+ * whose lexers, parsers and arenas keep their memory between requests, so a request only pays for its own source.
+ * Serves one client on stdin/stdout, or any number of clients on a Unix domain socket with -s.
+ * Languages: tiny and c- on the native lexers and parsers, peg/tiny, peg/c- and peg/ecs-lang on the parsergen engine.
+ * Verbs: lex, parse, tree, tm (c- only), and stats and shutdown without a language. See compile_protocol.hpp for the framing.
+ * Input nested deeper than the parsers take is refused with "bad", requests run on threads of request_stack bytes of stack
+ * which holds that nesting whatever the default stack size of the system is.
+ */
+
+static constexpr std::size_t request_stack = 64 << 20;
+
+static void *thread_entry(void *arg)
+{
+	std::unique_ptr<std::function<void()>> func(static_cast<std::function<void()> *>(arg));
+	(*func)();
+	return nullptr;
+}
+
+// Runs func on a thread with a stack of request_stack bytes, waits for it unless detached, false if there is no thread
+static bool run_thread(std::function<void()> func, bool detached)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	::pthread_attr_init(&attr);
+	::pthread_attr_setstacksize(&attr, request_stack);
+	if (detached)
+		::pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	auto *arg = new std::function<void()>(std::move(func));
+	int err = ::pthread_create(&thread, &attr, thread_entry, arg);
+	::pthread_attr_destroy(&attr);
+	if (err != 0) {
+		delete arg;
+		errno = err;
+		return false;
+	}
+	if (!detached)
+		::pthread_join(thread, nullptr);
+	return true;
+}
+
+// Counters of the requests served and a window of their latest latencies
+class server_stats final {
+	using clock_t = std::chrono::steady_clock;
+	static constexpr std::size_t window = 4096;
+	std::mutex lock;
+	clock_t::time_point started = clock_t::now();
+	std::size_t requests = 0, failed = 0, refused = 0;
+	double busy = 0;
+	std::vector<double> latencies;
+	std::size_t next = 0;
+	std::map<std::string, std::size_t> languages;
+public:
+	void record(const std::string &language, std::string_view status, double seconds)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		++requests;
+		if (status == "fail")
+			++failed;
+		else if (status == "bad")
+			++refused;
+		busy += seconds;
+		if (latencies.size() < window)
+			latencies.push_back(seconds);
+		else
+			latencies[next] = seconds;
+		next = (next + 1) % window;
+		++languages[language.empty() ? "-" : language];
+	}
+	std::string report(std::size_t workspaces, std::size_t connections)
+	{
+		std::vector<double> sorted;
+		std::ostringstream out;
+		std::lock_guard<std::mutex> guard(lock);
+		double uptime = std::chrono::duration<double>(clock_t::now() - started).count();
+		out << std::fixed << std::setprecision(3);
+		out << "uptime " << uptime << " s, " << requests << " requests (" << failed << " with errors, " << refused << " refused)" << '\n';
+		out << "throughput " << requests / std::max(uptime, 1e-9) << " requests/s, " << requests / std::max(busy, 1e-9) << " requests/s while busy" << '\n';
+		sorted = latencies;
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&](double p) {
+			return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))] * 1e3;
+		};
+		out << "latency p50 " << percentile(0.5) << " ms, p90 " << percentile(0.9) << " ms, p99 " << percentile(0.99) << " ms, max "
+		    << percentile(1) << " ms over the last " << sorted.size() << " requests" << '\n';
+		for (auto &it : languages)
+			out << "language " << it.first << ": " << it.second << " requests" << '\n';
+		out << workspaces << " workspaces, " << connections << " connections" << '\n';
+		return out.str();
+	}
+};
+
+// Everything a request works on, kept warm between requests
+struct workspace {
+	tcc::lexer tiny_lex;
+	tcc::parser tiny_parser;
+	cmcc::lexer cminus_lex;
+	cmcc::parser cminus_parser;
+	cmcc::codegen codegen;
+	parsergen::lexer peg_lex;
+	parsergen::parser peg_parser;
+	cov::mapped_file file;
+	std::ostringstream out;
+};
+
+class compile_server final {
+	struct peg_language {
+		std::string name;
+		parsergen::lexical_dfa dfa;
+		parsergen::syntax_graph graph;
+		peg_language(std::string n, const parsergen::lexical_rules &lex, const parsergen::syntax_rules &stx) : name(std::move(n)), dfa(lex), graph(stx, dfa) {}
+	};
+	std::vector<std::unique_ptr<peg_language>> pegs;
+	server_stats stats;
+	// Workspaces not in use, a request takes one or makes a new one
+	std::mutex pool_lock;
+	std::vector<std::unique_ptr<workspace>> idle;
+	std::size_t workspace_count = 0;
+	// Socket mode: open connections, shut down together with the listening socket
+	std::mutex conn_lock;
+	std::condition_variable conn_done;
+	std::unordered_set<int> connections;
+	int listen_fd = -1;
+	std::atomic<bool> stopping{false};
+	std::unique_ptr<workspace> acquire()
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		if (idle.empty()) {
+			++workspace_count;
+			return std::make_unique<workspace>();
+		}
+		std::unique_ptr<workspace> ws = std::move(idle.back());
+		idle.pop_back();
+		return ws;
+	}
+	void release(std::unique_ptr<workspace> ws)
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		idle.push_back(std::move(ws));
+	}
+	template<typename lexer_t, typename parser_t>
+	const char *compile_native(const cov::compile_request &, lexer_t &, parser_t &, workspace &);
+	const char *compile_peg(const cov::compile_request &, const peg_language &, workspace &);
+	const char *handle(const cov::compile_request &, std::string &);
+	void stop();
+public:
+	compile_server()
+	{
+		pegs.emplace_back(new peg_language("peg/tiny", parsergen::tiny_lexical, parsergen::tiny_syntax));
+		pegs.emplace_back(new peg_language("peg/c-", parsergen::cminus_lexical, parsergen::cminus_syntax));
+		pegs.emplace_back(new peg_language("peg/ecs-lang", parsergen::covscript_lexical, parsergen::covscript_syntax));
+	}
+	// Grammar which could not be built, nullptr if all of them are good
+	const char *bad_grammar() const
+	{
+		for (auto &peg : pegs) {
+			if (!peg->dfa.good() || !peg->graph.good())
+				return peg->name.c_str();
+		}
+		return nullptr;
+	}
+	bool serve(int, int);
+	int serve_socket(const std::string &);
+};
+
+// Lexical errors first, then syntax errors, like the parser drivers
+template<typename lexer_t, typename parser_t>
+const char *compile_server::compile_native(const cov::compile_request &req, lexer_t &lex, parser_t &parser, workspace &ws)
+{
+	auto &out = ws.out;
+	if (req.from_file) {
+		if (!lex.lex_file(req.payload)) {
+			out << "Cannot open input file: " << req.payload << '\n';
+			return "bad";
+		}
+	}
+	else
+		lex.lex(req.payload);
+	bool ok = lex.get_errors().empty();
+	if (req.verb == "lex") {
+		for (auto &e : lex.get_errors())
+			cov::print_caret(out, lex.get_source(), e.line, e.pos, e.offset, lexer_t::get_error(e.type));
+		out << lex.get_results().size() << " tokens" << '\n';
+		return ok ? "ok" : "fail";
+	}
+	ok = parser.parse(lex) && ok;
+	cov::print_errors(out, lex, parser);
+	for (auto &e : parser.get_errors()) {
+		if (e.type == parser_t::error_type::too_deep)
+			return "bad";
+	}
+	if constexpr (std::is_same_v<parser_t, cmcc::parser>) {
+		if (req.verb == "tm") {
+			if (!ok)
+				return "fail";
+			if (!ws.codegen.generate(lex, parser)) {
+				for (auto &e : ws.codegen.get_errors())
+					cov::print_caret(out, lex.get_source(), e.line, e.pos, e.offset, std::string(cmcc::codegen::get_error(e.type)) + " \"" + e.text + "\"");
+				return "fail";
+			}
+			ws.codegen.write(out);
+			return "ok";
+		}
+	}
+	if (req.verb == "tree" && ok)
+		parser.print_tree(out);
+	out << lex.get_results().size() << " tokens, " << parser.get_node_count() << " nodes" << '\n';
+	return ok ? "ok" : "fail";
+}
+
+// Errors in the layout of print_error of parsergen.csp, sorted by line
+const char *compile_server::compile_peg(const cov::compile_request &req, const peg_language &lang, workspace &ws)
+{
+	auto &out = ws.out;
+	std::string_view src = req.payload;
+	if (req.from_file) {
+		if (!ws.file.open(req.payload)) {
+			out << "Cannot open input file: " << req.payload << '\n';
+			return "bad";
+		}
+		src = ws.file.view();
+	}
+	ws.peg_lex.run(lang.dfa, src);
+	std::vector<parsergen::parse_error> errors;
+	for (auto &e : ws.peg_lex.get_errors())
+		errors.push_back({0, e.text, e.line, e.column});
+	bool ok = errors.empty(), too_deep = false;
+	if (req.verb != "lex") {
+		ok = ws.peg_parser.run(lang.graph, ws.peg_lex.get_tokens(), src) && ok;
+		// Only a run of this request tells, the parser of a pooled workspace keeps the flag of its last run
+		too_deep = ws.peg_parser.is_too_deep();
+		if (!ok) {
+			auto log = ws.peg_parser.get_log(0);
+			errors.insert(errors.end(), log.begin(), log.end());
+		}
+	}
+	std::stable_sort(errors.begin(), errors.end(), [](const parsergen::parse_error &a, const parsergen::parse_error &b) {
+		return a.line < b.line;
+	});
+	parsergen::print_errors(out, req.from_file ? std::string_view(req.payload) : "<text>", src, errors);
+	if (too_deep)
+		return "bad";
+	if (req.verb == "tree" && ok)
+		ws.peg_parser.print_ast(out);
+	out << ws.peg_lex.get_tokens().size() << " tokens" << '\n';
+	return ok ? "ok" : "fail";
+}
+
+const char *compile_server::handle(const cov::compile_request &req, std::string &body)
+{
+	if (req.verb != "lex" && req.verb != "parse" && req.verb != "tree" && req.verb != "tm") {
+		body = "Unknown verb: " + req.verb + '\n';
+		return "bad";
+	}
+	if (req.verb == "tm" && req.language != "c-") {
+		body = "Only c- compiles to TM code\n";
+		return "bad";
+	}
+	std::unique_ptr<workspace> ws = acquire();
+	ws->out.str(std::string());
+	const char *status = nullptr;
+	if (req.language == "tiny")
+		status = compile_native(req, ws->tiny_lex, ws->tiny_parser, *ws);
+	else if (req.language == "c-")
+		status = compile_native(req, ws->cminus_lex, ws->cminus_parser, *ws);
+	else {
+		for (auto &peg : pegs) {
+			if (peg->name == req.language)
+				status = compile_peg(req, *peg, *ws);
+		}
+	}
+	if (status == nullptr) {
+		ws->out << "Unknown language: " << req.language << '\n';
+		status = "bad";
+	}
+	body = ws->out.str();
+	release(std::move(ws));
+	return status;
+}
+
+// Requests of one client until it hangs up, false once it asked the server to shut down
+bool compile_server::serve(int in, int out)
+{
+	cov::frame_reader reader(in);
+	cov::compile_request req;
+	std::string body;
+	for (;;) {
+		switch (cov::read_request(reader, req)) {
+		case cov::frame_status::end:
+			return true;
+		case cov::frame_status::malformed:
+			// The stream cannot be trusted to be in step any more
+			cov::write_response(out, "bad", "Malformed request\n");
+			return true;
+		default:
+			break;
+		}
+		if (req.verb == "shutdown") {
+			cov::write_response(out, "ok", "");
+			return false;
+		}
+		if (req.verb == "stats") {
+			std::size_t workspaces, open;
+			{
+				std::lock_guard<std::mutex> guard(pool_lock);
+				workspaces = workspace_count;
+			}
+			{
+				std::lock_guard<std::mutex> guard(conn_lock);
+				open = listen_fd < 0 ? 1 : connections.size();
+			}
+			if (!cov::write_response(out, "ok", stats.report(workspaces, open)))
+				return true;
+			continue;
+		}
+		auto start = std::chrono::steady_clock::now();
+		const char *status = handle(req, body);
+		bool sent = cov::write_response(out, status, body);
+		stats.record(req.language, status, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		if (!sent)
+			return true;
+	}
+}
+
+void compile_server::stop()
+{
+	if (stopping.exchange(true))
+		return;
+	// Wakes up accept() and every connection waiting for its next request
+	::shutdown(listen_fd, SHUT_RDWR);
+	std::lock_guard<std::mutex> guard(conn_lock);
+	for (int fd : connections)
+		::shutdown(fd, SHUT_RDWR);
+}
+
+// One thread per connection, workspaces are shared between all of them
+int compile_server::serve_socket(const std::string &path)
+{
+	listen_fd = cov::listen_unix(path);
+	if (listen_fd < 0) {
+		std::cerr << "Cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+	std::cerr << "Listening on " << path << std::endl;
+	while (!stopping) {
+		int fd = ::accept(listen_fd, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;
+		}
+		std::lock_guard<std::mutex> guard(conn_lock);
+		if (stopping) {
+			::close(fd);
+			break;
+		}
+		connections.insert(fd);
+		bool started = run_thread([this, fd] {
+			if (!serve(fd, fd))
+				stop();
+			std::lock_guard<std::mutex> guard(conn_lock);
+			connections.erase(fd);
+			::close(fd);
+			conn_done.notify_all();
+		}, true);
+		if (!started) {
+			connections.erase(fd);
+			::close(fd);
+		}
+	}
+	stop();
+	std::unique_lock<std::mutex> guard(conn_lock);
+	conn_done.wait(guard, [this] {
+		return connections.empty();
+	});
+	::close(listen_fd);
+	::unlink(path.c_str());
+	return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+	std::string socket_path;
+	bool usage = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (arg == "-s" && i + 1 < argc)
+			socket_path = argv[++i];
+		else
+			usage = true;
+	}
+	// Checking CLI input
+	if (usage) {
+		std::cout << "Usage: compile_server [-s <SOCKET>]" << std::endl;
+		return -1;
+	}
+	// A client hanging up is noticed by the failing write instead
+	std::signal(SIGPIPE, SIG_IGN);
+	auto start = std::chrono::steady_clock::now();
+	compile_server server;
+	if (const char *name = server.bad_grammar()) {
+		std::cerr << "Cannot build grammar " << name << std::endl;
+		return -1;
+	}
+	std::cerr << "Grammars built in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3 << " ms" << std::endl;
+	if (socket_path.empty()) {
+		if (!run_thread([&server] {
+			server.serve(STDIN_FILENO, STDOUT_FILENO);
+		}, false)) {
+			std::cerr << "Cannot start a thread: " << std::strerror(errno) << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+	return server.serve_socket(socket_path);
+}
\ No newline at end of file
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <random>
+
+namespace cov {
+	// Synthetic source shapes for benchmarks, each stresses a different path of the lexers
+	enum class corpus_shape {
+		mixed, comments, identifiers, operators, nesting, long_lines
+	};
+
+	constexpr corpus_shape corpus_shapes[] = {
+		corpus_shape::mixed, corpus_shape::comments, corpus_shape::identifiers,
+		corpus_shape::operators, corpus_shape::nesting, corpus_shape::long_lines
+	};
+
+	inline const char *shape_name(corpus_shape s) noexcept
+	{
+		switch (s) {
+		default:
+			return "mixed";
+		case corpus_shape::comments:
+			return "comments";
+		case corpus_shape::identifiers:
+			return "identifiers";
+		case corpus_shape::operators:
+			return "operators";
+		case corpus_shape::nesting:
+			return "nesting";
+		case corpus_shape::long_lines:
+			return "long_lines";
+		}
+	}
+
+	/*
+	 * Random but well-formed programs, deterministic for a seed.
+	 * Generation stops at the first top-level statement or function after the requested size.
+	 */
+	class corpus_builder {
+	protected:
+		std::mt19937 rng;
+		corpus_shape shape;
+		std::string out;
+		std::size_t depth = 0, limit = 0;
+		std::size_t pick(std::size_t n)
+		{
+			return rng() % n;
+		}
+		bool chance(unsigned percent)
+		{
+			return rng() % 100 < percent;
+		}
+		void ident()
+		{
+			static constexpr char head[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+			static constexpr char tail[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+			std::size_t len = shape == corpus_shape::identifiers ? 12 + pick(28) : 1 + pick(6);
+			out += head[pick(sizeof(head) - 1)];
+			for (std::size_t i = 1; i < len; ++i)
+				out += tail[pick(sizeof(tail) - 1)];
+		}
+		void number()
+		{
+			out += std::to_string(pick(shape == corpus_shape::identifiers ? 100000000 : 1000));
+		}
+		void words(std::size_t n)
+		{
+			static constexpr const char *text[] = {"compute", "the", "value", "of", "x", "and", "store", "it", "loop", "until", "done", "result", "input", "check", "zero"};
+			for (std::size_t i = 0; i < n; ++i) {
+				out += text[pick(std::size(text))];
+				if (shape == corpus_shape::comments && i % 10 == 9)
+					out += '\n';
+				else
+					out += ' ';
+			}
+		}
+		void newline()
+		{
+			if (shape == corpus_shape::long_lines) {
+				out += ' ';
+				return;
+			}
+			out += '\n';
+			out.append(depth, '\t');
+		}
+		// Nesting stops once the size is reached, otherwise the open statements could grow without bound
+		bool can_nest() const
+		{
+			return depth < (shape == corpus_shape::nesting ? 48u : 4u) && out.size() < limit;
+		}
+		std::size_t operands()
+		{
+			return shape == corpus_shape::operators ? 6 + pick(16) : 1 + pick(3);
+		}
+		corpus_builder(corpus_shape s, std::uint32_t seed) : rng(seed), shape(s) {}
+	};
+
+	class tiny_corpus final : corpus_builder {
+		void comment()
+		{
+			out += "{ ";
+			words(shape == corpus_shape::comments ? 20 + pick(60) : 2 + pick(6));
+			out += '}';
+		}
+		void factor(std::size_t level)
+		{
+			// TINY lexes a run of signals as one, so parentheses must not touch another signal
+			if (level < 3 && chance(shape == corpus_shape::operators ? 30 : 10)) {
+				out += " ( ";
+				expression(level + 1);
+				out += " ) ";
+			}
+			else if (chance(30))
+				number();
+			else
+				ident();
+		}
+		void simple(std::size_t level)
+		{
+			static constexpr const char *ops[] = {" + ", " - ", " * ", " / "};
+			static constexpr const char *dense[] = {"+", "-", "*", "/"};
+			factor(level);
+			for (std::size_t i = 1, n = operands(); i < n; ++i) {
+				out += shape == corpus_shape::operators ? dense[pick(4)] : ops[pick(4)];
+				factor(level);
+			}
+		}
+		void expression(std::size_t level)
+		{
+			simple(level);
+			if (chance(30)) {
+				out += chance(50) ? " < " : " = ";
+				simple(level);
+			}
+		}
+		void sequence()
+		{
+			++depth;
+			for (std::size_t i = 0, n = 1 + pick(4); i < n; ++i) {
+				if (i > 0)
+					out += ';';
+				newline();
+				statement();
+			}
+			--depth;
+			newline();
+		}
+		void statement()
+		{
+			if (chance(shape == corpus_shape::comments ? 80 : 15)) {
+				comment();
+				newline();
+			}
+			std::size_t kind = pick(10);
+			if (can_nest() && (shape == corpus_shape::nesting ? kind < 6 : kind < 2)) {
+				if (kind % 2 == 0) {
+					out += "if ";
+					expression(0);
+					out += " then";
+					sequence();
+					if (chance(40)) {
+						out += "else";
+						sequence();
+					}
+					out += "end";
+				}
+				else {
+					out += "repeat";
+					sequence();
+					out += "until ";
+					expression(0);
+				}
+			}
+			else if (kind < 3) {
+				out += "read ";
+				ident();
+			}
+			else if (kind < 4) {
+				out += "write ";
+				expression(0);
+			}
+			else {
+				ident();
+				out += " := ";
+				expression(0);
+			}
+		}
+	public:
+		tiny_corpus(corpus_shape s, std::uint32_t seed = 1) : corpus_builder(s, seed) {}
+		std::string generate(std::size_t bytes)
+		{
+			out.clear();
+			out.reserve(bytes + 4096);
+			limit = bytes;
+			while (out.size() < bytes) {
+				if (!out.empty())
+					out += ";\n";
+				statement();
+			}
+			out += '\n';
+			return std::move(out);
+		}
+	};
+
+	class cminus_corpus final : corpus_builder {
+		void comment()
+		{
+			out += "/* ";
+			words(shape == corpus_shape::comments ? 20 + pick(60) : 2 + pick(6));
+			out += "*/";
+		}
+		void factor(std::size_t level)
+		{
+			std::size_t kind = pick(10);
+			if (level < 3 && kind < (shape == corpus_shape::operators ? 3u : 1u)) {
+				out += '(';
+				expression(level + 1);
+				out += ')';
+			}
+			else if (kind < 4)
+				number();
+			else if (level < 3 && kind < 5) {
+				ident();
+				out += '[';
+				expression(level + 1);
+				out += ']';
+			}
+			else if (level < 3 && kind < 6) {
+				ident();
+				out += '(';
+				expression(level + 1);
+				out += ", ";
+				expression(level + 1);
+				out += ')';
+			}
+			else
+				ident();
+		}
+		void expression(std::size_t level)
+		{
+			static constexpr const char *ops[] = {" + ", " - ", " * ", " / "};
+			static constexpr const char *dense[] = {"+", "-", "*", "/"};
+			static constexpr const char *rel[] = {" < ", " <= ", " > ", " >= ", " == ", " ~= "};
+			factor(level);
+			for (std::size_t i = 1, n = operands(); i < n; ++i) {
+				out += shape == corpus_shape::operators ? dense[pick(4)] : ops[pick(4)];
+				factor(level);
+			}
+			if (chance(20)) {
+				out += rel[pick(6)];
+				factor(level);
+			}
+		}
+		void compound()
+		{
+			out += '{';
+			++depth;
+			for (std::size_t i = 0, n = pick(3); i < n; ++i) {
+				newline();
+				out += "int ";
+				ident();
+				out += ';';
+			}
+			for (std::size_t i = 0, n = 1 + pick(4); i < n; ++i) {
+				newline();
+				statement();
+			}
+			--depth;
+			newline();
+			out += '}';
+		}
+		void statement()
+		{
+			if (chance(shape == corpus_shape::comments ? 80 : 15)) {
+				comment();
+				newline();
+			}
+			std::size_t kind = pick(10);
+			if (can_nest() && (shape == corpus_shape::nesting ? kind < 6 : kind < 2)) {
+				if (kind % 2 == 0) {
+					out += "if (";
+					expression(0);
+					out += ") ";
+					compound();
+					if (chance(40)) {
+						out += " else ";
+						compound();
+					}
+				}
+				else {
+					out += "while (";
+					expression(0);
+					out += ") ";
+					compound();
+				}
+			}
+			else if (kind < 3) {
+				out += "return ";
+				expression(0);
+				out += ';';
+			}
+			else {
+				ident();
+				if (chance(20)) {
+					out += '[';
+					expression(0);
+					out += ']';
+				}
+				out += " = ";
+				expression(0);
+				out += ';';
+			}
+		}
+		void function()
+		{
+			out += chance(50) ? "int " : "void ";
+			ident();
+			out += "(int ";
+			ident();
+			out += ", int ";
+			ident();
+			out += "[]) ";
+			compound();
+			out += '\n';
+		}
+	public:
+		cminus_corpus(corpus_shape s, std::uint32_t seed = 1) : corpus_builder(s, seed) {}
+		std::string generate(std::size_t bytes)
+		{
+			out.clear();
+			out.reserve(bytes + 4096);
+			limit = bytes;
+			while (out.size() < bytes)
+				function();
+			return std::move(out);
+		}
+	};
+}
\ No newline at end of file
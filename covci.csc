@@ -109,6 +109,8 @@ end
 struct syntax_impl
     var type = null
     var data = null
+    # Dispatch Table of cond_or, built by first_sets
+    var table = null
 end
 
 namespace syntax_type
@@ -170,6 +172,158 @@ struct parse_error
     var pos = {0, 0}
 end
 
+# FIRST Sets
+# An alternative which can not match empty input fails at once on any token outside its FIRST set,
+# logging "Unexpected Token" and "No matching syntax" if a cond_or on its way fails too.
+# Such alternatives are skipped, all the others are still tried in order.
+
+struct first_info
+    var types = new hash_set
+    var terms = new hash_set
+    var nullable = false
+    var logs_n = false
+end
+
+struct dispatch_table
+    # FIRST Sets of Alternatives
+    var alts = new array
+    # Token Type -> Term(or "") -> Alternatives to Skip
+    var cache = new hash_map
+end
+
+class first_sets
+    var syn = null
+    var rules = new hash_map
+    # Terms of the grammar, other token data share one entry of the cache
+    var terms = new hash_set
+    var with_logs = false
+    function item(it)
+        var n = new first_info
+        switch it.type
+            case syntax_type.token
+                n.types.insert(it.data)
+            end
+            case syntax_type.term
+                n.terms.insert(it.data)
+                terms.insert(it.data)
+            end
+            case syntax_type.ref
+                return rules[it.data]
+            end
+            case syntax_type.repeat
+                n = sequence(it.data)
+                n.nullable = true
+            end
+            case syntax_type.opt
+                n = sequence(it.data)
+                n.nullable = true
+            end
+            case syntax_type.cond
+                foreach seq in it.data
+                    var alt = sequence(seq)
+                    foreach t in alt.types do n.types.insert(t)
+                    foreach t in alt.terms do n.terms.insert(t)
+                    # Alternatives are tried until one of them matches empty input
+                    if !n.nullable
+                        n.logs_n = n.logs_n || alt.logs_n
+                    end
+                    n.nullable = n.nullable || alt.nullable
+                end
+                n.logs_n = n.logs_n || !n.nullable
+            end
+        end
+        return move(n)
+    end
+    function sequence(seq)
+        var n = new first_info
+        n.nullable = true
+        foreach it in seq
+            var next = item(it)
+            foreach t in next.types do n.types.insert(t)
+            foreach t in next.terms do n.terms.insert(t)
+            n.logs_n = n.logs_n || next.logs_n
+            if !next.nullable
+                n.nullable = false
+                break
+            end
+        end
+        return move(n)
+    end
+    # Sets only grow, so the sizes tell whether a rule has changed
+    function solve()
+        var changed = true
+        while changed
+            changed = false
+            foreach it in syn
+                var n = sequence(it.second)
+                if !with_logs
+                    n.logs_n = false
+                end
+                link old = rules[it.first]
+                if n.types.size != old.types.size || n.terms.size != old.terms.size || n.nullable != old.nullable || n.logs_n != old.logs_n
+                    rules[it.first] = move(n)
+                    changed = true
+                end
+            end
+        end
+    end
+    function attach(seq)
+        foreach it in seq
+            if it.type == syntax_type.cond
+                # A syntax built before keeps its tables, with what their caches hold
+                if it.table == null
+                    var table = new dispatch_table
+                    foreach alt in it.data
+                        table.alts.push_back(sequence(alt))
+                        attach(alt)
+                    end
+                    it.table = move(table)
+                end
+            else
+                if it.type == syntax_type.repeat || it.type == syntax_type.opt
+                    attach(it.data)
+                end
+            end
+        end
+    end
+    function build(grammar)
+        syn = grammar
+        foreach it in syn do rules.insert(it.first, new first_info)
+        solve()
+        # Whether a failure logs "No matching syntax" is only known once nullable is final
+        with_logs = true
+        solve()
+        foreach it in syn do attach(it.second)
+    end
+    # 0: Try, 1: Skip, 2: Skip and log "No matching syntax" too
+    function select(table, tok)
+        var term = ""
+        if terms.exist(tok.data)
+            term = tok.data
+        end
+        if !table.cache.exist(tok.type)
+            table.cache.insert(tok.type, new hash_map)
+        end
+        link by_term = table.cache[tok.type]
+        if !by_term.exist(term)
+            var skip = new array
+            foreach alt in table.alts
+                if alt.nullable || alt.types.exist(tok.type) || alt.terms.exist(tok.data)
+                    skip.push_back(0)
+                else
+                    if alt.logs_n
+                        skip.push_back(2)
+                    else
+                        skip.push_back(1)
+                    end
+                end
+            end
+            by_term.insert(term, move(skip))
+        end
+        return by_term[term]
+    end
+end
+
 struct parser
     # Error Reporting
     var error_log = new array
@@ -178,6 +332,7 @@ struct parser
     var stack = new array
     var syn = null
     var lex = null
+    var first = null
     # Logging
     var log_indent = 0
     var log = false
@@ -347,15 +502,30 @@ struct parser
             end
             case syntax_type.cond
                 var matched = false
+                var skip = null
+                if it.table != null
+                    skip = first.select(it.table, peek())
+                end
+                var idx = 0
                 foreach seq in it.data
-                    push_stage("cond_or")
-                    if match_syntax(seq) == 1
-                        matched = true
-                        merge()
-                        break
+                    if skip != null && skip[idx] != 0
+                        # Logs what trying it would log
+                        parse_log("Skip   cond_or")
+                        error("Unexpected Token \'" + peek().data + "\'", peek().pos)
+                        if skip[idx] == 2
+                            error("No matching syntax", peek().pos)
+                        end
                     else
-                        pop_stage()
+                        push_stage("cond_or")
+                        if match_syntax(seq) == 1
+                            matched = true
+                            merge()
+                            break
+                        else
+                            pop_stage()
+                        end
                     end
+                    ++idx
                 end
                 if !matched
                     error("No matching syntax", peek().pos)
@@ -365,9 +535,11 @@ struct parser
         end
         return 1
     end
-    function run(grammar, lex_output)
+    # tables: first_sets built for the grammar, only read here
+    function run(grammar, lex_output, tables)
         syn = grammar
         lex = lex_output
+        first = tables
         push_stage("begin")
         return match_syntax(syn.begin) != 0 && eof()
     end
@@ -599,8 +771,11 @@ end
 var p = new parser
 p.log = true
 
+var cminus_first = new first_sets
+cminus_first.build(cminus_syntax)
+
 print_header("Begin Syntactic Analysis...")
-var result = p.run(cminus_syntax, lex)
+var result = p.run(cminus_syntax, lex, cminus_first)
 
 if result
     if !l.error_log.empty()
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "parsergen.hpp"
+
+// Grammars of parsergen.csc and ecs_parser.csp
+namespace parsergen {
+	extern const lexical_rules tiny_lexical;
+
+	extern const lexical_rules cminus_lexical;
+
+	extern const lexical_rules covscript_lexical;
+
+	extern const syntax_rules tiny_syntax;
+
+	extern const syntax_rules cminus_syntax;
+
+	extern const syntax_rules covscript_syntax;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace cov {
+	/*
+	 * Integer I/O of the interpreters: input comes from a buffer or is read a line at a time from
+	 * a stream when the program asks for it, output is collected and written to the sink in large
+	 * blocks, or kept in memory without a sink.
+	 */
+	class io_buffer final {
+		std::string_view input;
+		std::size_t pos = 0;
+		std::string lines, output;
+		std::FILE *source = nullptr, *sink;
+
+		// Appends the next line of the source, pending output goes first as it may prompt for it
+		bool fill()
+		{
+			if (source == nullptr)
+				return false;
+			flush();
+			std::size_t size = lines.size();
+			for (int c; (c = std::getc(source)) != EOF;) {
+				lines.push_back(static_cast<char>(c));
+				if (c == '\n')
+					break;
+			}
+			input = lines;
+			return lines.size() > size;
+		}
+	public:
+		enum class result : unsigned char {
+			ok, end_of_input, invalid_input
+		};
+		explicit io_buffer(std::string_view in, std::FILE *out = nullptr) : input(in), sink(out) {}
+		// Nothing is read from the stream before the first read, so a program without input never waits on it
+		io_buffer(std::FILE *in, std::FILE *out) : source(in), sink(out) {}
+		io_buffer(const io_buffer &) = delete;
+		~io_buffer()
+		{
+			flush();
+		}
+		// Integers are decimal with an optional sign and separated by white space, too large ones wrap around
+		result read(std::int32_t &value)
+		{
+			do {
+				while (pos < input.size() && (input[pos] == ' ' || input[pos] == '\t' || input[pos] == '\r' || input[pos] == '\n'))
+					++pos;
+			} while (pos == input.size() && fill());
+			if (pos == input.size())
+				return result::end_of_input;
+			bool neg = input[pos] == '-';
+			if (neg || input[pos] == '+')
+				++pos;
+			if (pos == input.size() || input[pos] < '0' || input[pos] > '9')
+				return result::invalid_input;
+			std::uint32_t n = 0;
+			for (; pos < input.size() && input[pos] >= '0' && input[pos] <= '9'; ++pos)
+				n = n * 10 + (input[pos] - '0');
+			value = static_cast<std::int32_t>(neg ? 0u - n : n);
+			return result::ok;
+		}
+		void write(std::int32_t value)
+		{
+			char buff[16];
+			auto res = std::to_chars(buff, buff + sizeof(buff), value);
+			*res.ptr++ = '\n';
+			output.append(buff, res.ptr);
+			if (sink != nullptr && output.size() >= 65536)
+				flush();
+		}
+		void flush()
+		{
+			if (sink == nullptr)
+				return;
+			std::fwrite(output.data(), 1, output.size(), sink);
+			std::fflush(sink);
+			output.clear();
+		}
+		// Start over from the beginning of the input and drop pending output, lines of a stream read so far are kept
+		void rewind() noexcept
+		{
+			pos = 0;
+			output.clear();
+		}
+		inline const std::string &get_output() const noexcept
+		{
+			return output;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include "tiny.hpp"
+#include "cminus.hpp"
+#include "tiny_static.hpp"
+#include "cminus_static.hpp"
+#include "corpus_gen.hpp"
+#include "token_writer.hpp"
+#include <sys/resource.h>
+#include <string_view>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <new>
+
+/*
+ * Lexer throughput benchmark on generated TINY and C- programs.
+ * Every sample runs a fresh lexer over a file on disk end to end, the fastest of the repeats is reported.
+ * The stream variants pull the tokens block by block instead of keeping them all.
+ * The static lexers are only timed once they gave the same tokens, symbols and errors as the lexers they stand in for.
+ * Results are JSON, one result per line, and can be checked against an earlier run with -b.
+ */
+
+// Counting every allocation of the process, the lexers only allocate through new
+static std::atomic<std::size_t> alloc_count(0);
+
+void *operator new(std::size_t size)
+{
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	if (void *p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+// Peak resident set in KiB, reset between samples where the kernel allows it
+static void reset_peak_rss()
+{
+	std::ofstream clear("/proc/self/clear_refs");
+	if (clear)
+		clear << "5";
+}
+
+static std::size_t peak_rss()
+{
+	std::ifstream status("/proc/self/status");
+	for (std::string line; std::getline(status, line);)
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return std::strtoul(line.c_str() + 6, nullptr, 10);
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+struct bench_result {
+	std::string lexer, shape;
+	std::size_t bytes = 0, tokens = 0, errors = 0, allocs = 0, peak_rss_kb = 0;
+	double seconds = 0;
+	// A sample too short for the clock counts as no measurement
+	double mb_per_s() const
+	{
+		return seconds <= 0 ? 0 : bytes / seconds / (1024 * 1024);
+	}
+	double tokens_per_s() const
+	{
+		return seconds <= 0 ? 0 : tokens / seconds;
+	}
+	double allocs_per_token() const
+	{
+		return tokens == 0 ? 0 : double(allocs) / tokens;
+	}
+};
+
+template<typename lexer_t, bool stream = false>
+bench_result run_bench(const char *name, const char *extension, cov::corpus_shape shape, const std::string &source, std::size_t repeats)
+{
+	bench_result r;
+	r.lexer = name;
+	r.shape = cov::shape_name(shape);
+	r.bytes = source.size();
+	std::string path = std::string("lexer_bench.") + name + extension;
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(source.data(), source.size());
+	}
+	for (std::size_t i = 0; i < repeats; ++i) {
+		reset_peak_rss();
+		std::size_t allocs = alloc_count.load();
+		auto start = std::chrono::steady_clock::now();
+		std::size_t tokens, errors;
+		{
+			lexer_t lex;
+			if constexpr (stream) {
+				// Tokens are pulled one at a time, errors are counted per block at its first token
+				tokens = errors = 0;
+				lex.open_stream(path);
+				for (const auto *t = lex.next_token(); t != nullptr; t = lex.next_token()) {
+					if (t == lex.get_results().data())
+						errors += lex.get_errors().size();
+					++tokens;
+				}
+			}
+			else {
+				lex.lex_file(path);
+				tokens = lex.get_results().size();
+				errors = lex.get_errors().size();
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || seconds < r.seconds) {
+			r.seconds = seconds;
+			r.tokens = tokens;
+			r.errors = errors;
+			r.allocs = alloc_count.load() - allocs;
+			r.peak_rss_kb = peak_rss();
+		}
+	}
+	std::remove(path.c_str());
+	return r;
+}
+
+// First token or error where a static lexer and the lexer it stands in for disagree, empty if there is none
+template<typename static_t, typename lexer_t>
+static std::string compare_output(const std::string &source)
+{
+	static_t fast;
+	lexer_t ref;
+	fast.lex(source);
+	ref.lex(source);
+	auto a = fast.get_results(), b = ref.get_results();
+	for (std::size_t i = 0; i < std::max(a.size(), b.size()); ++i) {
+		if (i >= a.size() || i >= b.size() || a[i].type != b[i].type || a[i].subtype != b[i].subtype || a[i].symbol != b[i].symbol
+		        || a[i].offset != b[i].offset || a[i].length != b[i].length)
+			return "token " + std::to_string(i) + " of " + std::to_string(b.size());
+	}
+	for (std::uint32_t i = 0; i < ref.get_symbols().size(); ++i) {
+		if (i >= fast.get_symbols().size() || fast.get_symbols().get(i) != ref.get_symbols().get(i))
+			return "symbol " + std::to_string(i);
+	}
+	auto &x = fast.get_errors(), &y = ref.get_errors();
+	for (std::size_t i = 0; i < std::max(x.size(), y.size()); ++i) {
+		if (i >= x.size() || i >= y.size() || x[i].type != y[i].type || x[i].text != y[i].text || x[i].line != y[i].line
+		        || x[i].pos != y[i].pos || x[i].offset != y[i].offset || x[i].index != y[i].index)
+			return "error " + std::to_string(i) + " of " + std::to_string(y.size());
+	}
+	return std::string();
+}
+
+static void write_result(cov::output_buffer &out, const bench_result &r)
+{
+	out.write("{\"lexer\":");
+	cov::write_json_string(out, r.lexer);
+	out.write(",\"shape\":");
+	cov::write_json_string(out, r.shape);
+	out.write(",\"bytes\":").write_int(r.bytes).write(",\"tokens\":").write_int(r.tokens).write(",\"errors\":").write_int(r.errors);
+	out.write(",\"seconds\":").write_double(r.seconds).write(",\"mb_per_s\":").write_double(r.mb_per_s());
+	out.write(",\"tokens_per_s\":").write_double(r.tokens_per_s()).write(",\"allocs_per_token\":").write_double(r.allocs_per_token());
+	out.write(",\"peak_rss_kb\":").write_int(r.peak_rss_kb).write("}\n");
+}
+
+// Only reads back what write_result() writes, a number after "key":
+static double json_number(std::string_view line, std::string_view key)
+{
+	std::size_t p = line.find("\"" + std::string(key) + "\":");
+	if (p == std::string_view::npos)
+		return 0;
+	return std::strtod(std::string(line.substr(p + key.size() + 3)).c_str(), nullptr);
+}
+
+static std::string json_label(std::string_view line, std::string_view key)
+{
+	std::size_t p = line.find("\"" + std::string(key) + "\":\"");
+	if (p == std::string_view::npos)
+		return std::string();
+	line.remove_prefix(p + key.size() + 4);
+	return std::string(line.substr(0, line.find('"')));
+}
+
+// Print the change of throughput against a baseline run, false if anything got slower than tolerated
+static bool compare(const std::string &baseline, const std::vector<bench_result> &results, double tolerance)
+{
+	std::ifstream file(baseline);
+	if (!file) {
+		std::cerr << "Cannot open baseline file: " << baseline << std::endl;
+		return false;
+	}
+	bool ok = true;
+	for (std::string line; std::getline(file, line);) {
+		std::string lexer = json_label(line, "lexer"), shape = json_label(line, "shape");
+		double old_speed = json_number(line, "mb_per_s");
+		auto it = std::find_if(results.begin(), results.end(), [&](const bench_result &r) {
+			return r.lexer == lexer && r.shape == shape;
+		});
+		if (it == results.end() || old_speed <= 0 || it->mb_per_s() <= 0)
+			continue;
+		double ratio = it->mb_per_s() / old_speed;
+		bool slower = ratio < 1 - tolerance;
+		std::cerr << lexer << '/' << shape << ": " << old_speed << " -> " << it->mb_per_s() << " MB/s (" << (ratio - 1) * 100 << "%)" << (slower ? " REGRESSION" : "") << '\n';
+		if (slower)
+			ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, const char *argv[])
+{
+	std::size_t size = 8, repeats = 5;
+	double tolerance = 0.1;
+	std::string output = "lexer_bench.json", baseline, only_lexer, only_shape;
+	bool usage = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 >= argc)
+			usage = true;
+		else if (arg == "-s")
+			size = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-r")
+			repeats = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-o")
+			output = argv[++i];
+		else if (arg == "-b")
+			baseline = argv[++i];
+		else if (arg == "-t")
+			tolerance = std::strtod(argv[++i], nullptr) / 100;
+		else if (arg == "-l")
+			only_lexer = argv[++i];
+		else if (arg == "-p")
+			only_shape = argv[++i];
+		else
+			usage = true;
+	}
+	if (usage || size == 0 || repeats == 0) {
+		std::cout << "Usage: lexer_bench [-s <MB>] [-r <REPEATS>] [-l tcc|cmcc|tcc_stream|cmcc_stream|tcc_static|cmcc_static] [-p <SHAPE>] [-o <RESULT>.json] [-b <BASELINE>.json] [-t <PERCENT>]" << std::endl;
+		return -1;
+	}
+	std::vector<bench_result> results;
+	bool equal = true;
+	// Checked on the corpus it is then timed on
+	auto check = [&](const char *name, const char *ref, cov::corpus_shape shape, const std::string &diff) {
+		if (!diff.empty()) {
+			std::cerr << name << '/' << cov::shape_name(shape) << ": " << diff << " differs from " << ref << ", not timed" << std::endl;
+			equal = false;
+		}
+		return diff.empty();
+	};
+	for (cov::corpus_shape shape : cov::corpus_shapes) {
+		if (!only_shape.empty() && only_shape != cov::shape_name(shape))
+			continue;
+		if (only_lexer.empty() || only_lexer == "tcc")
+			results.push_back(run_bench<tcc::lexer>("tcc", ".tny", shape, cov::tiny_corpus(shape).generate(size << 20), repeats));
+		if (only_lexer.empty() || only_lexer == "cmcc")
+			results.push_back(run_bench<cmcc::lexer>("cmcc", ".c-", shape, cov::cminus_corpus(shape).generate(size << 20), repeats));
+		if (only_lexer.empty() || only_lexer == "tcc_stream")
+			results.push_back(run_bench<tcc::lexer, true>("tcc_stream", ".tny", shape, cov::tiny_corpus(shape).generate(size << 20), repeats));
+		if (only_lexer.empty() || only_lexer == "cmcc_stream")
+			results.push_back(run_bench<cmcc::lexer, true>("cmcc_stream", ".c-", shape, cov::cminus_corpus(shape).generate(size << 20), repeats));
+		if (only_lexer.empty() || only_lexer == "tcc_static") {
+			std::string source = cov::tiny_corpus(shape).generate(size << 20);
+			if (check("tcc_static", "tcc", shape, compare_output<tcc::static_lexer, tcc::lexer>(source)))
+				results.push_back(run_bench<tcc::static_lexer>("tcc_static", ".tny", shape, source, repeats));
+		}
+		if (only_lexer.empty() || only_lexer == "cmcc_static") {
+			std::string source = cov::cminus_corpus(shape).generate(size << 20);
+			if (check("cmcc_static", "cmcc", shape, compare_output<cmcc::static_lexer, cmcc::lexer>(source)))
+				results.push_back(run_bench<cmcc::static_lexer>("cmcc_static", ".c-", shape, source, repeats));
+		}
+	}
+	cov::output_buffer out;
+	if (!out.open(output)) {
+		std::cerr << "Cannot open output file: " << output << std::endl;
+		return -1;
+	}
+	for (auto &r : results) {
+		std::cerr << r.lexer << '/' << r.shape << ": " << r.mb_per_s() << " MB/s, " << r.tokens_per_s() << " tokens/s, "
+		          << r.allocs_per_token() << " allocs/token, " << r.peak_rss_kb << " KiB peak" << '\n';
+		write_result(out, r);
+	}
+	std::cerr << "Writing result to: " << output << std::endl;
+	out.close();
+	bool ok = baseline.empty() || compare(baseline, results, tolerance);
+	return ok && equal ? 0 : 1;
+}
\ No newline at end of file
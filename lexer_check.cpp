@@ -0,0 +1,248 @@
+#include "tiny.hpp"
+#include "cminus.hpp"
+#include "tiny_static.hpp"
+#include "cminus_static.hpp"
+#include "corpus_gen.hpp"
+#include <string_view>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+/*
+ * Differential check of the lexers: every way of lexing a buffer has to give what a fresh lex() gives.
+ * On generated TINY and C- programs of every corpus shape, with random snippets scattered over them so that
+ * comments open and close elsewhere and errors turn up, it compares
+ *   parallel  lex() on a thread pool with small chunks, so that chunks often start inside comments,
+ *   stream    next_token() over a stream in small blocks, offsets taken relative to the stream,
+ *   edit      a run of random edits, each one checked against a fresh lex() of the edited text,
+ *   static    the static lexer built from rule tables at compile time,
+ *   read_next the text, line and column of the errors of character by character lexing.
+ * Tokens are compared with the text of their symbols, ids of an edited buffer may differ.
+ * The first difference of every check is printed, the exit status tells whether there was any.
+ */
+
+struct check_options {
+	std::size_t size = 256 * 1024, edit_size = 16 * 1024, edits = 2000, block = 1000, chunk = 4096, workers = 4;
+	std::uint32_t seed = 1;
+};
+
+template<typename lexer_t, typename ref_t, typename token_t>
+static bool same_token(const lexer_t &a, const token_t &x, const ref_t &b, const token_t &y, std::uint64_t shift = 0)
+{
+	if (x.type != y.type || x.subtype != y.subtype || x.offset + shift != y.offset || x.length != y.length)
+		return false;
+	return !a.view(x).has_symbol() || a.get_symbols().get(x.symbol) == b.get_symbols().get(y.symbol);
+}
+
+template<typename error_t>
+static bool same_error(const error_t &x, const error_t &y, std::uint64_t shift = 0, std::size_t index_shift = 0)
+{
+	return x.type == y.type && x.text == y.text && x.line == y.line && x.pos == y.pos && x.offset + shift == y.offset && x.index + index_shift == y.index;
+}
+
+template<typename lexer_t>
+static std::string describe(const lexer_t &lex, std::size_t i)
+{
+	auto tokens = lex.get_results();
+	if (i >= tokens.size())
+		return "end of tokens";
+	auto v = lex.view(tokens[i]);
+	return "token " + std::to_string(i) + " " + v.to_string() + " at offset " + std::to_string(v.get_offset());
+}
+
+// First difference of the tokens and errors of a against those of the reference, empty if there is none
+template<typename lexer_t, typename ref_t>
+static std::string compare(const lexer_t &lex, const ref_t &ref)
+{
+	auto a = lex.get_results(), b = ref.get_results();
+	for (std::size_t i = 0; i < std::max(a.size(), b.size()); ++i) {
+		if (i >= a.size() || i >= b.size() || !same_token(lex, a[i], ref, b[i]))
+			return describe(lex, i) + ", expected " + describe(ref, i);
+	}
+	auto &x = lex.get_errors(), &y = ref.get_errors();
+	for (std::size_t i = 0; i < std::max(x.size(), y.size()); ++i) {
+		if (i >= x.size() || i >= y.size() || !same_error(x[i], y[i]))
+			return "error " + std::to_string(i) + " differs, " + std::to_string(x.size()) + " errors, expected " + std::to_string(y.size());
+	}
+	return std::string();
+}
+
+template<typename lexer_t>
+static std::string check_parallel(const std::string &src, const lexer_t &ref, const check_options &opt)
+{
+	cov::thread_pool pool(opt.workers);
+	lexer_t lex;
+	lex.lex(src, pool, opt.chunk);
+	return compare(lex, ref);
+}
+
+// Blocks are checked one by one as the stream moves on, a block only keeps its own tokens and errors
+template<typename lexer_t>
+static std::string check_stream(const std::string &src, const lexer_t &ref, const check_options &opt)
+{
+	std::istringstream in(src);
+	lexer_t lex;
+	lex.open_stream(in, opt.block);
+	auto tokens = ref.get_results();
+	auto &errors = ref.get_errors();
+	std::size_t i = 0, e = 0;
+	for (const auto *t = lex.next_token(); t != nullptr; t = lex.next_token(), ++i) {
+		auto block = lex.get_results();
+		// Errors of a block are checked at its first token
+		if (t == block.data()) {
+			for (auto &err : lex.get_errors()) {
+				if (e >= errors.size() || !same_error(err, errors[e], lex.get_base(), i))
+					return "error " + std::to_string(e) + " differs in the block at " + std::to_string(lex.get_base());
+				++e;
+			}
+		}
+		if (i >= tokens.size() || !same_token(lex, *t, ref, tokens[i], lex.get_base()))
+			return "token " + std::to_string(i) + " " + lex.view(*t).to_string() + " in the block at " + std::to_string(lex.get_base()) + ", expected " + describe(ref, i);
+	}
+	if (i != tokens.size())
+		return std::to_string(i) + " tokens, expected " + std::to_string(tokens.size());
+	// Errors after the last token come with the final, empty block
+	for (auto &err : lex.get_errors()) {
+		if (e >= errors.size() || !same_error(err, errors[e], lex.get_base(), i))
+			return "error " + std::to_string(e) + " differs at the end of input";
+		++e;
+	}
+	if (e != errors.size())
+		return std::to_string(e) + " errors, expected " + std::to_string(errors.size());
+	return std::string();
+}
+
+static std::string scatter(std::string src, const char *const *snippets, std::size_t snippet_count, std::size_t count, std::mt19937 &rng)
+{
+	for (std::size_t n = 0; n < count; ++n)
+		src.insert(rng() % (src.size() + 1), snippets[rng() % snippet_count]);
+	return src;
+}
+
+// Edits insert snippets which open and close comments, split tokens and bring in unexpected characters
+template<typename lexer_t>
+static std::string check_edits(std::string src, const char *const *snippets, std::size_t snippet_count, const check_options &opt)
+{
+	std::mt19937 rng(opt.seed);
+	lexer_t lex, ref;
+	lex.lex(src);
+	for (std::size_t n = 0; n < opt.edits; ++n) {
+		std::string_view text = lex.get_source();
+		std::size_t at = rng() % (text.size() + 1), removed = rng() % 4 == 0 ? rng() % 16 : 0;
+		std::string inserted;
+		for (std::size_t k = 0, count = rng() % 3; k < count; ++k)
+			inserted += snippets[rng() % snippet_count];
+		lex.edit(at, removed, inserted);
+		src = lex.get_source();
+		ref.lex(src);
+		std::string diff = compare(lex, ref);
+		if (!diff.empty())
+			return "after edit " + std::to_string(n) + " at " + std::to_string(at) + " removing " + std::to_string(removed) + ": " + diff;
+	}
+	return std::string();
+}
+
+template<typename static_t, typename lexer_t>
+static std::string check_static(const std::string &src, const lexer_t &ref)
+{
+	static_t lex;
+	lex.lex(src);
+	return compare(lex, ref);
+}
+
+// Driven as the scanners of the reference compilers do, a character ending a token is read once more
+template<typename lexer_t>
+static std::string check_read_next(const std::string &src, const lexer_t &ref)
+{
+	lexer_t lex;
+	auto &errors = ref.get_errors();
+	std::size_t e = 0;
+	bool next = true;
+	// A trailing blank ends the last token as the end of input does
+	std::string text = src + ' ';
+	for (std::size_t i = 0; i < text.size();) {
+		auto s = lex.read_next(text[i], next);
+		next = true;
+		if (lex.error_state()) {
+			if (e >= errors.size() || lex.get_buffer() != errors[e].text || lex.get_line() != errors[e].line || lex.get_pos() != errors[e].pos)
+				return "error " + std::to_string(e) + " at line " + std::to_string(lex.get_line() + 1) + " pos " + std::to_string(lex.get_pos()) + " differs";
+			++e;
+			lex.reset_status();
+		}
+		else if (s == lexer_t::state::output) {
+			lex.get_output();
+			next = false;
+			continue;
+		}
+		++i;
+	}
+	if (e != errors.size())
+		return std::to_string(e) + " errors, expected " + std::to_string(errors.size());
+	return std::string();
+}
+
+template<typename lexer_t, typename static_t, typename corpus_t>
+static bool check_language(const char *name, const char *const *snippets, std::size_t snippet_count, const std::string &only_shape, const check_options &opt)
+{
+	bool ok = true;
+	auto report = [&](cov::corpus_shape shape, const char *check, const std::string &diff) {
+		std::cout << name << '/' << cov::shape_name(shape) << ' ' << check << ": " << (diff.empty() ? "ok" : diff) << std::endl;
+		ok = ok && diff.empty();
+	};
+	for (cov::corpus_shape shape : cov::corpus_shapes) {
+		if (!only_shape.empty() && only_shape != cov::shape_name(shape))
+			continue;
+		std::mt19937 rng(opt.seed);
+		std::string src = scatter(corpus_t(shape, opt.seed).generate(opt.size), snippets, snippet_count, opt.size / 1024, rng);
+		lexer_t ref;
+		ref.lex(src);
+		report(shape, "parallel", check_parallel(src, ref, opt));
+		report(shape, "stream", check_stream(src, ref, opt));
+		report(shape, "static", check_static<static_t>(src, ref));
+		report(shape, "read_next", check_read_next(src, ref));
+		report(shape, "edit", check_edits<lexer_t>(corpus_t(shape, opt.seed).generate(opt.edit_size), snippets, snippet_count, opt));
+	}
+	return ok;
+}
+
+int main(int argc, const char *argv[])
+{
+	static constexpr const char *tiny_snippets[] = {
+		"{", "}", " ", "\n", "x", "if", "12", ":=", ":", "=", "<", "+", "(", ")", ";", "$", "end", "repeat", ":\n"
+	};
+	static constexpr const char *cminus_snippets[] = {
+		"/*", "*/", "*", "/", " ", "\n", "x", "if", "12", "=", "==", "~", "~=", "<=", "(", "}", ";", "$", "int", "return", "~\n"
+	};
+	check_options opt;
+	std::string only_lexer, only_shape;
+	bool usage = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (i + 1 >= argc)
+			usage = true;
+		else if (arg == "-s")
+			opt.size = std::strtoul(argv[++i], nullptr, 10) * 1024;
+		else if (arg == "-e")
+			opt.edits = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-x")
+			opt.seed = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-l")
+			only_lexer = argv[++i];
+		else if (arg == "-p")
+			only_shape = argv[++i];
+		else
+			usage = true;
+	}
+	if (usage || opt.size == 0) {
+		std::cout << "Usage: lexer_check [-s <KB>] [-e <EDITS>] [-x <SEED>] [-l tcc|cmcc] [-p <SHAPE>]" << std::endl;
+		return -1;
+	}
+	bool ok = true;
+	if (only_lexer.empty() || only_lexer == "tcc")
+		ok = check_language<tcc::lexer, tcc::static_lexer, cov::tiny_corpus>("tcc", tiny_snippets, std::size(tiny_snippets), only_shape, opt) && ok;
+	if (only_lexer.empty() || only_lexer == "cmcc")
+		ok = check_language<cmcc::lexer, cmcc::static_lexer, cov::cminus_corpus>("cmcc", cminus_snippets, std::size(cminus_snippets), only_shape, opt) && ok;
+	return ok ? 0 : 1;
+}
\ No newline at end of file
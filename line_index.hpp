@@ -0,0 +1,72 @@
+#pragma once
+
+#include "simd_scan.hpp"
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace cov {
+	/*
+	 * Line starts of a source, found by a vectorized newline scan on the first lookup and extended when the
+	 * source grew, so lexers never count lines themselves. Lookups are binary searches.
+	 * Lines count from 0 and the column of an offset is the number of characters before it on its line.
+	 * A source starting in the middle of a line, like a block of a stream, gives its first line and column.
+	 */
+	class line_index final {
+		std::string_view _src;
+		std::size_t _first_line = 0, _first_column = 0;
+		// Starts of the lines after the first one in the part of the source scanned so far
+		mutable std::vector<std::uint32_t> _starts;
+		mutable std::size_t _scanned = 0;
+		void update() const
+		{
+			if (_scanned < _src.size()) {
+				find_lines(_src.data(), _src.data() + _scanned, _src.data() + _src.size(), _starts);
+				_scanned = _src.size();
+			}
+		}
+	public:
+		void reset(std::string_view src, std::size_t first_line = 0, std::size_t first_column = 0)
+		{
+			_src = src;
+			_first_line = first_line;
+			_first_column = first_column;
+			_starts.clear();
+			_scanned = 0;
+		}
+		// Same text as before with more behind it, possibly moved in memory
+		inline void extend(std::string_view src) noexcept
+		{
+			_src = src;
+		}
+		void locate(std::size_t offset, std::size_t &line, std::size_t &column) const
+		{
+			update();
+			auto it = std::upper_bound(_starts.begin(), _starts.end(), offset);
+			line = _first_line + (it - _starts.begin());
+			column = it == _starts.begin() ? _first_column + offset : offset - *(it - 1);
+		}
+		std::size_t line(std::size_t offset) const
+		{
+			std::size_t l, c;
+			locate(offset, l, c);
+			return l;
+		}
+		std::size_t column(std::size_t offset) const
+		{
+			std::size_t l, c;
+			locate(offset, l, c);
+			return c;
+		}
+		// Offset of the first character of a line, the end of the source for lines past the last one
+		std::size_t line_start(std::size_t line) const
+		{
+			update();
+			if (line <= _first_line)
+				return 0;
+			line -= _first_line;
+			return line <= _starts.size() ? _starts[line - 1] : _src.size();
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string_view>
+#include <string>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cov {
+	/*
+	 * Read-only view of a whole file.
+	 * Regular files are memory-mapped, everything else (and platforms without mmap)
+	 * falls back to reading the file into an owned buffer.
+	 */
+	class mapped_file final {
+		const char *_data = nullptr;
+		std::size_t _size = 0;
+		bool _mapped = false;
+		std::string _buffer;
+	public:
+		mapped_file() = default;
+		explicit mapped_file(const std::string &path)
+		{
+			open(path);
+		}
+		mapped_file(const mapped_file &) = delete;
+		mapped_file(mapped_file &&other) noexcept
+		{
+			*this = std::move(other);
+		}
+		mapped_file &operator=(const mapped_file &) = delete;
+		mapped_file &operator=(mapped_file &&other) noexcept
+		{
+			if (this != &other) {
+				close();
+				_mapped = other._mapped;
+				_buffer = std::move(other._buffer);
+				_size = other._size;
+				_data = _mapped ? other._data : _buffer.data();
+				other._data = nullptr;
+				other._size = 0;
+				other._mapped = false;
+			}
+			return *this;
+		}
+		~mapped_file()
+		{
+			close();
+		}
+		bool open(const std::string &path)
+		{
+			close();
+#ifndef _WIN32
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat st;
+			if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+				_size = static_cast<std::size_t>(st.st_size);
+				if (_size == 0) {
+					::close(fd);
+					_data = _buffer.data();
+					return true;
+				}
+				void *addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (addr != MAP_FAILED) {
+					::madvise(addr, _size, MADV_SEQUENTIAL);
+					::close(fd);
+					_data = static_cast<const char *>(addr);
+					_mapped = true;
+					return true;
+				}
+			}
+			// Pipes, character devices or a failed mapping: read through the descriptor
+			char block[65536];
+			ssize_t n = 0;
+			while ((n = ::read(fd, block, sizeof(block))) > 0)
+				_buffer.append(block, static_cast<std::size_t>(n));
+			::close(fd);
+			if (n < 0) {
+				_buffer.clear();
+				return false;
+			}
+#else
+			std::ifstream ifs(path, std::ios::binary);
+			if (!ifs)
+				return false;
+			std::ostringstream oss;
+			oss << ifs.rdbuf();
+			_buffer = oss.str();
+#endif
+			_data = _buffer.data();
+			_size = _buffer.size();
+			return true;
+		}
+		void close() noexcept
+		{
+#ifndef _WIN32
+			if (_mapped)
+				::munmap(const_cast<char *>(_data), _size);
+#endif
+			_buffer.clear();
+			_data = nullptr;
+			_size = 0;
+			_mapped = false;
+		}
+		inline bool is_open() const noexcept
+		{
+			return _data != nullptr;
+		}
+		inline bool is_mapped() const noexcept
+		{
+			return _mapped;
+		}
+		inline const char *data() const noexcept
+		{
+			return _data;
+		}
+		inline std::size_t size() const noexcept
+		{
+			return _size;
+		}
+		inline std::string_view view() const noexcept
+		{
+			return std::string_view(_data, _size);
+		}
+	};
+}
\ No newline at end of file
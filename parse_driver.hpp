@@ -0,0 +1,158 @@
+#pragma once
+
+#include "spsc_ring.hpp"
+#include <string_view>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <type_traits>
+
+namespace cov {
+	// What tells the parser drivers apart
+	struct parse_language {
+		const char *program;
+		const char *extension;
+	};
+
+	/*
+	 * Message, source line and caret in the layout of the scanners: the caret stands under column pos,
+	 * which counts from 1 like the positions of the lexers. The line is the one containing offset.
+	 */
+	inline void print_caret(std::ostream &out, std::string_view src, std::size_t line, std::size_t pos, std::size_t offset, std::string_view message)
+	{
+		offset = std::min(offset, src.size());
+		std::size_t begin = offset == 0 ? 0 : src.rfind('\n', offset - 1);
+		begin = begin == std::string_view::npos || offset == 0 ? 0 : begin + 1;
+		std::size_t end = std::min(src.find('\n', offset), src.size());
+		std::string echo(src.substr(begin, end - begin));
+		for (char &ch : echo) if (ch == '\t') ch = ' ';
+		out << "In line " << line + 1 << ": " << message << '\n';
+		out << echo << '\n' << std::string(pos > 0 ? pos - 1 : 0, ' ') << "^" << '\n' << '\n';
+	}
+
+	template<typename clock_t = std::chrono::steady_clock, typename func_t>
+	double best_time(std::size_t repeat, func_t &&func)
+	{
+		double best = 0;
+		for (std::size_t i = 0; i < repeat; ++i) {
+			auto start = clock_t::now();
+			func();
+			double t = std::chrono::duration<double>(clock_t::now() - start).count();
+			if (i == 0 || t < best)
+				best = t;
+		}
+		return best;
+	}
+
+	// Lexical errors, then syntax errors, each with its caret
+	template<typename lexer_t, typename parser_t>
+	void print_errors(std::ostream &out, const lexer_t &lex, const parser_t &parser)
+	{
+		std::string_view src = lex.get_source();
+		for (auto &e : lex.get_errors())
+			print_caret(out, src, e.line, e.pos, e.offset, lexer_t::get_error(e.type));
+		for (auto &e : parser.get_errors())
+			print_caret(out, src, e.line, e.pos, e.offset, std::string(parser_t::get_error(e.type)) + " \"" + e.text + "\"");
+	}
+
+	/*
+	 * Lexing and parsing overlapped: the lexer runs on a thread of its own and pushes the tokens of every step of
+	 * step bytes into the ring as one batch, the parser takes them as they arrive. The results are those of lex()
+	 * followed by parse(), the stalls of the ring tell which side waited for the other.
+	 */
+	template<typename lexer_t, typename parser_t, typename token_t>
+	bool pipeline_parse(lexer_t &lex, parser_t &parser, std::string_view src, spsc_ring<token_t> &ring, std::size_t step = 16 * 1024)
+	{
+		ring.reset();
+		std::thread producer([&] {
+			lex.lex_begin(src);
+			std::size_t sent = 0;
+			for (bool more = true; more;) {
+				more = lex.lex_more(step);
+				auto tokens = lex.get_results();
+				ring.push(tokens.data() + sent, tokens.size() - sent);
+				sent = tokens.size();
+			}
+			ring.close();
+		});
+		bool ok = parser.parse(ring, src, lex.get_symbols());
+		producer.join();
+		return ok;
+	}
+
+	/*
+	 * Shared main() of the parsers: lex and parse every file, report lexical and syntax errors with carets,
+	 * optionally print the syntax tree, and time both phases in microseconds per KiB of source.
+	 * The fastest of the repeated runs is reported, the tree and errors come from the last one.
+	 * With -p both phases are also timed overlapped in a pipeline, with the stalls of its last run.
+	 */
+	template<typename lexer_t, typename parser_t>
+	int parse_main(const parse_language &lang, int argc, const char *argv[])
+	{
+		bool tree = false, pipeline = false, usage = false;
+		std::size_t repeat = 1;
+		std::vector<std::string> inputs;
+		for (int i = 1; i < argc; ++i) {
+			std::string_view arg(argv[i]);
+			if (arg == "-t")
+				tree = true;
+			else if (arg == "-p")
+				pipeline = true;
+			else if (arg == "-n" && i + 1 < argc)
+				repeat = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+			else if (arg.size() > 1 && arg[0] == '-')
+				usage = true;
+			else
+				inputs.emplace_back(arg);
+		}
+		// Checking CLI input
+		if (usage || inputs.empty()) {
+			std::cout << "Usage: " << lang.program << " [-t] [-p] [-n <REPEAT>] <INPUT>" << lang.extension << "..." << std::endl;
+			return -1;
+		}
+		int status = 0;
+		lexer_t lex;
+		parser_t parser;
+		spsc_ring<std::decay_t<decltype(lex.get_results()[0])>> ring;
+		for (auto &path : inputs) {
+			if (!lex.lex_file(path)) {
+				std::cout << "Cannot open input file: " << path << std::endl;
+				status = -1;
+				continue;
+			}
+			std::string_view src = lex.get_source();
+			double lex_time = best_time(repeat, [&] {
+				lex.lex(src);
+			});
+			bool ok = true;
+			double parse_time = best_time(repeat, [&] {
+				ok = parser.parse(lex);
+			});
+			double pipeline_time = 0;
+			if (pipeline) {
+				pipeline_time = best_time(repeat, [&] {
+					ok = pipeline_parse(lex, parser, src, ring);
+				});
+			}
+			std::cout << std::endl << path << ":" << std::endl << std::endl;
+			print_errors(std::cout, lex, parser);
+			if (tree && ok)
+				parser.print_tree(std::cout);
+			double kib = std::max<double>(src.size(), 1) / 1024;
+			std::cout << lex.get_results().size() << " tokens, " << parser.get_node_count() << " nodes, " << parser.get_memory() / 1024 << " KiB of syntax tree" << std::endl;
+			std::cout << "Lex Time: " << lex_time * 1e6 / kib << " us/KiB, Parse Time: " << parse_time * 1e6 / kib << " us/KiB" << std::endl;
+			if (pipeline) {
+				auto &stalls = ring.get_stalls();
+				std::cout << "Pipeline Time: " << pipeline_time * 1e6 / kib << " us/KiB, lexer stalled " << stalls.push_stalls << " times for " << stalls.push_seconds * 1e3
+				          << " ms, parser stalled " << stalls.pop_stalls << " times for " << stalls.pop_seconds * 1e3 << " ms" << std::endl;
+			}
+			if (!ok || !lex.get_errors().empty())
+				status = -1;
+		}
+		return status;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,1306 @@
+#include "parsergen.hpp"
+#include "line_index.hpp"
+#include "tree_cache.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <cstdio>
+#include <map>
+#include <set>
+
+namespace parsergen {
+	using char_set = std::bitset<256>;
+
+	// Syntax tree of one regular expression
+	struct regex_node {
+		enum kind_type {
+			empty, chars, cat, alt, repeat, look
+		} kind = empty;
+		int lhs = -1, rhs = -1;
+		// Character set of chars and look
+		int set = -1;
+		unsigned min = 0, max = 0;
+		bool negative = false;
+	};
+
+	constexpr unsigned repeat_inf = UINT_MAX;
+
+	class regex_parser final {
+		std::string_view re;
+		std::size_t i = 0;
+	public:
+		std::vector<regex_node> nodes;
+		std::vector<char_set> &sets;
+		std::string error;
+	private:
+		int make(regex_node n)
+		{
+			nodes.push_back(n);
+			return nodes.size() - 1;
+		}
+		int make_set(const char_set &s)
+		{
+			sets.push_back(s);
+			regex_node n;
+			n.kind = regex_node::chars;
+			n.set = sets.size() - 1;
+			return make(n);
+		}
+		int make_pair(regex_node::kind_type kind, int lhs, int rhs)
+		{
+			regex_node n;
+			n.kind = kind;
+			n.lhs = lhs;
+			n.rhs = rhs;
+			return make(n);
+		}
+		int fail(const char *what)
+		{
+			if (error.empty())
+				error = std::string(what) + " at column " + std::to_string(i + 1);
+			return -1;
+		}
+		bool more() const
+		{
+			return i < re.size();
+		}
+		static char_set word_set()
+		{
+			char_set s;
+			for (int c = 0; c < 256; ++c)
+				if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')
+					s.set(c);
+			return s;
+		}
+		static char_set space_set()
+		{
+			char_set s;
+			for (char c : std::string_view(" \t\n\v\f\r"))
+				s.set(static_cast<unsigned char>(c));
+			return s;
+		}
+		static char_set digit_set()
+		{
+			char_set s;
+			for (int c = '0'; c <= '9'; ++c)
+				s.set(c);
+			return s;
+		}
+		// Escape after the backslash, either a class or a single character in c
+		bool escape(char_set &s, int &c)
+		{
+			if (!more()) {
+				fail("Trailing backslash");
+				return false;
+			}
+			char e = re[i++];
+			c = -1;
+			switch (e) {
+			case 'd':
+				s = digit_set();
+				break;
+			case 'D':
+				s = ~digit_set();
+				break;
+			case 'w':
+				s = word_set();
+				break;
+			case 'W':
+				s = ~word_set();
+				break;
+			case 's':
+				s = space_set();
+				break;
+			case 'S':
+				s = ~space_set();
+				break;
+			case 'n':
+				c = '\n';
+				break;
+			case 't':
+				c = '\t';
+				break;
+			case 'r':
+				c = '\r';
+				break;
+			case 'f':
+				c = '\f';
+				break;
+			case 'v':
+				c = '\v';
+				break;
+			case '0':
+				c = 0;
+				break;
+			default:
+				c = static_cast<unsigned char>(e);
+			}
+			return true;
+		}
+		int char_class()
+		{
+			char_set s;
+			bool negate = more() && re[i] == '^';
+			if (negate)
+				++i;
+			for (bool first = true; more() && (first || re[i] != ']'); first = false) {
+				int lo = static_cast<unsigned char>(re[i++]);
+				if (lo == '\\') {
+					char_set esc;
+					if (!escape(esc, lo))
+						return -1;
+					if (lo < 0) {
+						s |= esc;
+						continue;
+					}
+				}
+				int hi = lo;
+				if (i + 1 < re.size() && re[i] == '-' && re[i + 1] != ']') {
+					++i;
+					hi = static_cast<unsigned char>(re[i++]);
+					if (hi == '\\') {
+						char_set esc;
+						if (!escape(esc, hi))
+							return -1;
+						if (hi < 0)
+							return fail("Class in a range");
+					}
+					if (hi < lo)
+						return fail("Reversed range");
+				}
+				for (int c = lo; c <= hi; ++c)
+					s.set(c);
+			}
+			if (!more())
+				return fail("Unterminated character class");
+			++i;
+			return make_set(negate ? ~s : s);
+		}
+		// Lookahead is only supported for one character, which is all the scanner can see
+		int lookahead(bool negative)
+		{
+			int body = alternation();
+			if (body < 0)
+				return -1;
+			char_set s;
+			if (!single(body, s))
+				return fail("Lookahead longer than one character");
+			sets.push_back(s);
+			regex_node n;
+			n.kind = regex_node::look;
+			n.set = sets.size() - 1;
+			n.negative = negative;
+			return make(n);
+		}
+		bool single(int n, char_set &s) const
+		{
+			switch (nodes[n].kind) {
+			case regex_node::chars:
+				s |= sets[nodes[n].set];
+				return true;
+			case regex_node::alt:
+				return single(nodes[n].lhs, s) && single(nodes[n].rhs, s);
+			default:
+				return false;
+			}
+		}
+		int atom()
+		{
+			char c = re[i++];
+			switch (c) {
+			case '(': {
+				int n;
+				if (re.substr(i, 2) == "?:") {
+					i += 2;
+					n = alternation();
+				}
+				else if (re.substr(i, 2) == "?!" || re.substr(i, 2) == "?=") {
+					i += 2;
+					n = lookahead(re[i - 1] == '!');
+				}
+				else
+					n = alternation();
+				if (n < 0)
+					return -1;
+				if (!more() || re[i] != ')')
+					return fail("Missing )");
+				++i;
+				return n;
+			}
+			case '[':
+				return char_class();
+			case '.': {
+				char_set s;
+				s.set();
+				s.reset('\n');
+				s.reset('\r');
+				return make_set(s);
+			}
+			case '\\': {
+				char_set s;
+				int e;
+				if (!escape(s, e))
+					return -1;
+				if (e >= 0)
+					s.set(e);
+				return make_set(s);
+			}
+			case '*':
+			case '+':
+			case '?':
+			case '{':
+				--i;
+				return fail("Nothing to repeat");
+			default: {
+				char_set s;
+				s.set(static_cast<unsigned char>(c));
+				return make_set(s);
+			}
+			}
+		}
+		bool number(unsigned &n)
+		{
+			std::size_t begin = i;
+			for (n = 0; more() && re[i] >= '0' && re[i] <= '9'; ++i)
+				n = n * 10 + (re[i] - '0');
+			return i != begin;
+		}
+		int quantified()
+		{
+			int n = atom();
+			while (n >= 0 && more()) {
+				regex_node r;
+				r.kind = regex_node::repeat;
+				r.lhs = n;
+				switch (re[i]) {
+				case '*':
+					r.max = repeat_inf;
+					break;
+				case '+':
+					r.min = 1;
+					r.max = repeat_inf;
+					break;
+				case '?':
+					r.max = 1;
+					break;
+				case '{': {
+					++i;
+					if (!number(r.min))
+						return fail("Bad repetition");
+					r.max = r.min;
+					if (more() && re[i] == ',') {
+						++i;
+						if (!number(r.max))
+							r.max = repeat_inf;
+					}
+					if (!more() || re[i] != '}' || r.max < r.min)
+						return fail("Bad repetition");
+					break;
+				}
+				default:
+					return n;
+				}
+				++i;
+				// Laziness does not change which strings match
+				if (more() && re[i] == '?')
+					++i;
+				n = make(r);
+			}
+			return n;
+		}
+		int concatenation()
+		{
+			int n = -1;
+			while (more() && re[i] != '|' && re[i] != ')') {
+				int rhs = quantified();
+				if (rhs < 0)
+					return -1;
+				n = n < 0 ? rhs : make_pair(regex_node::cat, n, rhs);
+			}
+			return n < 0 ? make(regex_node()) : n;
+		}
+		int alternation()
+		{
+			int n = concatenation();
+			while (n >= 0 && more() && re[i] == '|') {
+				++i;
+				int rhs = concatenation();
+				if (rhs < 0)
+					return -1;
+				n = make_pair(regex_node::alt, n, rhs);
+			}
+			return n;
+		}
+	public:
+		explicit regex_parser(std::vector<char_set> &s) : sets(s) {}
+		// Anchors are implied by whole token matching, a missing one is matched by any text
+		int parse(std::string_view str)
+		{
+			bool head = !str.empty() && str.front() == '^';
+			if (head)
+				str.remove_prefix(1);
+			bool tail = !str.empty() && str.back() == '$' && (str.size() < 2 || str[str.size() - 2] != '\\');
+			if (tail)
+				str.remove_suffix(1);
+			re = str;
+			i = 0;
+			int n = alternation();
+			if (n >= 0 && more())
+				return fail("Unbalanced )");
+			if (n < 0)
+				return -1;
+			char_set all;
+			all.set();
+			regex_node any;
+			any.kind = regex_node::repeat;
+			any.max = repeat_inf;
+			if (!head) {
+				any.lhs = make_set(all);
+				n = make_pair(regex_node::cat, make(any), n);
+			}
+			if (!tail) {
+				any.lhs = make_set(all);
+				n = make_pair(regex_node::cat, n, make(any));
+			}
+			return n;
+		}
+	};
+
+	// Thompson automaton of all rules, built from the end of each expression backwards
+	struct nfa_state {
+		enum kind_type {
+			chars, split, look, accept
+		} kind = split;
+		int out = -1, out1 = -1, set = -1;
+		bool negative = false;
+		std::uint32_t rule = 0;
+	};
+
+	class nfa_builder final {
+		const std::vector<regex_node> &tree;
+	public:
+		std::vector<nfa_state> &states;
+		std::uint32_t rule = 0;
+	private:
+		int make(nfa_state::kind_type kind, int out, int out1 = -1, int set = -1)
+		{
+			nfa_state s;
+			s.kind = kind;
+			s.out = out;
+			s.out1 = out1;
+			s.set = set;
+			s.rule = rule;
+			states.push_back(s);
+			return states.size() - 1;
+		}
+		int loop(int body, int out)
+		{
+			int s = make(nfa_state::split, -1, out);
+			int start = compile(body, s);
+			states[s].out = start;
+			return s;
+		}
+	public:
+		nfa_builder(const std::vector<regex_node> &t, std::vector<nfa_state> &s) : tree(t), states(s) {}
+		int accept()
+		{
+			return make(nfa_state::accept, -1);
+		}
+		int compile(int n, int out)
+		{
+			const regex_node &node = tree[n];
+			switch (node.kind) {
+			default:
+				return out;
+			case regex_node::chars:
+				return make(nfa_state::chars, out, -1, node.set);
+			case regex_node::look: {
+				int s = make(nfa_state::look, out, -1, node.set);
+				states[s].negative = node.negative;
+				return s;
+			}
+			case regex_node::cat:
+				return compile(node.lhs, compile(node.rhs, out));
+			case regex_node::alt: {
+				int lhs = compile(node.lhs, out);
+				return make(nfa_state::split, lhs, compile(node.rhs, out));
+			}
+			case regex_node::repeat: {
+				int next = out;
+				if (node.max == repeat_inf)
+					next = loop(node.lhs, out);
+				else {
+					for (unsigned k = node.min; k < node.max; ++k) {
+						int body = compile(node.lhs, next);
+						next = make(nfa_state::split, body, out);
+					}
+				}
+				for (unsigned k = 0; k < node.min; ++k)
+					next = compile(node.lhs, next);
+				return next;
+			}
+			}
+		}
+	};
+
+	constexpr int end_of_input = 256;
+
+	// Subset construction over the rules which are still alive
+	class dfa_builder final {
+		const std::vector<nfa_state> &nfa;
+		const std::vector<char_set> &sets;
+		std::vector<std::uint32_t> mark;
+		std::uint32_t stamp = 0;
+		std::vector<int> stack;
+	public:
+		dfa_builder(const std::vector<nfa_state> &n, const std::vector<char_set> &s) : nfa(n), sets(s), mark(n.size(), 0) {}
+		// States consuming a character or accepting, reachable without input before the symbol c
+		void closure(const std::vector<int> &kernel, int c, std::vector<int> &result)
+		{
+			result.clear();
+			++stamp;
+			stack.assign(kernel.begin(), kernel.end());
+			while (!stack.empty()) {
+				int s = stack.back();
+				stack.pop_back();
+				if (s < 0 || mark[s] == stamp)
+					continue;
+				mark[s] = stamp;
+				const nfa_state &st = nfa[s];
+				switch (st.kind) {
+				case nfa_state::chars:
+				case nfa_state::accept:
+					result.push_back(s);
+					break;
+				case nfa_state::split:
+					stack.push_back(st.out1);
+					stack.push_back(st.out);
+					break;
+				case nfa_state::look: {
+					bool in = c != end_of_input && sets[st.set].test(c);
+					if (in != st.negative)
+						stack.push_back(st.out);
+					break;
+				}
+				}
+			}
+		}
+		// Kernel after c, keeping the rules which match the longer prefix as a whole
+		void step(const std::vector<int> &kernel, int c, std::vector<int> &next, std::vector<std::uint32_t> &alive)
+		{
+			std::vector<int> cl;
+			closure(kernel, c, cl);
+			next.clear();
+			for (int s : cl)
+				if (nfa[s].kind == nfa_state::chars && sets[nfa[s].set].test(c))
+					next.push_back(nfa[s].out);
+			closure(next, end_of_input, cl);
+			alive.clear();
+			for (int s : cl)
+				if (nfa[s].kind == nfa_state::accept)
+					alive.push_back(nfa[s].rule);
+			std::sort(alive.begin(), alive.end());
+			alive.erase(std::unique(alive.begin(), alive.end()), alive.end());
+			next.erase(std::remove_if(next.begin(), next.end(), [&](int s) {
+				return !std::binary_search(alive.begin(), alive.end(), nfa[s].rule);
+			}), next.end());
+			std::sort(next.begin(), next.end());
+			next.erase(std::unique(next.begin(), next.end()), next.end());
+		}
+	};
+
+	bool lexical_dfa::build(const lexical_rules &rules)
+	{
+		_names.clear();
+		_action.clear();
+		_next.clear();
+		_error.clear();
+		std::vector<char_set> sets;
+		std::vector<nfa_state> nfa;
+		std::vector<int> starts;
+		std::int32_t ign = -1, err = -1;
+		for (std::uint32_t r = 0; r < rules.size(); ++r) {
+			regex_parser parser(sets);
+			int tree = parser.parse(rules[r].regex);
+			if (tree < 0) {
+				_error = "Lexical rule \"" + rules[r].name + "\": " + parser.error;
+				_names.clear();
+				return false;
+			}
+			nfa_builder builder(parser.nodes, nfa);
+			builder.rule = r;
+			starts.push_back(builder.compile(tree, builder.accept()));
+			_names.push_back(rules[r].name);
+			if (rules[r].name == "ign")
+				ign = r;
+			else if (rules[r].name == "err")
+				err = r;
+		}
+		// Bytes which no expression tells apart share a column of the table
+		std::vector<int> byte_class(256, 0);
+		std::size_t classes = 1;
+		for (auto &s : sets) {
+			std::map<std::pair<int, bool>, int> split;
+			for (int c = 0; c < 256; ++c)
+				byte_class[c] = split.emplace(std::make_pair(byte_class[c], s.test(c)), split.size()).first->second;
+			classes = split.size();
+		}
+		std::vector<int> sample(classes);
+		for (int c = 255; c >= 0; --c) {
+			_class[c] = byte_class[c];
+			sample[byte_class[c]] = c;
+		}
+		auto decide = [&](const std::vector<std::uint32_t> &alive) -> std::int32_t {
+			std::size_t count = alive.size();
+			auto has = [&](std::int32_t r) {
+				return r >= 0 && std::binary_search(alive.begin(), alive.end(), static_cast<std::uint32_t>(r));
+			};
+			if (count > 1 && has(err))
+				return act_unexpected;
+			if (count > 1 && has(ign))
+				--count;
+			if (count > 1)
+				return act_ambiguous;
+			for (std::int32_t rule : alive)
+				if (rule != ign)
+					return rule;
+			return act_ignore;
+		};
+		// Raw automaton, the start state is never reached again so it is not looked up
+		dfa_builder builder(nfa, sets);
+		std::vector<std::vector<int>> kernels{{}, starts};
+		std::vector<std::int32_t> action{act_none, act_none};
+		std::vector<std::uint32_t> next;
+		std::map<std::vector<int>, std::uint32_t> index;
+		std::vector<int> kernel;
+		std::vector<std::uint32_t> alive;
+		for (std::size_t s = 1; s < kernels.size(); ++s) {
+			for (std::size_t k = 0; k < classes; ++k) {
+				builder.step(kernels[s], sample[k], kernel, alive);
+				if (alive.empty()) {
+					next.push_back(dead_state);
+					continue;
+				}
+				auto it = index.emplace(kernel, kernels.size());
+				if (it.second) {
+					kernels.push_back(kernel);
+					action.push_back(decide(alive));
+				}
+				next.push_back(it.first->second);
+			}
+		}
+		// Moore's partition refinement, the dead and start states keep blocks of their own
+		std::size_t count = kernels.size();
+		std::vector<std::uint32_t> block(count);
+		{
+			std::map<std::int32_t, std::uint32_t> initial;
+			for (std::size_t s = 0; s < count; ++s)
+				block[s] = s < 2 ? s : initial.emplace(action[s], initial.size() + 2).first->second;
+		}
+		for (std::size_t blocks = 0;;) {
+			std::map<std::vector<std::uint32_t>, std::uint32_t> signature;
+			std::vector<std::uint32_t> refined(count), key(classes + 1);
+			for (std::size_t s = 0; s < count; ++s) {
+				key[0] = block[s];
+				for (std::size_t k = 0; k < classes; ++k)
+					key[k + 1] = s == 0 ? 0 : block[next[(s - 1) * classes + k]];
+				refined[s] = signature.emplace(key, signature.size()).first->second;
+			}
+			block.swap(refined);
+			if (signature.size() == blocks)
+				break;
+			blocks = signature.size();
+		}
+		// Blocks are numbered in order of their first state, so dead and start stay 0 and 1
+		std::size_t states = *std::max_element(block.begin(), block.end()) + 1;
+		_class_count = classes;
+		_action.assign(states, act_none);
+		_next.assign(states * classes, dead_state);
+		for (std::size_t s = 1; s < count; ++s) {
+			_action[block[s]] = action[s];
+			for (std::size_t k = 0; k < classes; ++k)
+				_next[block[s] * classes + k] = block[next[(s - 1) * classes + k]];
+		}
+		return true;
+	}
+
+	// Positions as cursor_forward() of parsergen.csp counts them, offsets have to be visited in order
+	class position_tracker final {
+		std::string_view src;
+		std::size_t at = 0, line = 0, newline = std::string_view::npos;
+	public:
+		explicit position_tracker(std::string_view s) : src(s) {}
+		void locate(std::size_t offset, std::uint32_t &l, std::int32_t &column)
+		{
+			for (; at < offset; ++at) {
+				if (src[at + 1] == '\n') {
+					++line;
+					newline = at + 1;
+				}
+			}
+			l = line;
+			column = static_cast<std::int32_t>(newline == std::string_view::npos ? offset : offset - newline) - 1;
+		}
+	};
+
+	void lexer::run(const lexical_dfa &dfa, std::string_view src)
+	{
+		clear();
+		position_tracker tracker(src);
+		auto error = [&](std::string text, std::size_t offset) {
+			lex_error e;
+			e.text = std::move(text);
+			e.offset = offset;
+			tracker.locate(src.empty() ? 0 : std::min(offset, src.size() - 1), e.line, e.column);
+			errors.push_back(std::move(e));
+		};
+		const char *begin = src.data(), *end = begin + src.size();
+		for (const char *p = begin; p != end;) {
+			std::uint32_t state;
+			const char *last = dfa.longest(p, end, state);
+			if (last == p) {
+				error("Unknown character \'" + std::string(1, *p) + "\'", p - begin);
+				++p;
+				continue;
+			}
+			std::string_view text(p, last - p);
+			switch (std::int32_t act = dfa.action(state)) {
+			case lexical_dfa::act_ignore:
+				break;
+			case lexical_dfa::act_unexpected:
+				error("Unexpected input \"" + std::string(text) + "\"", last - begin);
+				break;
+			case lexical_dfa::act_ambiguous:
+				error("Ambiguous lexical \"" + std::string(text) + "\"", last - begin);
+				break;
+			default: {
+				token t;
+				t.type = act;
+				t.offset = p - begin;
+				t.length = text.size();
+				tracker.locate(t.offset, t.line, t.column);
+				tokens.push_back(t);
+			}
+			}
+			p = last;
+		}
+	}
+
+	/*
+	 * FIRST sets of the syntax rules, iterated over all rules until nothing changes.
+	 * An alternative which cannot match empty input and cannot run a negative lookahead before
+	 * its first token fails right away on a token outside its FIRST set, having logged only
+	 * "Unexpected Token" at the cursor and "No matching syntax" if a cond on its way failed too.
+	 * Tokens are keyed by lexical rule, terms after them by term id.
+	 */
+	class first_sets final {
+		struct info {
+			std::vector<std::uint64_t> first;
+			bool nullable = false, opaque = false, logs_n = false;
+		};
+		syntax_graph &g;
+		std::size_t words = 0;
+		std::vector<info> rules;
+		void insert(info &n, std::size_t key)
+		{
+			n.first[key / 64] |= std::uint64_t(1) << key % 64;
+		}
+		void merge(info &n, const info &other)
+		{
+			for (std::size_t i = 0; i < words; ++i)
+				n.first[i] |= other.first[i];
+			n.opaque |= other.opaque;
+		}
+		info empty() const
+		{
+			info n;
+			n.first.assign(words, 0);
+			return n;
+		}
+		info item(const syntax_graph::node &it)
+		{
+			info n = empty();
+			switch (it.type) {
+			case syntax_type::token:
+				if (it.value != syntax_graph::npos)
+					insert(n, it.value);
+				break;
+			case syntax_type::term:
+				insert(n, g._type_count + it.value);
+				break;
+			case syntax_type::ref:
+				n = rules[it.value];
+				break;
+			case syntax_type::nlook:
+				n.nullable = n.opaque = true;
+				break;
+			case syntax_type::repeat:
+			case syntax_type::opt:
+				n = sequence(it.first, it.count);
+				n.nullable = true;
+				break;
+			case syntax_type::cond:
+				// An empty cond fails without looking at the token
+				n.opaque = it.count == 0;
+				for (std::uint32_t i = it.first; i < it.first + it.count; ++i) {
+					info alt = sequence(g._alts[i].first, g._alts[i].count);
+					merge(n, alt);
+					// Alternatives are tried until one of them matches empty input
+					if (!n.nullable)
+						n.logs_n |= alt.logs_n;
+					n.nullable |= alt.nullable;
+				}
+				n.logs_n |= !n.nullable;
+				break;
+			}
+			return n;
+		}
+		info sequence(std::uint32_t first, std::uint32_t count)
+		{
+			info n = empty();
+			n.nullable = true;
+			for (std::uint32_t i = first; i < first + count && n.nullable; ++i) {
+				info next = item(g._nodes[i]);
+				merge(n, next);
+				n.logs_n |= next.logs_n;
+				n.nullable = next.nullable;
+			}
+			return n;
+		}
+		// Rules until their sets are stable, logs_n only once nullable is final
+		void solve(bool logs_n)
+		{
+			for (bool changed = true; changed;) {
+				changed = false;
+				for (std::size_t r = 0; r < rules.size(); ++r) {
+					info n = sequence(g._rules[r].first, g._rules[r].count);
+					if (!logs_n)
+						n.logs_n = false;
+					if (n.first != rules[r].first || n.nullable != rules[r].nullable || n.opaque != rules[r].opaque || n.logs_n != rules[r].logs_n) {
+						rules[r] = std::move(n);
+						changed = true;
+					}
+				}
+			}
+		}
+	public:
+		explicit first_sets(syntax_graph &graph) : g(graph)
+		{
+			std::size_t keys = g._type_count + g._term_ids.size();
+			words = (keys + 63) / 64;
+			rules.assign(g._rules.size(), empty());
+		}
+		/*
+		 * The table of a cond is [always, logs_n, a mask for every key], one bit per alternative.
+		 * Alternatives which match empty input or may look ahead are always tried, a cond with more
+		 * alternatives than bits in a mask keeps trying all of them.
+		 */
+		void build()
+		{
+			solve(false);
+			solve(true);
+			std::size_t keys = g._type_count + g._term_ids.size();
+			for (auto &it : g._nodes) {
+				if (it.type != syntax_type::cond || it.count > 64)
+					continue;
+				it.value = g._dispatch.size();
+				g._dispatch.resize(g._dispatch.size() + 2 + keys, 0);
+				std::uint64_t *table = g._dispatch.data() + it.value;
+				for (std::uint32_t i = 0; i < it.count; ++i) {
+					const syntax_graph::range &r = g._alts[it.first + i];
+					info alt = sequence(r.first, r.count);
+					std::uint64_t bit = std::uint64_t(1) << i;
+					if (alt.nullable || alt.opaque)
+						table[0] |= bit;
+					if (alt.logs_n)
+						table[1] |= bit;
+					for (std::size_t k = 0; k < keys; ++k)
+						if (alt.first[k / 64] >> k % 64 & 1)
+							table[2 + k] |= bit;
+				}
+			}
+			if (g._ignore == syntax_graph::npos)
+				return;
+			const info &ign = rules[g._ignore];
+			g._ignore_first.resize(keys);
+			for (std::size_t k = 0; k < keys; ++k)
+				g._ignore_first[k] = ign.first[k / 64] >> k % 64 & 1;
+			g._ignore_opaque = ign.opaque;
+			g._ignore_logs_n = ign.logs_n;
+		}
+	};
+
+	syntax_graph::range syntax_graph::compile(const syntax_sequence &seq, const lexical_dfa &dfa, const std::map<std::string, std::uint32_t> &rule_ids)
+	{
+		// Items of a sequence are contiguous, nested sequences go after them
+		range r{static_cast<std::uint32_t>(_nodes.size()), static_cast<std::uint32_t>(seq.size())};
+		_nodes.resize(_nodes.size() + seq.size());
+		for (std::size_t i = 0; i < seq.size(); ++i) {
+			const syntax_item &it = seq[i];
+			node n;
+			n.type = it.type;
+			switch (it.type) {
+			case syntax_type::token:
+				for (std::uint32_t t = 0; t < dfa.rule_count(); ++t)
+					if (dfa.rule_name(t) == it.data)
+						n.value = t;
+				break;
+			case syntax_type::term:
+				n.value = _term_ids.emplace(it.data, _term_ids.size()).first->second;
+				break;
+			case syntax_type::ref: {
+				auto rule = rule_ids.find(it.data);
+				if (rule == rule_ids.end()) {
+					if (_error.empty())
+						_error = "Undefined syntax rule \"" + it.data + "\"";
+				}
+				else
+					n.value = rule->second;
+				break;
+			}
+			case syntax_type::cond: {
+				std::vector<range> alts;
+				for (auto &seq : it.alternatives)
+					alts.push_back(compile(seq, dfa, rule_ids));
+				n.first = _alts.size();
+				n.count = alts.size();
+				_alts.insert(_alts.end(), alts.begin(), alts.end());
+				break;
+			}
+			default: {
+				range items = compile(it.items, dfa, rule_ids);
+				n.first = items.first;
+				n.count = items.count;
+			}
+			}
+			_nodes[r.first + i] = n;
+		}
+		return r;
+	}
+
+	bool syntax_graph::build(const syntax_rules &rules, const lexical_dfa &dfa)
+	{
+		*this = syntax_graph();
+		_type_count = dfa.rule_count();
+		std::map<std::string, std::uint32_t> rule_ids;
+		for (auto &it : rules) {
+			rule_ids.emplace(it.first, _names.size());
+			_names.push_back(it.first);
+		}
+		_rules.resize(_names.size());
+		std::uint32_t id = 0;
+		for (auto &it : rules)
+			_rules[id++] = compile(it.second, dfa, rule_ids);
+		auto begin = rule_ids.find("begin");
+		if (begin == rule_ids.end() && _error.empty())
+			_error = "Syntax rule \"begin\" not found";
+		if (!_error.empty())
+			return false;
+		auto ignore = rule_ids.find("ignore");
+		if (ignore != rule_ids.end())
+			_ignore = ignore->second;
+		first_sets(*this).build();
+		_begin = begin->second;
+		return true;
+	}
+
+	std::uint32_t syntax_graph::term_id(std::string_view text) const noexcept
+	{
+		auto it = _term_ids.find(text);
+		return it == _term_ids.end() ? npos : it->second;
+	}
+
+	void parser::error(error_kind kind)
+	{
+		// Nothing after the nesting limit is a real error, the parse only unwinds
+		if (too_deep)
+			return;
+		if (cursor > max_cursor)
+			max_cursor = cursor;
+		error_log.push_back({cursor, kind});
+	}
+
+	void parser::ignore()
+	{
+		if (on_ign || syn->_ignore == syntax_graph::npos)
+			return;
+		on_ign = true;
+		std::uint32_t start = cursor;
+		std::size_t mark = product.size();
+		const syntax_graph::range &r = syn->_rules[syn->_ignore];
+		// Skipped tokens are dropped, the cursor only moves if the whole rule matched
+		if (match_syntax(r.first, r.count) != state::accept)
+			cursor = start;
+		product.resize(mark);
+		on_ign = false;
+	}
+
+	parser::state parser::match_syntax(std::uint32_t first, std::uint32_t count)
+	{
+		for (std::uint32_t i = first; i < first + count; ++i) {
+			state result = match(syn->_nodes[i]);
+			if (result != state::accept)
+				return result;
+		}
+		return state::accept;
+	}
+
+	parser::state parser::match_ref(std::uint32_t rule)
+	{
+		// Past the limit every rule reports the end of input, which unwinds the whole parse without trying alternatives
+		if (too_deep || depth >= depth_limit) {
+			if (!too_deep) {
+				error(error_kind::too_deep);
+				too_deep = true;
+			}
+			return state::eof;
+		}
+		std::uint32_t entry = syntax_graph::npos;
+		// Rules matched for the ignore rule may not ignore, they are not shared with the others
+		if (!on_ign) {
+			for (std::uint32_t i = memo_head[cursor]; i != syntax_graph::npos; i = memo[i].next) {
+				const memo_entry &e = memo[i];
+				if (e.rule != rule)
+					continue;
+				++memo_hits;
+				if (e.result != state::reject) {
+					if (e.node != syntax_graph::npos)
+						product.push_back(e.node);
+					cursor = e.end;
+				}
+				return e.result;
+			}
+			// Left recursion: parser_type would never return, the inner match fails instead
+			entry = memo.size();
+			memo.push_back({memo_head[cursor], cursor, syntax_graph::npos, rule, state::reject});
+			memo_head[cursor] = entry;
+		}
+		std::uint32_t start = cursor;
+		std::size_t mark = product.size();
+		const syntax_graph::range &r = syn->_rules[rule];
+		++depth;
+		state result = match_syntax(r.first, r.count);
+		--depth;
+		std::uint32_t node = syntax_graph::npos;
+		if (result == state::reject) {
+			product.resize(mark);
+			cursor = start;
+		}
+		else {
+			result = result == state::eof ? state::eof : state::accept;
+			if (product.size() > mark) {
+				node = trees.size() | tree_bit;
+				trees.push_back({rule, static_cast<std::uint32_t>(children.size()), static_cast<std::uint32_t>(product.size() - mark)});
+				children.insert(children.end(), product.begin() + mark, product.end());
+				product.resize(mark);
+				product.push_back(node);
+			}
+		}
+		if (entry != syntax_graph::npos) {
+			memo[entry].end = cursor;
+			memo[entry].node = node;
+			memo[entry].result = result;
+		}
+		return result;
+	}
+
+	parser::state parser::match(const syntax_graph::node &it)
+	{
+		const std::vector<token> &tokens = *lex;
+		switch (it.type) {
+		case syntax_type::token:
+		case syntax_type::term: {
+			auto matches = [&] {
+				return it.type == syntax_type::token ? tokens[cursor].type == it.value : terms[cursor] == it.value;
+			};
+			if (cursor >= tokens.size())
+				return state::eof;
+			if (!matches())
+				ignore();
+			if (cursor >= tokens.size())
+				return state::eof;
+			if (matches()) {
+				product.push_back(cursor++);
+				return state::accept;
+			}
+			error(error_kind::unexpected_token);
+			return state::reject;
+		}
+		case syntax_type::ref:
+			return match_ref(it.value);
+		case syntax_type::nlook: {
+			std::uint32_t start = cursor;
+			std::size_t mark = product.size();
+			state result = match_syntax(it.first, it.count);
+			cursor = start;
+			product.resize(mark);
+			switch (result) {
+			case state::accept:
+			case state::stop:
+				return state::stop;
+			case state::reject:
+				return state::accept;
+			default:
+				return state::eof;
+			}
+		}
+		case syntax_type::repeat:
+			for (;;) {
+				std::uint32_t start = cursor;
+				std::size_t mark = product.size();
+				switch (match_syntax(it.first, it.count)) {
+				case state::accept:
+					// parser_type loops forever on a repetition which consumes nothing
+					if (cursor == start)
+						return state::accept;
+					break;
+				case state::stop:
+					return state::accept;
+				case state::reject:
+					cursor = start;
+					product.resize(mark);
+					return state::accept;
+				default:
+					return state::eof;
+				}
+			}
+		case syntax_type::opt: {
+			std::uint32_t start = cursor;
+			std::size_t mark = product.size();
+			state result = match_syntax(it.first, it.count);
+			if (result == state::reject) {
+				cursor = start;
+				product.resize(mark);
+			}
+			return result == state::eof ? state::eof : state::accept;
+		}
+		case syntax_type::cond: {
+			// Alternatives to try, the others would fail on this token before consuming it
+			std::uint64_t tried = ~std::uint64_t(0);
+			const std::uint64_t *table = nullptr;
+			if (it.value != syntax_graph::npos && cursor < tokens.size()) {
+				table = syn->_dispatch.data() + it.value;
+				std::size_t type = tokens[cursor].type, term = terms[cursor];
+				tried = table[0] | table[2 + type];
+				if (term != syntax_graph::npos)
+					tried |= table[2 + syn->_type_count + term];
+				// Unless the ignore rule could skip the token first
+				if (!on_ign && syn->_ignore != syntax_graph::npos) {
+					if (syn->_ignore_opaque || syn->_ignore_first[type] || (term != syntax_graph::npos && syn->_ignore_first[syn->_type_count + term]))
+						tried = ~std::uint64_t(0);
+				}
+			}
+			for (std::uint32_t i = it.first; i < it.first + it.count; ++i) {
+				std::uint64_t bit = std::uint64_t(1) << (i - it.first);
+				if (!(tried & bit)) {
+					// Same errors as trying it, the ignore rule fails on this token as well
+					error(error_kind::unexpected_token);
+					if ((table[1] & bit) || (!on_ign && syn->_ignore != syntax_graph::npos && syn->_ignore_logs_n))
+						error(error_kind::no_matching);
+					continue;
+				}
+				std::uint32_t start = cursor;
+				std::size_t mark = product.size();
+				const syntax_graph::range &alt = syn->_alts[i];
+				switch (match_syntax(alt.first, alt.count)) {
+				case state::accept:
+				case state::stop:
+					return state::accept;
+				case state::reject:
+					cursor = start;
+					product.resize(mark);
+					break;
+				default:
+					return state::eof;
+				}
+			}
+			error(error_kind::no_matching);
+			return state::reject;
+		}
+		}
+		return state::reject;
+	}
+
+	bool parser::run(const syntax_graph &graph, const std::vector<token> &tokens, std::string_view src)
+	{
+		syn = &graph;
+		lex = &tokens;
+		source = src;
+		terms.resize(tokens.size());
+		for (std::size_t i = 0; i < tokens.size(); ++i)
+			terms[i] = graph.term_id(src.substr(tokens[i].offset, tokens[i].length));
+		trees.clear();
+		children.clear();
+		product.clear();
+		error_log.clear();
+		// The end of input is a cursor too, tokens are matched there before they report eof
+		memo_head.assign(tokens.size() + 1, syntax_graph::npos);
+		memo.clear();
+		memo_hits = 0;
+		max_cursor = cursor = 0;
+		depth = 0;
+		on_ign = too_deep = false;
+		if (!graph.good())
+			return false;
+		const syntax_graph::range &r = graph._rules[graph._begin];
+		state result = match_syntax(r.first, r.count);
+		// The stage of "begin" keeps its nodes even if they are empty
+		root = trees.size();
+		trees.push_back({graph._begin, static_cast<std::uint32_t>(children.size()), static_cast<std::uint32_t>(product.size())});
+		children.insert(children.end(), product.begin(), product.end());
+		product.clear();
+		return result == state::eof && !too_deep;
+	}
+
+	std::vector<parse_error> parser::get_log(std::size_t n) const
+	{
+		std::vector<parse_error> log;
+		std::set<std::string> texts;
+		for (auto &it : error_log) {
+			// The errors before an aborted parse are those of the alternatives it was in the middle of
+			if (too_deep ? it.kind != error_kind::too_deep : it.cursor + n < max_cursor)
+				continue;
+			parse_error e;
+			e.cursor = it.cursor;
+			// parser_type peeks at the cursor, past the end there is only the last token left to point at
+			std::size_t at = std::min<std::size_t>(it.cursor, lex->empty() ? 0 : lex->size() - 1);
+			if (it.kind == error_kind::no_matching)
+				e.text = "No matching syntax";
+			else if (it.kind == error_kind::too_deep)
+				e.text = "Nesting too deep";
+			else
+				e.text = "Unexpected Token \'" + std::string(source.substr((*lex)[at].offset, (*lex)[at].length)) + "\'";
+			if (!texts.insert(e.text).second)
+				continue;
+			if (!lex->empty()) {
+				e.line = (*lex)[at].line;
+				e.column = (*lex)[at].column;
+			}
+			log.push_back(std::move(e));
+		}
+		return log;
+	}
+
+	parse_tree parser::get_result() const noexcept
+	{
+		parse_tree t;
+		t.source = source;
+		if (lex != nullptr)
+			t.tokens = *lex;
+		t.trees = trees;
+		t.children = children;
+		t.root = root;
+		return t;
+	}
+
+	void parser::print_ast(std::ostream &out) const
+	{
+		if (!trees.empty())
+			get_result().print_ast(out, *syn);
+	}
+
+	void parse_tree::print_ast(std::ostream &out, const syntax_graph &graph, std::size_t indent, const parser::syntax_tree &tree) const
+	{
+		const std::string &name = graph.rule_name(tree.rule);
+		out << name << '\n';
+		for (std::uint32_t i = tree.first; i < tree.first + tree.count; ++i) {
+			std::uint32_t node = children[i];
+			out << std::string(indent + 2, ' ') << name << " -> ";
+			if (node & parser::tree_bit)
+				print_ast(out, graph, indent + 2, get_tree(node));
+			else
+				out << '"' << get_text(node) << "\"\n";
+		}
+	}
+
+	void parse_tree::print_ast(std::ostream &out, const syntax_graph &graph) const
+	{
+		if (!empty())
+			print_ast(out, graph, 0, get_root());
+	}
+
+	void print_errors(std::ostream &out, std::string_view file, std::string_view source, const std::vector<parse_error> &errors)
+	{
+		cov::line_index lines;
+		lines.reset(source);
+		for (auto &e : errors) {
+			std::size_t begin = lines.line_start(e.line), end = lines.line_start(e.line + 1);
+			std::string code(source.substr(begin, end - begin));
+			if (!code.empty() && code.back() == '\n')
+				code.pop_back();
+			// generator::from_file of parsergen.csp echoes tabs as spaces
+			std::replace(code.begin(), code.end(), '\t', ' ');
+			out << "File \"" << file << "\", line " << e.line + 1 << ": " << e.text << '\n';
+			out << "> " << code << '\n' << std::string(std::max<std::int32_t>(e.column + 2, 0), ' ') << "^" << '\n' << '\n';
+		}
+	}
+
+	grammar::grammar(const lexical_rules &lex, const syntax_rules &stx) : dfa(lex), graph(stx, dfa), hash(grammar_hash(lex, stx)) {}
+
+	generator::generator() : cache(new tree_cache) {}
+
+	generator::~generator() = default;
+
+	bool generator::from_file(const grammar &gram, const std::string &path)
+	{
+		if (!file.open(path)) {
+			from_string(gram, std::string_view());
+			return false;
+		}
+		from_string(gram, file.view());
+		return true;
+	}
+
+	void generator::from_string(const grammar &gram, std::string_view source)
+	{
+		cache->close();
+		result = parse_tree();
+		result.source = source;
+		errors.clear();
+		accepted = hit = false;
+		std::string entry;
+		if (!cache_dir.empty()) {
+			char name[32];
+			std::snprintf(name, sizeof(name), "%016llx.ptc", static_cast<unsigned long long>(tree_cache_key(gram.hash, source)));
+			entry = (std::filesystem::path(cache_dir) / name).string();
+			if (cache->open(entry, gram.hash, source, gram.graph.rule_count())) {
+				bool intact = cache->for_each_error([this](std::uint32_t cursor, std::uint32_t line, std::int32_t column, std::string_view text) {
+					errors.push_back({cursor, std::string(text), line, column});
+				});
+				if (intact) {
+					accepted = cache->header().accepted;
+					if (accepted)
+						result = cache->result(source);
+					else
+						result.tokens = cache->tokens();
+					hit = true;
+					return;
+				}
+				cache->close();
+				errors.clear();
+			}
+		}
+		lex.run(gram.dfa, source);
+		for (auto &e : lex.get_errors())
+			errors.push_back({0, e.text, e.line, e.column});
+		accepted = parse.run(gram.graph, lex.get_tokens(), source);
+		if (!accepted) {
+			auto log = parse.get_log(0);
+			errors.insert(errors.end(), log.begin(), log.end());
+		}
+		std::stable_sort(errors.begin(), errors.end(), [](const parse_error &a, const parse_error &b) {
+			return a.line < b.line;
+		});
+		if (accepted)
+			result = parse.get_result();
+		else
+			result.tokens = lex.get_tokens();
+		if (!entry.empty()) {
+			// A cache which cannot be written only costs the next run a parse
+			std::error_code ec;
+			std::filesystem::create_directories(cache_dir, ec);
+			write_tree_cache(entry, gram.hash, source, result, accepted, errors);
+		}
+	}
+}
\ No newline at end of file
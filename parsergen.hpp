@@ -0,0 +1,477 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "span.hpp"
+#include <string_view>
+#include <cstdint>
+#include <ostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * Native counterpart of the parsergen package (parsergen.csp).
+ * Lexical rules are compiled once into a single minimized DFA and the source is scanned in one pass,
+ * syntax rules run on a PEG engine which memoizes every rule at every cursor.
+ */
+namespace parsergen {
+	// Named regular expression, it has to match the whole token as in lexer_type of parsergen.csp
+	struct lexical_rule {
+		std::string name, regex;
+	};
+
+	using lexical_rules = std::vector<lexical_rule>;
+
+	/*
+	 * Positions follow parsergen.csp: line is 0-based, column is the 0-based column minus one,
+	 * and a newline counts as column 0 of the line it starts.
+	 */
+	struct token {
+		// Index of the lexical rule
+		std::uint32_t type = 0;
+		std::uint32_t offset = 0, length = 0;
+		std::uint32_t line = 0;
+		std::int32_t column = 0;
+	};
+
+	struct lex_error {
+		std::string text;
+		std::uint32_t offset = 0, line = 0;
+		std::int32_t column = 0;
+	};
+
+	/*
+	 * The DFA runs on the sets of rules which matched every prefix of the token so far,
+	 * a token ends as soon as no rule of the set matches it with one more character.
+	 * The final set decides the token as in lexer_type::process_token:
+	 *   "err" together with other rules is an unexpected input,
+	 *   "ign" gives way to any other rule and is dropped otherwise,
+	 *   more than one remaining rule is ambiguous.
+	 * Supported regular expressions: literals, escapes, ., [...] classes, \d \w \s and their negations,
+	 * groups, alternation, * + ? {m,n} and lookahead of a single character (?!x) (?=x).
+	 */
+	class lexical_dfa final {
+	public:
+		// Actions of the states below zero, others emit a token of that rule
+		static constexpr std::int32_t act_none = -1, act_ignore = -2, act_unexpected = -3, act_ambiguous = -4;
+		// State 0 rejects everything, state 1 is the start of every token
+		static constexpr std::uint32_t dead_state = 0, start_state = 1;
+	private:
+		std::vector<std::string> _names;
+		std::vector<std::int32_t> _action;
+		std::vector<std::uint32_t> _next;
+		unsigned char _class[256] = {};
+		std::size_t _class_count = 0;
+		std::string _error;
+	public:
+		lexical_dfa() = default;
+		explicit lexical_dfa(const lexical_rules &rules)
+		{
+			build(rules);
+		}
+		// False and get_error() describes the offending rule if a regular expression is not supported
+		bool build(const lexical_rules &);
+		inline bool good() const noexcept
+		{
+			return !_action.empty();
+		}
+		inline const std::string &get_error() const noexcept
+		{
+			return _error;
+		}
+		inline std::size_t rule_count() const noexcept
+		{
+			return _names.size();
+		}
+		inline const std::string &rule_name(std::uint32_t type) const noexcept
+		{
+			return _names[type];
+		}
+		inline std::size_t state_count() const noexcept
+		{
+			return _action.size();
+		}
+		inline std::size_t class_count() const noexcept
+		{
+			return _class_count;
+		}
+		inline std::uint32_t next(std::uint32_t state, char c) const noexcept
+		{
+			return _next[state * _class_count + _class[static_cast<unsigned char>(c)]];
+		}
+		inline std::int32_t action(std::uint32_t state) const noexcept
+		{
+			return _action[state];
+		}
+		// End of the token starting at first, or first itself if no rule matches its first character
+		const char *longest(const char *first, const char *last, std::uint32_t &state) const noexcept
+		{
+			const std::uint32_t *table = _next.data();
+			std::uint32_t s = start_state;
+			for (; first != last; ++first) {
+				std::uint32_t t = table[s * _class_count + _class[static_cast<unsigned char>(*first)]];
+				if (t == dead_state)
+					break;
+				s = t;
+			}
+			state = s;
+			return first;
+		}
+	};
+
+	// lexer_type of parsergen.csp on top of a lexical_dfa
+	class lexer final {
+		std::vector<token> tokens;
+		std::vector<lex_error> errors;
+	public:
+		void run(const lexical_dfa &, std::string_view);
+		void clear() noexcept
+		{
+			tokens.clear();
+			errors.clear();
+		}
+		inline const std::vector<token> &get_tokens() const noexcept
+		{
+			return tokens;
+		}
+		inline const std::vector<lex_error> &get_errors() const noexcept
+		{
+			return errors;
+		}
+	};
+
+	// syntax_type of parsergen.csp
+	enum class syntax_type : unsigned char {
+		token = 1, term = 2, ref = 3, nlook = 4, repeat = 5, opt = 6, cond = 7
+	};
+
+	// syntax_impl: data is the token type, term or rule name, the other kinds hold sequences
+	struct syntax_item {
+		syntax_type type = syntax_type::token;
+		std::string data;
+		std::vector<syntax_item> items;
+		std::vector<std::vector<syntax_item>> alternatives;
+	};
+
+	using syntax_sequence = std::vector<syntax_item>;
+
+	// Rules by name, parsing starts with "begin" and "ignore" is tried wherever a token does not match
+	using syntax_rules = std::map<std::string, syntax_sequence>;
+
+	// Same constructors as the syntax namespace of parsergen.csp
+	namespace syntax {
+		inline syntax_item token(std::string type)
+		{
+			return {syntax_type::token, std::move(type), {}, {}};
+		}
+		inline syntax_item term(std::string text)
+		{
+			return {syntax_type::term, std::move(text), {}, {}};
+		}
+		inline syntax_item ref(std::string name)
+		{
+			return {syntax_type::ref, std::move(name), {}, {}};
+		}
+		// ?!(...), Negative Lookahead
+		template<typename... ArgsT>
+		syntax_item nlook(ArgsT &&...args)
+		{
+			return {syntax_type::nlook, std::string(), {std::forward<ArgsT>(args)...}, {}};
+		}
+		// {...}
+		template<typename... ArgsT>
+		syntax_item repeat(ArgsT &&...args)
+		{
+			return {syntax_type::repeat, std::string(), {std::forward<ArgsT>(args)...}, {}};
+		}
+		// [...]
+		template<typename... ArgsT>
+		syntax_item optional(ArgsT &&...args)
+		{
+			return {syntax_type::opt, std::string(), {std::forward<ArgsT>(args)...}, {}};
+		}
+		// a | b | c... ==> {a}, {b}, {c}...
+		inline syntax_item cond_or(std::vector<syntax_sequence> alternatives)
+		{
+			return {syntax_type::cond, std::string(), {}, std::move(alternatives)};
+		}
+	}
+
+	/*
+	 * Syntax rules flattened into arrays, with token types resolved to lexical rules and terms to small ids.
+	 * A token type which is not a lexical rule never matches, as in parsergen.csp.
+	 * Every cond gets a dispatch table from the FIRST sets of its alternatives, see first_sets in parsergen.cpp.
+	 */
+	class syntax_graph final {
+		friend class parser;
+		friend class first_sets;
+	public:
+		static constexpr std::uint32_t npos = UINT32_MAX;
+	private:
+		struct node {
+			syntax_type type;
+			// Lexical rule, term id or rule index, npos if nothing can match
+			// A cond keeps its dispatch table in _dispatch here, npos if it has none
+			std::uint32_t value = npos;
+			// Items of nlook, repeat and opt, alternatives of cond in _alts
+			std::uint32_t first = 0, count = 0;
+		};
+		struct range {
+			std::uint32_t first = 0, count = 0;
+		};
+		std::vector<node> _nodes;
+		std::vector<range> _alts;
+		std::vector<range> _rules;
+		std::vector<std::string> _names;
+		std::map<std::string, std::uint32_t, std::less<>> _term_ids;
+		std::uint32_t _begin = npos, _ignore = npos;
+		/*
+		 * Tables of cond: alternatives tried whatever the token is, alternatives whose failure logs "No matching syntax",
+		 * then the alternatives which may start with each token type and with each term.
+		 */
+		std::vector<std::uint64_t> _dispatch;
+		// Token types and terms which the ignore rule may start with, by the same key as the tables
+		std::vector<bool> _ignore_first;
+		bool _ignore_opaque = false, _ignore_logs_n = false;
+		std::size_t _type_count = 0;
+		std::string _error;
+		range compile(const syntax_sequence &, const lexical_dfa &, const std::map<std::string, std::uint32_t> &);
+	public:
+		syntax_graph() = default;
+		syntax_graph(const syntax_rules &rules, const lexical_dfa &dfa)
+		{
+			build(rules, dfa);
+		}
+		// False and get_error() names the problem if "begin" or a referenced rule is missing
+		bool build(const syntax_rules &, const lexical_dfa &);
+		inline bool good() const noexcept
+		{
+			return _begin != npos;
+		}
+		inline const std::string &get_error() const noexcept
+		{
+			return _error;
+		}
+		inline std::size_t rule_count() const noexcept
+		{
+			return _names.size();
+		}
+		inline const std::string &rule_name(std::uint32_t rule) const noexcept
+		{
+			return _names[rule];
+		}
+		// Id of a term, npos if no term of the grammar has this text
+		std::uint32_t term_id(std::string_view) const noexcept;
+	};
+
+	// parse_error of parsergen.csp, cursor is the index of the token the parser stood on
+	struct parse_error {
+		std::uint32_t cursor = 0;
+		std::string text;
+		std::uint32_t line = 0;
+		std::int32_t column = 0;
+	};
+
+	// Errors in the layout of print_error of parsergen.csp, the lines are echoed from source
+	void print_errors(std::ostream &, std::string_view file, std::string_view source, const std::vector<parse_error> &);
+
+	struct parse_tree;
+
+	/*
+	 * parser_type of parsergen.csp with a (rule, cursor) memo table: a rule is matched at most once per cursor,
+	 * failed alternatives reuse what they already parsed and nodes are only copied once into their tree.
+	 * The tree has the same shape and get_log() reports the same errors as parser_type; errors of a memoized
+	 * rule are logged by its first match only, which get_log() would have dropped as duplicates anyway.
+	 * Rules that recurse on themselves without consuming a token, on which parser_type never returns, are rejected.
+	 */
+	class parser final {
+	public:
+		// Trees and tokens share one index space, trees have the top bit set
+		static constexpr std::uint32_t tree_bit = 0x80000000u;
+		/*
+		 * Rules are matched by native recursion, every level of nesting in the input takes a few nested rules
+		 * of about 200 bytes of stack each (550 without optimization), so this many stay well within 8 MiB.
+		 * Deeper input is rejected with "Nesting too deep" at the token where the limit was hit.
+		 */
+		static constexpr std::size_t default_depth_limit = 10000;
+		struct syntax_tree {
+			std::uint32_t rule = 0;
+			// Children in get_children()
+			std::uint32_t first = 0, count = 0;
+		};
+		enum class state : signed char {
+			accept = 1, stop = 2, reject = -1, eof = -2
+		};
+	private:
+		// Entries of one cursor are chained from memo_head, the newest first
+		struct memo_entry {
+			std::uint32_t next, end, node;
+			std::uint32_t rule : 24;
+			state result;
+		};
+		enum class error_kind : unsigned char {
+			unexpected_token, no_matching, too_deep
+		};
+		struct error_entry {
+			std::uint32_t cursor;
+			error_kind kind;
+		};
+		const syntax_graph *syn = nullptr;
+		const std::vector<token> *lex = nullptr;
+		std::string_view source;
+		// Term id of every token
+		std::vector<std::uint32_t> terms;
+		std::vector<syntax_tree> trees;
+		std::vector<std::uint32_t> children;
+		// Nodes of the open stages, a stage is a suffix of it
+		std::vector<std::uint32_t> product;
+		std::vector<std::uint32_t> memo_head;
+		std::vector<memo_entry> memo;
+		std::size_t memo_hits = 0;
+		std::vector<error_entry> error_log;
+		std::uint32_t max_cursor = 0, cursor = 0, root = 0;
+		// Rules being matched, one native stack frame chain each
+		std::size_t depth = 0, depth_limit = default_depth_limit;
+		bool on_ign = false, too_deep = false;
+		void error(error_kind);
+		void ignore();
+		state match(const syntax_graph::node &);
+		state match_syntax(std::uint32_t, std::uint32_t);
+		state match_ref(std::uint32_t);
+	public:
+		// True if the tokens were parsed up to the end of input, as parser_type::run
+		bool run(const syntax_graph &, const std::vector<token> &, std::string_view source);
+		// Threads with a smaller or larger stack than 8 MiB can scale the limit with it
+		inline void set_depth_limit(std::size_t limit) noexcept
+		{
+			depth_limit = limit;
+		}
+		// The last run stopped at the depth limit
+		inline bool is_too_deep() const noexcept
+		{
+			return too_deep;
+		}
+		// Errors at most n tokens before the furthest one, each text once
+		std::vector<parse_error> get_log(std::size_t n) const;
+		inline const syntax_tree &get_root() const noexcept
+		{
+			return trees[root];
+		}
+		inline const syntax_tree &get_tree(std::uint32_t node) const noexcept
+		{
+			return trees[node & ~tree_bit];
+		}
+		inline const std::vector<std::uint32_t> &get_children() const noexcept
+		{
+			return children;
+		}
+		inline std::size_t memo_size() const noexcept
+		{
+			return memo.size();
+		}
+		inline std::size_t memo_hit_count() const noexcept
+		{
+			return memo_hits;
+		}
+		// The tree of the last run together with its tokens, valid until the next run
+		parse_tree get_result() const noexcept;
+		// Same layout as print_ast of parsergen.csp
+		void print_ast(std::ostream &) const;
+	};
+
+	/*
+	 * Tokens and syntax trees of a parse over its source, on the arrays of a parser or in place in a tree cache.
+	 * Nodes are numbered as in parser: trees have parser::tree_bit set, tokens do not.
+	 */
+	struct parse_tree {
+		std::string_view source;
+		cov::span<const token> tokens;
+		cov::span<const parser::syntax_tree> trees;
+		cov::span<const std::uint32_t> children;
+		std::uint32_t root = 0;
+		inline bool empty() const noexcept
+		{
+			return trees.empty();
+		}
+		inline const parser::syntax_tree &get_root() const noexcept
+		{
+			return trees[root];
+		}
+		inline const parser::syntax_tree &get_tree(std::uint32_t node) const noexcept
+		{
+			return trees[node & ~parser::tree_bit];
+		}
+		inline std::string_view get_text(std::uint32_t node) const noexcept
+		{
+			return source.substr(tokens[node].offset, tokens[node].length);
+		}
+		// Same layout as print_ast of parsergen.csp, rule names are taken from the graph the tree was parsed with
+		void print_ast(std::ostream &, const syntax_graph &) const;
+	private:
+		void print_ast(std::ostream &, const syntax_graph &, std::size_t, const parser::syntax_tree &) const;
+	};
+
+	// grammar of parsergen.csp compiled for this engine, hash keys the tree caches of its sources
+	struct grammar {
+		lexical_dfa dfa;
+		syntax_graph graph;
+		std::uint64_t hash = 0;
+		grammar(const lexical_rules &, const syntax_rules &);
+		inline bool good() const noexcept
+		{
+			return dfa.good() && graph.good();
+		}
+	};
+
+	class tree_cache;
+
+	/*
+	 * generator of parsergen.csp with stop_on_error off: the source is parsed even after lexical errors,
+	 * the errors of both stages are sorted by line and the tree is kept if parsing reached the end of input.
+	 * With a cache directory the result is looked up by the hash of grammar and source first, see tree_cache.hpp.
+	 * A hit uses the tokens and trees in place in the mapped cache file and only copies the errors,
+	 * a miss parses the source and writes its cache file.
+	 */
+	class generator final {
+		lexer lex;
+		parser parse;
+		std::unique_ptr<tree_cache> cache;
+		cov::mapped_file file;
+		std::string cache_dir;
+		parse_tree result;
+		std::vector<parse_error> errors;
+		bool accepted = false, hit = false;
+	public:
+		generator();
+		generator(const generator &) = delete;
+		generator &operator=(const generator &) = delete;
+		~generator();
+		// An empty directory turns the cache off, the directory is created when the first entry is written
+		inline void set_cache(std::string dir)
+		{
+			cache_dir = std::move(dir);
+		}
+		// False if the file cannot be read
+		bool from_file(const grammar &, const std::string &path);
+		// The source has to outlive the result
+		void from_string(const grammar &, std::string_view source);
+		// Valid until the next run, the trees are empty unless the source was accepted
+		inline const parse_tree &get_result() const noexcept
+		{
+			return result;
+		}
+		inline const std::vector<parse_error> &get_errors() const noexcept
+		{
+			return errors;
+		}
+		inline bool is_accepted() const noexcept
+		{
+			return accepted;
+		}
+		inline bool cache_hit() const noexcept
+		{
+			return hit;
+		}
+	};
+}
\ No newline at end of file
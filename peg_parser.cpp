@@ -0,0 +1,108 @@
+#include "grammars.hpp"
+#include "tree_cache.hpp"
+#include "parse_driver.hpp"
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Parser driver of the parsergen engine: every file is parsed by a generator with the grammar its extension
+ * or -l names, with the errors and optionally the tree in the layout of parsergen.csp.
+ * With -c the trees are cached by the hash of grammar and source in that directory, so a file which did not change
+ * since the last run is not lexed or parsed again. The fastest of the repeated runs is reported.
+ */
+
+static const char *language_of(const std::string &path)
+{
+	std::string ext = std::filesystem::path(path).extension().string();
+	if (ext == ".tny")
+		return "tiny";
+	else if (ext == ".c-")
+		return "c-";
+	else if (ext == ".csc" || ext == ".csp" || ext == ".ecs")
+		return "ecs-lang";
+	else
+		return nullptr;
+}
+
+int main(int argc, const char *argv[])
+{
+	std::string language, cache_dir;
+	bool tree = false, usage = false;
+	std::size_t repeat = 1;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (arg == "-l" && i + 1 < argc)
+			language = argv[++i];
+		else if (arg == "-c" && i + 1 < argc)
+			cache_dir = argv[++i];
+		else if (arg == "-t")
+			tree = true;
+		else if (arg == "-n" && i + 1 < argc)
+			repeat = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+		else if (arg.size() > 1 && arg[0] == '-')
+			usage = true;
+		else
+			inputs.emplace_back(arg);
+	}
+	// Checking CLI input
+	if (usage || inputs.empty()) {
+		std::cout << "Usage: pegparse [-l tiny|c-|ecs-lang] [-c <CACHE_DIR>] [-t] [-n <REPEAT>] <INPUT>..." << std::endl;
+		return -1;
+	}
+	// Grammars are compiled when a file needs them
+	std::map<std::string, std::unique_ptr<parsergen::grammar>> grammars;
+	auto get_grammar = [&](const std::string &name) -> const parsergen::grammar * {
+		auto it = grammars.find(name);
+		if (it != grammars.end())
+			return it->second.get();
+		std::unique_ptr<parsergen::grammar> gram;
+		if (name == "tiny")
+			gram = std::make_unique<parsergen::grammar>(parsergen::tiny_lexical, parsergen::tiny_syntax);
+		else if (name == "c-")
+			gram = std::make_unique<parsergen::grammar>(parsergen::cminus_lexical, parsergen::cminus_syntax);
+		else if (name == "ecs-lang")
+			gram = std::make_unique<parsergen::grammar>(parsergen::covscript_lexical, parsergen::covscript_syntax);
+		if (gram && !gram->good())
+			gram.reset();
+		return (grammars[name] = std::move(gram)).get();
+	};
+	int status = 0;
+	parsergen::generator gen;
+	gen.set_cache(cache_dir);
+	for (auto &path : inputs) {
+		const char *name = language.empty() ? language_of(path) : language.c_str();
+		const parsergen::grammar *gram = name != nullptr ? get_grammar(name) : nullptr;
+		if (gram == nullptr) {
+			std::cout << "Unknown language of " << path << ", use -l tiny|c-|ecs-lang" << std::endl;
+			status = -1;
+			continue;
+		}
+		bool opened = true;
+		double time = cov::best_time(repeat, [&] {
+			opened = gen.from_file(*gram, path);
+		});
+		if (!opened) {
+			std::cout << "Cannot open input file: " << path << std::endl;
+			status = -1;
+			continue;
+		}
+		auto &result = gen.get_result();
+		std::cout << std::endl << path << ":" << std::endl << std::endl;
+		parsergen::print_errors(std::cout, path, result.source, gen.get_errors());
+		if (tree && gen.is_accepted())
+			result.print_ast(std::cout, gram->graph);
+		std::cout << result.tokens.size() << " tokens" << std::endl;
+		std::cout << "Parse Time: " << time * 1e3 << " ms";
+		if (!cache_dir.empty())
+			std::cout << (gen.cache_hit() ? ", cache hit" : ", cache miss");
+		std::cout << std::endl;
+		if (!gen.is_accepted() || !gen.get_errors().empty())
+			status = -1;
+	}
+	return status;
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "token_writer.hpp"
+#include <string_view>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace cov {
+	// What tells the scanner drivers apart
+	struct scan_language {
+		const char *program;
+		const char *extension;
+		const char *title;
+	};
+
+	struct scan_options {
+		token_format format = token_format::listing;
+		// Reuse and refresh <INPUT>.tkc token caches
+		bool cache = false;
+	};
+
+	/*
+	 * Lex one file and write its tokens next to it in the given format.
+	 * Everything meant for the console is collected in report so that parallel runs can print it in input order.
+	 * With a pool the file itself is split between its workers.
+	 */
+	template<typename lexer_t>
+	bool scan_file(lexer_t &lex, output_buffer &out, const scan_language &lang, const scan_options &opt, const std::string &if_name, std::string &report, thread_pool *pool = nullptr)
+	{
+		std::ostringstream diag;
+		std::string_view ext(lang.extension);
+		if (if_name.size() <= ext.size() || if_name.compare(if_name.size() - ext.size(), ext.size(), ext) != 0) {
+			diag << "Invalid input file: " << if_name << std::endl;
+			report = diag.str();
+			return false;
+		}
+		std::string of_name = if_name.substr(0, if_name.size() - ext.size()) + format_extension(opt.format);
+		diag << std::endl << "Writing result to: " << of_name << "..." << std::endl << std::endl;
+		bool ok;
+		if (opt.cache)
+			ok = lex.lex_cached(if_name);
+		else if (pool != nullptr)
+			ok = lex.lex_file(if_name, *pool);
+		else
+			ok = lex.lex_file(if_name);
+		if (!ok)
+			diag << "Cannot open input file: " << if_name << std::endl;
+		else if (!out.open(of_name)) {
+			diag << "Cannot open output file: " << of_name << std::endl;
+			ok = false;
+		}
+		else {
+			switch (opt.format) {
+			case token_format::listing:
+				write_listing(lex, lang.title, out, diag);
+				break;
+			case token_format::json:
+				write_json(lex, out);
+				break;
+			case token_format::binary:
+				write_binary(lex, out);
+				break;
+			}
+			ok = out.close();
+		}
+		report = diag.str();
+		return ok;
+	}
+
+	// Directories are searched recursively for files with the language's extension, in sorted order
+	inline void collect_inputs(const scan_language &lang, const std::string &arg, std::vector<std::string> &inputs)
+	{
+		namespace fs = std::filesystem;
+		std::error_code ec;
+		if (!fs::is_directory(arg, ec)) {
+			inputs.push_back(arg);
+			return;
+		}
+		std::vector<std::string> found;
+		for (fs::recursive_directory_iterator it(arg, ec), end; !ec && it != end; it.increment(ec)) {
+			if (it->is_regular_file(ec) && it->path().extension() == lang.extension)
+				found.push_back(it->path().string());
+		}
+		std::sort(found.begin(), found.end());
+		inputs.insert(inputs.end(), found.begin(), found.end());
+	}
+
+	/*
+	 * Shared main() of the scanners: any number of files or directories, lexed on a thread pool with one lexer per worker.
+	 * Console output of every file is printed as one block, in the order the files were given.
+	 */
+	template<typename lexer_t>
+	int scan_main(const scan_language &lang, int argc, const char *argv[])
+	{
+		std::size_t threads = std::thread::hardware_concurrency();
+		scan_options opt;
+		bool usage = false;
+		std::vector<std::string> inputs;
+		for (int i = 1; i < argc; ++i) {
+			std::string_view arg(argv[i]);
+			if (arg == "-f" && i + 1 < argc) {
+				arg = argv[++i];
+				if (arg == "listing")
+					opt.format = token_format::listing;
+				else if (arg == "json")
+					opt.format = token_format::json;
+				else if (arg == "binary")
+					opt.format = token_format::binary;
+				else
+					usage = true;
+				continue;
+			}
+			if (arg == "-c") {
+				opt.cache = true;
+				continue;
+			}
+			if (arg.substr(0, 2) == "-j") {
+				if (arg.size() == 2 && i + 1 < argc)
+					arg = argv[++i];
+				else
+					arg.remove_prefix(2);
+				threads = std::strtoul(std::string(arg).c_str(), nullptr, 10);
+				continue;
+			}
+			collect_inputs(lang, argv[i], inputs);
+		}
+		// Checking CLI input
+		if (usage || inputs.empty()) {
+			std::cout << "Usage: " << lang.program << " [-j <THREADS>] [-f listing|json|binary] [-c] <INPUT>" << lang.extension << "|<DIRECTORY>..." << std::endl;
+			return -1;
+		}
+		threads = std::max<std::size_t>(threads, 1);
+		// A single file is lexed in parallel chunks instead
+		if (inputs.size() == 1) {
+			thread_pool pool(threads);
+			lexer_t lex;
+			output_buffer out;
+			std::string report;
+			bool ok = scan_file(lex, out, lang, opt, inputs.front(), report, &pool);
+			std::cout << report << std::flush;
+			return ok ? 0 : -1;
+		}
+		thread_pool pool(std::min(threads, inputs.size()));
+		std::vector<lexer_t> lexers(pool.size());
+		std::unique_ptr<output_buffer[]> outs(new output_buffer[pool.size()]);
+		std::vector<std::string> reports(inputs.size());
+		std::vector<char> done(inputs.size(), false), failed(inputs.size(), false);
+		std::mutex print_lock;
+		std::size_t printed = 0;
+		pool.parallel_for(inputs.size(), [&](std::size_t worker, std::size_t i) {
+			failed[i] = !scan_file(lexers[worker], outs[worker], lang, opt, inputs[i], reports[i]);
+			std::lock_guard<std::mutex> guard(print_lock);
+			done[i] = true;
+			// Print every finished report which is no longer waiting on an earlier file
+			for (; printed < inputs.size() && done[printed]; ++printed) {
+				std::cout << reports[printed] << std::flush;
+				std::string().swap(reports[printed]);
+			}
+		});
+		return std::find(failed.begin(), failed.end(), true) == failed.end() ? 0 : -1;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "simd_scan.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define COV_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace cov {
+	namespace scalar {
+		inline bool is_blank(unsigned char c)
+		{
+			return c == ' ' || (c >= '\t' && c <= '\r') || c == '\0';
+		}
+
+		inline bool is_digit(unsigned char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+
+		inline bool is_ident(unsigned char c)
+		{
+			return is_digit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_';
+		}
+
+		const char *skip_blank(const char *p, const char *end) noexcept
+		{
+			while (p != end && is_blank(*p))
+				++p;
+			return p;
+		}
+
+		const char *find_char(const char *p, const char *end, char c) noexcept
+		{
+			while (p != end && *p != c)
+				++p;
+			return p;
+		}
+
+		void find_lines(const char *begin, const char *p, const char *end, std::vector<std::uint32_t> &starts)
+		{
+			for (; p != end; ++p) {
+				if (*p == '\n')
+					starts.push_back(static_cast<std::uint32_t>(p + 1 - begin));
+			}
+		}
+
+		const char *skip_ident(const char *p, const char *end) noexcept
+		{
+			while (p != end && is_ident(*p))
+				++p;
+			return p;
+		}
+
+		const char *skip_digit(const char *p, const char *end) noexcept
+		{
+			while (p != end && is_digit(*p))
+				++p;
+			return p;
+		}
+	}
+
+#ifdef COV_SIMD_X86
+	inline unsigned first_bit(unsigned m)
+	{
+		return __builtin_ctz(m);
+	}
+
+	// Line starts behind the newlines of a block, one bit per byte in nl
+	inline void push_lines(std::uint32_t offset, unsigned nl, std::vector<std::uint32_t> &starts)
+	{
+		for (; nl != 0; nl &= nl - 1)
+			starts.push_back(offset + first_bit(nl) + 1);
+	}
+
+	namespace sse2 {
+		// Unsigned lo <= v - base <= lo + span per byte
+		inline __m128i in_range(__m128i v, char base, char span)
+		{
+			__m128i t = _mm_sub_epi8(v, _mm_set1_epi8(base));
+			return _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(span)), t);
+		}
+
+		inline __m128i blank(__m128i v)
+		{
+			return _mm_or_si128(in_range(v, '\t', '\r' - '\t'), _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_setzero_si128())));
+		}
+
+		inline __m128i digit(__m128i v)
+		{
+			return in_range(v, '0', 9);
+		}
+
+		inline __m128i ident(__m128i v)
+		{
+			__m128i alpha = in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 25);
+			return _mm_or_si128(_mm_or_si128(alpha, digit(v)), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+		}
+
+		inline unsigned newlines(__m128i v)
+		{
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		}
+
+		const char *skip_blank(const char *p, const char *end) noexcept
+		{
+			for (; end - p >= 16; p += 16) {
+				unsigned stop = ~_mm_movemask_epi8(blank(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))) & 0xffff;
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return scalar::skip_blank(p, end);
+		}
+
+		const char *find_char(const char *p, const char *end, char c) noexcept
+		{
+			__m128i key = _mm_set1_epi8(c);
+			for (; end - p >= 16; p += 16) {
+				unsigned stop = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), key));
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return scalar::find_char(p, end, c);
+		}
+
+		void find_lines(const char *begin, const char *p, const char *end, std::vector<std::uint32_t> &starts)
+		{
+			for (; end - p >= 16; p += 16)
+				push_lines(static_cast<std::uint32_t>(p - begin), newlines(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))), starts);
+			scalar::find_lines(begin, p, end, starts);
+		}
+
+		const char *skip_ident(const char *p, const char *end) noexcept
+		{
+			for (; end - p >= 16; p += 16) {
+				unsigned stop = ~_mm_movemask_epi8(ident(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))) & 0xffff;
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return scalar::skip_ident(p, end);
+		}
+
+		const char *skip_digit(const char *p, const char *end) noexcept
+		{
+			for (; end - p >= 16; p += 16) {
+				unsigned stop = ~_mm_movemask_epi8(digit(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))) & 0xffff;
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return scalar::skip_digit(p, end);
+		}
+	}
+
+#define COV_AVX2 __attribute__((target("avx2")))
+
+	namespace avx2 {
+		COV_AVX2 inline __m256i in_range(__m256i v, char base, char span)
+		{
+			__m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8(base));
+			return _mm256_cmpeq_epi8(_mm256_min_epu8(t, _mm256_set1_epi8(span)), t);
+		}
+
+		COV_AVX2 inline __m256i blank(__m256i v)
+		{
+			return _mm256_or_si256(in_range(v, '\t', '\r' - '\t'), _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+		}
+
+		COV_AVX2 inline __m256i digit(__m256i v)
+		{
+			return in_range(v, '0', 9);
+		}
+
+		COV_AVX2 inline __m256i ident(__m256i v)
+		{
+			__m256i alpha = in_range(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 25);
+			return _mm256_or_si256(_mm256_or_si256(alpha, digit(v)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+		}
+
+		COV_AVX2 inline unsigned newlines(__m256i v)
+		{
+			return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		}
+
+		COV_AVX2 const char *skip_blank(const char *p, const char *end) noexcept
+		{
+			for (; end - p >= 32; p += 32) {
+				unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(blank(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)))));
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return sse2::skip_blank(p, end);
+		}
+
+		COV_AVX2 const char *find_char(const char *p, const char *end, char c) noexcept
+		{
+			__m256i key = _mm256_set1_epi8(c);
+			for (; end - p >= 32; p += 32) {
+				unsigned stop = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), key));
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return sse2::find_char(p, end, c);
+		}
+
+		COV_AVX2 void find_lines(const char *begin, const char *p, const char *end, std::vector<std::uint32_t> &starts)
+		{
+			for (; end - p >= 32; p += 32)
+				push_lines(static_cast<std::uint32_t>(p - begin), newlines(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))), starts);
+			sse2::find_lines(begin, p, end, starts);
+		}
+
+		COV_AVX2 const char *skip_ident(const char *p, const char *end) noexcept
+		{
+			for (; end - p >= 32; p += 32) {
+				unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(ident(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)))));
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return sse2::skip_ident(p, end);
+		}
+
+		COV_AVX2 const char *skip_digit(const char *p, const char *end) noexcept
+		{
+			for (; end - p >= 32; p += 32) {
+				unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(digit(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)))));
+				if (stop != 0)
+					return p + first_bit(stop);
+			}
+			return sse2::skip_digit(p, end);
+		}
+	}
+#endif
+
+	struct scan_kernels {
+		simd_level level;
+		const char *(*skip_blank)(const char *, const char *) noexcept;
+		const char *(*find_char)(const char *, const char *, char) noexcept;
+		const char *(*skip_ident)(const char *, const char *) noexcept;
+		const char *(*skip_digit)(const char *, const char *) noexcept;
+		void (*find_lines)(const char *, const char *, const char *, std::vector<std::uint32_t> &);
+	};
+
+	static const scan_kernels kernel_table[] = {
+		{simd_level::scalar, scalar::skip_blank, scalar::find_char, scalar::skip_ident, scalar::skip_digit, scalar::find_lines},
+#ifdef COV_SIMD_X86
+		{simd_level::sse2, sse2::skip_blank, sse2::find_char, sse2::skip_ident, sse2::skip_digit, sse2::find_lines},
+		{simd_level::avx2, avx2::skip_blank, avx2::find_char, avx2::skip_ident, avx2::skip_digit, avx2::find_lines},
+#endif
+	};
+
+	simd_level detect_simd() noexcept
+	{
+#ifdef COV_SIMD_X86
+		if (__builtin_cpu_supports("avx2"))
+			return simd_level::avx2;
+		return simd_level::sse2;
+#else
+		return simd_level::scalar;
+#endif
+	}
+
+	static const scan_kernels *active_kernels = &kernel_table[static_cast<unsigned char>(detect_simd())];
+
+	simd_level get_simd() noexcept
+	{
+		return active_kernels->level;
+	}
+
+	void set_simd(simd_level level) noexcept
+	{
+		if (level > detect_simd())
+			level = detect_simd();
+		active_kernels = &kernel_table[static_cast<unsigned char>(level)];
+	}
+
+	const char *skip_blank(const char *p, const char *end) noexcept
+	{
+		return active_kernels->skip_blank(p, end);
+	}
+
+	const char *find_char(const char *p, const char *end, char c) noexcept
+	{
+		return active_kernels->find_char(p, end, c);
+	}
+
+	const char *skip_ident(const char *p, const char *end) noexcept
+	{
+		return active_kernels->skip_ident(p, end);
+	}
+
+	const char *skip_digit(const char *p, const char *end) noexcept
+	{
+		return active_kernels->skip_digit(p, end);
+	}
+
+	void find_lines(const char *begin, const char *p, const char *end, std::vector<std::uint32_t> &starts)
+	{
+		active_kernels->find_lines(begin, p, end, starts);
+	}
+}
\ No newline at end of file
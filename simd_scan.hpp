@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace cov {
+	enum class simd_level : unsigned char {
+		scalar, sse2, avx2
+	};
+
+	// Best level supported by the running CPU
+	simd_level detect_simd() noexcept;
+
+	simd_level get_simd() noexcept;
+
+	// Force a level, e.g. for benchmarks, levels above detect_simd() are clamped
+	void set_simd(simd_level) noexcept;
+
+	// First byte in [p, end) which is not blank (std::isspace or '\0')
+	const char *skip_blank(const char *p, const char *end) noexcept;
+
+	// First occurrence of c in [p, end), or end
+	const char *find_char(const char *p, const char *end, char c) noexcept;
+
+	// First byte in [p, end) which is not an identifier character ([0-9A-Za-z_])
+	const char *skip_ident(const char *p, const char *end) noexcept;
+
+	// First byte in [p, end) which is not a decimal digit
+	const char *skip_digit(const char *p, const char *end) noexcept;
+
+	// Offset from begin of the byte after every '\n' in [p, end), appended to starts
+	void find_lines(const char *begin, const char *p, const char *end, std::vector<std::uint32_t> &starts);
+}
\ No newline at end of file
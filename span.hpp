@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace cov {
+	// Non-owning view of a contiguous array, std::span is C++20
+	template<typename T>
+	class span final {
+		T *_data = nullptr;
+		std::size_t _size = 0;
+	public:
+		constexpr span() = default;
+		constexpr span(T *data, std::size_t size) : _data(data), _size(size) {}
+		template<typename U>
+		span(const std::vector<U> &vec) : _data(vec.data()), _size(vec.size()) {}
+		constexpr T *data() const noexcept
+		{
+			return _data;
+		}
+		constexpr std::size_t size() const noexcept
+		{
+			return _size;
+		}
+		constexpr bool empty() const noexcept
+		{
+			return _size == 0;
+		}
+		constexpr T *begin() const noexcept
+		{
+			return _data;
+		}
+		constexpr T *end() const noexcept
+		{
+			return _data + _size;
+		}
+		constexpr T &operator[](std::size_t i) const noexcept
+		{
+			return _data[i];
+		}
+		constexpr T &front() const noexcept
+		{
+			return _data[0];
+		}
+		constexpr T &back() const noexcept
+		{
+			return _data[_size - 1];
+		}
+	};
+}
\ No newline at end of file
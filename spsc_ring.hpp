@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+namespace cov {
+	/*
+	 * Lock-free ring between exactly one producer and one consumer thread, moving elements in batches.
+	 * Each side owns one index and only reads the other one, so a batch costs two atomic operations.
+	 * A full ring holds the producer back and an empty one the consumer, the time either side spent
+	 * waiting is counted so a pipeline can tell which of its stages is the bottleneck.
+	 */
+	template<typename T>
+	class spsc_ring final {
+	public:
+		struct stall_info {
+			// Waits of the producer on a full ring and of the consumer on an empty one
+			std::size_t push_stalls = 0, pop_stalls = 0;
+			double push_seconds = 0, pop_seconds = 0;
+		};
+	private:
+		using clock_t = std::chrono::steady_clock;
+		std::unique_ptr<T[]> _data;
+		std::size_t _mask;
+		// Indices count up forever and are masked on access, on separate cache lines to avoid false sharing
+		alignas(64) std::atomic<std::size_t> _head{0};
+		alignas(64) std::atomic<std::size_t> _tail{0};
+		std::atomic<bool> _closed{false};
+		alignas(64) stall_info _stats;
+		// Spin briefly for the other side, then give up the processor
+		static void backoff(std::size_t &spins)
+		{
+			if (++spins >= 64)
+				std::this_thread::yield();
+		}
+	public:
+		// The capacity is rounded up to a power of two
+		explicit spsc_ring(std::size_t capacity = 1 << 14)
+		{
+			std::size_t n = 1;
+			while (n < capacity)
+				n <<= 1;
+			_data.reset(new T[n]);
+			_mask = n - 1;
+		}
+		spsc_ring(const spsc_ring &) = delete;
+		spsc_ring &operator=(const spsc_ring &) = delete;
+		inline std::size_t capacity() const noexcept
+		{
+			return _mask + 1;
+		}
+		// Ready for another run, neither side may be active
+		void reset() noexcept
+		{
+			_head.store(0, std::memory_order_relaxed);
+			_tail.store(0, std::memory_order_relaxed);
+			_closed.store(false, std::memory_order_relaxed);
+			_stats = stall_info();
+		}
+		// Producer: publish all of [data, data + n), waiting for room whenever the ring is full
+		void push(const T *data, std::size_t n)
+		{
+			std::size_t tail = _tail.load(std::memory_order_relaxed);
+			while (n > 0) {
+				std::size_t room = capacity() - (tail - _head.load(std::memory_order_acquire));
+				if (room == 0) {
+					auto start = clock_t::now();
+					std::size_t spins = 0;
+					do {
+						backoff(spins);
+						room = capacity() - (tail - _head.load(std::memory_order_acquire));
+					} while (room == 0);
+					++_stats.push_stalls;
+					_stats.push_seconds += std::chrono::duration<double>(clock_t::now() - start).count();
+				}
+				// Up to the end of the storage, the rest of the batch wraps around in the next round
+				std::size_t at = tail & _mask, count = std::min({n, room, capacity() - at});
+				std::copy(data, data + count, _data.get() + at);
+				tail += count;
+				data += count;
+				n -= count;
+				_tail.store(tail, std::memory_order_release);
+			}
+		}
+		// Producer: nothing follows, the consumer drains what is left
+		void close() noexcept
+		{
+			_closed.store(true, std::memory_order_release);
+		}
+		/*
+		 * Consumer: append every element available to out, waiting while the ring is empty.
+		 * Returns the number of elements taken, 0 only once the producer has closed the ring and it is empty.
+		 */
+		template<typename container_t>
+		std::size_t pop(container_t &out)
+		{
+			std::size_t head = _head.load(std::memory_order_relaxed), tail = _tail.load(std::memory_order_acquire);
+			if (head == tail) {
+				auto start = clock_t::now();
+				std::size_t spins = 0;
+				for (;;) {
+					// Closing is published after the last batch, so it is only trusted after another look at tail
+					bool closed = _closed.load(std::memory_order_acquire);
+					tail = _tail.load(std::memory_order_acquire);
+					if (head != tail || closed)
+						break;
+					backoff(spins);
+				}
+				++_stats.pop_stalls;
+				_stats.pop_seconds += std::chrono::duration<double>(clock_t::now() - start).count();
+				if (head == tail)
+					return 0;
+			}
+			std::size_t n = tail - head, at = head & _mask, first = std::min(n, capacity() - at);
+			out.insert(out.end(), _data.get() + at, _data.get() + at + first);
+			out.insert(out.end(), _data.get(), _data.get() + (n - first));
+			_head.store(tail, std::memory_order_release);
+			return n;
+		}
+		// Either side's counters are only consistent once both have finished
+		inline const stall_info &get_stalls() const noexcept
+		{
+			return _stats;
+		}
+	};
+}
\ No newline at end of file
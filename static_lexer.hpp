@@ -0,0 +1,532 @@
+#pragma once
+
+#include "simd_scan.hpp"
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <iterator>
+#include <array>
+
+namespace cov {
+	// Lexical rule of a static_scanner, kind and subtype are only interpreted by the language
+	struct static_rule {
+		std::string_view regex;
+		unsigned char kind = 0, subtype = 0;
+	};
+
+	namespace static_detail {
+		struct byte_set {
+			std::uint64_t bits[4] = {};
+			constexpr void set(unsigned c) noexcept
+			{
+				bits[c >> 6] |= std::uint64_t(1) << (c & 63);
+			}
+			constexpr void set(unsigned lo, unsigned hi) noexcept
+			{
+				for (unsigned c = lo; c <= hi; ++c)
+					set(c);
+			}
+			constexpr bool test(unsigned c) const noexcept
+			{
+				return (bits[c >> 6] >> (c & 63)) & 1;
+			}
+			constexpr void merge(const byte_set &s) noexcept
+			{
+				for (int i = 0; i < 4; ++i)
+					bits[i] |= s.bits[i];
+			}
+			constexpr byte_set inverse() const noexcept
+			{
+				byte_set s;
+				for (int i = 0; i < 4; ++i)
+					s.bits[i] = ~bits[i];
+				return s;
+			}
+		};
+
+		// Thompson automaton in fixed arrays, every fragment has one start and one open end state
+		template<std::size_t MaxNfa>
+		struct nfa_graph {
+			enum kind_type : unsigned char {
+				epsilon, split, chars, accept
+			};
+			kind_type kind[MaxNfa] = {};
+			int out[MaxNfa] = {}, out1[MaxNfa] = {}, rule[MaxNfa] = {};
+			byte_set set[MaxNfa] = {};
+			std::size_t count = 0;
+			bool overflow = false;
+			constexpr int make(kind_type k, int o = -1, int o1 = -1) noexcept
+			{
+				if (count == MaxNfa) {
+					overflow = true;
+					return 0;
+				}
+				kind[count] = k;
+				out[count] = o;
+				out1[count] = o1;
+				return count++;
+			}
+		};
+
+		struct fragment {
+			int start = -1, end = -1;
+		};
+
+		/*
+		 * Regular expressions of the covci.csc rule maps without anchors, tokens are matched as a whole:
+		 * literals, escapes (\d \w \s and their negations, \n \t \r \f \v \0 \xHH), ., [...] classes,
+		 * groups, alternation, * + and ?.
+		 */
+		template<std::size_t MaxNfa>
+		class regex_compiler {
+			nfa_graph<MaxNfa> &g;
+			std::string_view re;
+			std::size_t i = 0;
+		public:
+			bool bad = false;
+		private:
+			constexpr bool more() const noexcept
+			{
+				return i < re.size();
+			}
+			constexpr fragment fail() noexcept
+			{
+				bad = true;
+				return fragment{};
+			}
+			constexpr fragment make_set(const byte_set &s) noexcept
+			{
+				int e = g.make(g.epsilon);
+				int b = g.make(g.chars, e);
+				g.set[b] = s;
+				return fragment{b, e};
+			}
+			static constexpr int hex(char c) noexcept
+			{
+				return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+			}
+			// Escape after the backslash, a class goes to s, a single character is returned
+			constexpr int escape(byte_set &s) noexcept
+			{
+				if (!more()) {
+					bad = true;
+					return -1;
+				}
+				byte_set digit, word, space;
+				digit.set('0', '9');
+				word.merge(digit);
+				word.set('a', 'z');
+				word.set('A', 'Z');
+				word.set('_');
+				for (char c : {' ', '\t', '\n', '\v', '\f', '\r'})
+					space.set(static_cast<unsigned char>(c));
+				switch (char e = re[i++]) {
+				case 'd':
+					s = digit;
+					return -1;
+				case 'D':
+					s = digit.inverse();
+					return -1;
+				case 'w':
+					s = word;
+					return -1;
+				case 'W':
+					s = word.inverse();
+					return -1;
+				case 's':
+					s = space;
+					return -1;
+				case 'S':
+					s = space.inverse();
+					return -1;
+				case 'n':
+					return '\n';
+				case 't':
+					return '\t';
+				case 'r':
+					return '\r';
+				case 'f':
+					return '\f';
+				case 'v':
+					return '\v';
+				case '0':
+					return 0;
+				case 'x': {
+					int hi = i < re.size() ? hex(re[i]) : -1, lo = i + 1 < re.size() ? hex(re[i + 1]) : -1;
+					if (hi < 0 || lo < 0) {
+						bad = true;
+						return -1;
+					}
+					i += 2;
+					return hi * 16 + lo;
+				}
+				default:
+					return static_cast<unsigned char>(e);
+				}
+			}
+			constexpr fragment char_class() noexcept
+			{
+				byte_set s;
+				bool negate = more() && re[i] == '^';
+				if (negate)
+					++i;
+				for (bool first = true; more() && (first || re[i] != ']'); first = false) {
+					int lo = static_cast<unsigned char>(re[i++]);
+					if (lo == '\\') {
+						byte_set esc;
+						lo = escape(esc);
+						if (lo < 0) {
+							s.merge(esc);
+							continue;
+						}
+					}
+					int hi = lo;
+					if (i + 1 < re.size() && re[i] == '-' && re[i + 1] != ']') {
+						++i;
+						hi = static_cast<unsigned char>(re[i++]);
+						if (hi == '\\') {
+							byte_set esc;
+							hi = escape(esc);
+						}
+						if (hi < lo)
+							return fail();
+					}
+					s.set(lo, hi);
+				}
+				if (!more())
+					return fail();
+				++i;
+				return make_set(negate ? s.inverse() : s);
+			}
+			constexpr fragment atom() noexcept
+			{
+				char c = re[i++];
+				byte_set s;
+				switch (c) {
+				case '(': {
+					if (re.substr(i, 2) == "?:")
+						i += 2;
+					fragment f = alternation();
+					if (!more() || re[i] != ')')
+						return fail();
+					++i;
+					return f;
+				}
+				case '[':
+					return char_class();
+				case '.':
+					s.set(0, 255);
+					s.bits[0] &= ~((std::uint64_t(1) << '\n') | (std::uint64_t(1) << '\r'));
+					return make_set(s);
+				case '\\': {
+					int e = escape(s);
+					if (e >= 0)
+						s.set(e);
+					return make_set(s);
+				}
+				case '*':
+				case '+':
+				case '?':
+					return fail();
+				default:
+					s.set(static_cast<unsigned char>(c));
+					return make_set(s);
+				}
+			}
+			constexpr fragment quantified() noexcept
+			{
+				fragment f = atom();
+				while (!bad && f.end >= 0 && more() && (re[i] == '*' || re[i] == '+' || re[i] == '?')) {
+					char q = re[i++];
+					int e = g.make(g.epsilon);
+					int s = g.make(g.split, f.start, e);
+					g.out[f.end] = q == '?' ? e : s;
+					f = fragment{q == '+' ? f.start : s, e};
+				}
+				return f;
+			}
+			constexpr fragment concatenation() noexcept
+			{
+				int e = g.make(g.epsilon);
+				fragment f{e, e};
+				while (!bad && more() && re[i] != '|' && re[i] != ')') {
+					fragment n = quantified();
+					if (bad)
+						return n;
+					g.out[f.end] = n.start;
+					f.end = n.end;
+				}
+				return f;
+			}
+			constexpr fragment alternation() noexcept
+			{
+				fragment f = concatenation();
+				while (!bad && more() && re[i] == '|') {
+					++i;
+					fragment n = concatenation();
+					if (bad)
+						return n;
+					int e = g.make(g.epsilon);
+					g.out[f.end] = e;
+					g.out[n.end] = e;
+					f = fragment{g.make(g.split, f.start, n.start), e};
+				}
+				return f;
+			}
+		public:
+			constexpr regex_compiler(nfa_graph<MaxNfa> &graph, std::string_view str) : g(graph), re(str) {}
+			// Start state of the rule, which ends in an accepting state
+			constexpr int compile(int rule) noexcept
+			{
+				fragment f = alternation();
+				if (bad || more()) {
+					bad = true;
+					return 0;
+				}
+				int a = g.make(g.accept);
+				g.rule[a] = rule;
+				g.out[f.end] = a;
+				return f.start;
+			}
+		};
+
+		template<std::size_t MaxNfa>
+		struct state_set {
+			std::uint64_t bits[(MaxNfa + 63) / 64] = {};
+			constexpr bool test(std::size_t s) const noexcept
+			{
+				return (bits[s >> 6] >> (s & 63)) & 1;
+			}
+			constexpr void set(std::size_t s) noexcept
+			{
+				bits[s >> 6] |= std::uint64_t(1) << (s & 63);
+			}
+			constexpr bool empty() const noexcept
+			{
+				for (auto b : bits)
+					if (b != 0)
+						return false;
+				return true;
+			}
+			constexpr bool operator==(const state_set &s) const noexcept
+			{
+				for (std::size_t k = 0; k < std::size(bits); ++k)
+					if (bits[k] != s.bits[k])
+						return false;
+				return true;
+			}
+		};
+
+		// Subset construction with capacities, state 0 rejects everything and state 1 starts every token
+		template<std::size_t MaxNfa, std::size_t MaxDfa>
+		struct dfa_builder {
+			nfa_graph<MaxNfa> nfa;
+			state_set<MaxNfa> sets[MaxDfa] = {};
+			std::uint8_t next[MaxDfa][256] = {};
+			std::int16_t accept[MaxDfa] = {};
+			std::size_t count = 0;
+			bool good = false;
+			constexpr void closure(state_set<MaxNfa> &s) noexcept
+			{
+				int stack[MaxNfa] = {};
+				std::size_t top = 0;
+				for (std::size_t w = 0; w < std::size(s.bits); ++w)
+					for (std::uint64_t b = s.bits[w]; b != 0; b &= b - 1) {
+						int n = w * 64;
+						while (!((b >> (n - w * 64)) & 1))
+							++n;
+						stack[top++] = n;
+					}
+				while (top > 0) {
+					int n = stack[--top];
+					if (nfa.kind[n] != nfa.epsilon && nfa.kind[n] != nfa.split)
+						continue;
+					for (int o : {nfa.out[n], nfa.out1[n]}) {
+						if (o >= 0 && !s.test(o)) {
+							s.set(o);
+							stack[top++] = o;
+						}
+					}
+				}
+			}
+			constexpr std::size_t add(const state_set<MaxNfa> &s) noexcept
+			{
+				for (std::size_t d = 2; d < count; ++d)
+					if (sets[d] == s)
+						return d;
+				if (count == MaxDfa)
+					return 0;
+				sets[count] = s;
+				accept[count] = -1;
+				for (std::size_t n = 0; n < nfa.count; ++n)
+					if (s.test(n) && nfa.kind[n] == nfa.accept && (accept[count] < 0 || nfa.rule[n] < accept[count]))
+						accept[count] = nfa.rule[n];
+				return count++;
+			}
+			template<std::size_t N>
+			constexpr dfa_builder(const static_rule (&rules)[N]) noexcept
+			{
+				static_assert(MaxDfa <= 256, "static_scanner: states are stored in bytes");
+				state_set<MaxNfa> start;
+				for (std::size_t r = 0; r < N; ++r) {
+					regex_compiler<MaxNfa> compiler(nfa, rules[r].regex);
+					int s = compiler.compile(r);
+					if (compiler.bad || nfa.overflow)
+						return;
+					start.set(s);
+				}
+				closure(start);
+				// The start state is never entered again, so it is not shared with another set
+				accept[0] = accept[1] = -1;
+				sets[1] = start;
+				count = 2;
+				// Bytes are grouped by the character sets they belong to, each group is stepped once
+				int group[256] = {};
+				int groups = 1;
+				for (std::size_t n = 0; n < nfa.count; ++n) {
+					if (nfa.kind[n] != nfa.chars)
+						continue;
+					int split[512] = {};
+					for (int k = 0; k < 512; ++k)
+						split[k] = -1;
+					int renamed = 0;
+					for (unsigned c = 0; c < 256; ++c) {
+						int key = group[c] * 2 + nfa.set[n].test(c);
+						if (split[key] < 0)
+							split[key] = renamed++;
+						group[c] = split[key];
+					}
+					groups = renamed;
+				}
+				// Representative byte of every group and the groups matched by every character set
+				unsigned sample[256] = {};
+				for (unsigned c = 256; c-- > 0;)
+					sample[group[c]] = c;
+				int chars[MaxNfa] = {};
+				std::size_t chars_count = 0;
+				for (std::size_t n = 0; n < nfa.count; ++n)
+					if (nfa.kind[n] == nfa.chars)
+						chars[chars_count++] = n;
+				state_set<MaxNfa> moved[256] = {};
+				std::size_t to[256] = {};
+				for (std::size_t d = 1; d < count; ++d) {
+					for (int k = 0; k < groups; ++k)
+						moved[k] = state_set<MaxNfa>();
+					for (std::size_t m = 0; m < chars_count; ++m) {
+						int n = chars[m];
+						if (!sets[d].test(n))
+							continue;
+						for (int k = 0; k < groups; ++k)
+							if (nfa.set[n].test(sample[k]))
+								moved[k].set(nfa.out[n]);
+					}
+					for (int k = 0; k < groups; ++k) {
+						to[k] = 0;
+						if (!moved[k].empty()) {
+							closure(moved[k]);
+							to[k] = add(moved[k]);
+							if (to[k] == 0)
+								return;
+						}
+					}
+					for (unsigned c = 0; c < 256; ++c)
+						next[d][c] = to[group[c]];
+				}
+				good = true;
+			}
+		};
+
+		template<std::size_t States>
+		struct dfa_table {
+			// Marks of skip[] for states without a fast path, for states which loop on a set of bytes
+			// and for those looping exactly on identifier characters or on digits, which take simd_scan
+			static constexpr std::int16_t skip_digit = -4, skip_ident = -3, no_skip = -2, skip_loop = -1;
+			std::array<std::uint8_t, States * 256> next{};
+			std::array<std::int16_t, States> accept{};
+			// The only byte which leaves a self-looping state, such states are skipped with memchr
+			std::array<std::int16_t, States> skip{};
+			template<typename builder_t>
+			constexpr dfa_table(const builder_t &b) noexcept
+			{
+				for (std::size_t s = 0; s < States; ++s) {
+					accept[s] = b.accept[s];
+					int loops = 0, exit = -1;
+					bool ident = true, digit = true;
+					for (unsigned c = 0; c < 256; ++c) {
+						next[s * 256 + c] = b.next[s][c];
+						bool is_digit = c >= '0' && c <= '9';
+						bool is_ident = is_digit || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+						if (b.next[s][c] == s)
+							++loops;
+						else
+							exit = c;
+						ident = ident && (b.next[s][c] == s) == is_ident;
+						digit = digit && (b.next[s][c] == s) == is_digit;
+					}
+					if (s < 2 || loops == 0)
+						skip[s] = no_skip;
+					else if (loops == 255)
+						skip[s] = exit;
+					else
+						skip[s] = ident ? skip_ident : digit ? skip_digit : skip_loop;
+				}
+			}
+		};
+	}
+
+	/*
+	 * Longest-match scanner over a transition table computed at compile time from Lang::rules,
+	 * ties go to the rule listed first. Lang may set max_nfa and max_dfa to raise the capacities.
+	 */
+	template<typename Lang, std::size_t MaxNfa = 512, std::size_t MaxDfa = 128>
+	class static_scanner final {
+		static constexpr static_detail::dfa_builder<MaxNfa, MaxDfa> builder{Lang::rules};
+		static_assert(builder.good, "static_scanner: unsupported regular expression or capacity exceeded");
+	public:
+		static constexpr std::size_t state_count = builder.count;
+		static constexpr static_detail::dfa_table<state_count> table{builder};
+		/*
+		 * Longest token at p, rule is the index in Lang::rules.
+		 * Returns p with rule = -1 if no rule matches at all.
+		 */
+		static const char *match(const char *p, const char *end, int &rule) noexcept
+		{
+			const std::uint8_t *next = table.next.data();
+			const char *last = p;
+			unsigned s = 1;
+			rule = -1;
+			while (p != end) {
+				s = next[s * 256 + static_cast<unsigned char>(*p)];
+				if (s == 0)
+					break;
+				++p;
+				// Runs inside one state no longer depend on the previous transition
+				int skip = table.skip[s];
+				if (skip >= 0) {
+					const void *q = std::memchr(p, skip, end - p);
+					p = q == nullptr ? end : static_cast<const char *>(q);
+				}
+				else if (skip == table.skip_ident)
+					p = cov::skip_ident(p, end);
+				else if (skip == table.skip_digit)
+					p = cov::skip_digit(p, end);
+				else if (skip == table.skip_loop) {
+					const std::uint8_t *row = next + s * 256;
+					auto stay = [&](std::size_t k) {
+						return row[static_cast<unsigned char>(p[k])] == s;
+					};
+					while (end - p >= 4 && stay(0) && stay(1) && stay(2) && stay(3))
+						p += 4;
+					while (p != end && stay(0))
+						++p;
+				}
+				if (table.accept[s] >= 0) {
+					rule = table.accept[s];
+					last = p;
+				}
+			}
+			return last;
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <array>
+
+namespace cov {
+	/*
+	 * Perfect hash map over a fixed set of short strings, built at compile time.
+	 * Keys are hashed by length, first and last character only, a multiplier is searched
+	 * until every key lands in its own slot. A lookup costs one multiplication and one compare.
+	 */
+	template<typename T, std::size_t N, std::size_t Bits = 6>
+	class perfect_map final {
+	public:
+		using entry_type = std::pair<std::string_view, T>;
+		static constexpr std::size_t table_size = std::size_t(1) << Bits;
+	private:
+		std::array<std::string_view, table_size> _keys{};
+		std::array<T, table_size> _values{};
+		std::uint32_t _seed = 0;
+		T _default{};
+		static constexpr std::uint32_t mix(std::string_view key) noexcept
+		{
+			return static_cast<std::uint32_t>(key.size()) * 0x9e3779b1u
+			       ^ static_cast<unsigned char>(key.front()) * 0x85ebca6bu
+			       ^ static_cast<unsigned char>(key.back()) * 0xc2b2ae35u;
+		}
+		static constexpr std::size_t slot(std::string_view key, std::uint32_t seed) noexcept
+		{
+			return (mix(key) * seed) >> (32 - Bits);
+		}
+	public:
+		constexpr perfect_map(const entry_type (&entries)[N], T def) : _default(def)
+		{
+			static_assert(N * 2 <= table_size, "perfect_map: table too small");
+			for (std::uint32_t seed = 1; seed < (1u << 20); seed += 2) {
+				bool used[table_size] = {};
+				bool ok = true;
+				for (std::size_t i = 0; ok && i < N; ++i) {
+					std::size_t s = slot(entries[i].first, seed);
+					ok = !used[s];
+					used[s] = true;
+				}
+				if (ok) {
+					_seed = seed;
+					break;
+				}
+			}
+			for (std::size_t i = 0; i < N; ++i) {
+				std::size_t s = slot(entries[i].first, _seed);
+				_keys[s] = entries[i].first;
+				_values[s] = entries[i].second;
+			}
+		}
+		constexpr T find(std::string_view key) const noexcept
+		{
+			if (key.empty())
+				return _default;
+			std::size_t s = slot(key, _seed);
+			return _keys[s] == key ? _values[s] : _default;
+		}
+		constexpr bool valid() const noexcept
+		{
+			return _seed != 0;
+		}
+	};
+
+	template<typename T, std::size_t N>
+	constexpr perfect_map<T, N> make_perfect_map(const std::pair<std::string_view, T> (&entries)[N], T def)
+	{
+		return perfect_map<T, N>(entries, def);
+	}
+
+	// Character classes in the "C" locale
+	enum char_class : unsigned char {
+		cc_blank = 0b00001, // std::isspace or '\0'
+		cc_digit = 0b00010, // std::isdigit
+		cc_ident = 0b00100, // std::isalnum or '_'
+		cc_signal = 0b01000 // Language specific operator characters
+	};
+
+	using char_table = std::array<unsigned char, 256>;
+
+	constexpr char_table make_char_table(std::string_view signals)
+	{
+		char_table t{};
+		for (char c : {' ', '\t', '\n', '\v', '\f', '\r', '\0'})
+			t[static_cast<unsigned char>(c)] |= cc_blank;
+		for (unsigned c = '0'; c <= '9'; ++c)
+			t[c] |= cc_digit | cc_ident;
+		for (unsigned c = 'a'; c <= 'z'; ++c)
+			t[c] |= cc_ident;
+		for (unsigned c = 'A'; c <= 'Z'; ++c)
+			t[c] |= cc_ident;
+		t['_'] |= cc_ident;
+		for (char c : signals)
+			t[static_cast<unsigned char>(c)] |= cc_signal;
+		return t;
+	}
+}
\ No newline at end of file
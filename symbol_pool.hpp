@@ -0,0 +1,112 @@
+#pragma once
+
+#include "arena.hpp"
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace cov {
+	// FNV-1a, good enough for short identifiers
+	inline std::uint32_t hash_symbol(std::string_view str) noexcept
+	{
+		std::uint32_t h = 2166136261u;
+		for (unsigned char c : str) {
+			h ^= c;
+			h *= 16777619u;
+		}
+		// The low bits of FNV-1a barely depend on the last characters, but they select the slot
+		h ^= h >> 15;
+		h *= 0x2c1b3c6du;
+		h ^= h >> 12;
+		return h;
+	}
+
+	/*
+	 * String interner: every distinct string gets a dense 32-bit id in order of first appearance.
+	 * The text of each symbol is stored once in an arena, lookups use open addressing without per-entry allocations.
+	 */
+	class symbol_pool final {
+		arena _text;
+		std::vector<std::string_view> _symbols;
+		std::vector<std::uint32_t> _hashes;
+		// id + 1 of the symbol in each slot, 0 for an empty slot
+		std::vector<std::uint32_t> _slots;
+		std::size_t _mask = 0;
+		void rehash(std::size_t size)
+		{
+			_slots.assign(size, 0);
+			_mask = size - 1;
+			for (std::uint32_t id = 0; id < _symbols.size(); ++id) {
+				std::size_t i = _hashes[id] & _mask;
+				while (_slots[i] != 0)
+					i = (i + 1) & _mask;
+				_slots[i] = id + 1;
+			}
+		}
+	public:
+		static constexpr std::uint32_t npos = 0xffffffffu;
+		symbol_pool() : _text(16 * 1024) {}
+		symbol_pool(const symbol_pool &) = delete;
+		symbol_pool(symbol_pool &&) noexcept = default;
+		symbol_pool &operator=(const symbol_pool &) = delete;
+		symbol_pool &operator=(symbol_pool &&) noexcept = default;
+		std::uint32_t find(std::string_view str) const noexcept
+		{
+			if (_slots.empty())
+				return npos;
+			std::uint32_t h = hash_symbol(str);
+			for (std::size_t i = h & _mask; _slots[i] != 0; i = (i + 1) & _mask) {
+				std::uint32_t id = _slots[i] - 1;
+				if (_hashes[id] == h && _symbols[id] == str)
+					return id;
+			}
+			return npos;
+		}
+		std::uint32_t intern(std::string_view str)
+		{
+			// Keep the load factor at or below 1/2
+			if ((_symbols.size() + 1) * 2 > _slots.size())
+				rehash(_slots.empty() ? 256 : _slots.size() * 2);
+			std::uint32_t h = hash_symbol(str);
+			std::size_t i = h & _mask;
+			for (; _slots[i] != 0; i = (i + 1) & _mask) {
+				std::uint32_t id = _slots[i] - 1;
+				if (_hashes[id] == h && _symbols[id] == str)
+					return id;
+			}
+			auto id = static_cast<std::uint32_t>(_symbols.size());
+			_symbols.push_back(_text.store(str));
+			_hashes.push_back(h);
+			_slots[i] = id + 1;
+			return id;
+		}
+		// Make room for n symbols in total without rehashing
+		void reserve(std::size_t n)
+		{
+			std::size_t size = 256;
+			while (size < n * 2)
+				size *= 2;
+			if (size > _slots.size())
+				rehash(size);
+			_symbols.reserve(n);
+			_hashes.reserve(n);
+		}
+		inline std::string_view get(std::uint32_t id) const noexcept
+		{
+			return _symbols[id];
+		}
+		inline std::size_t size() const noexcept
+		{
+			return _symbols.size();
+		}
+		// Drop all symbols but keep the memory for the next compilation
+		void clear() noexcept
+		{
+			_symbols.clear();
+			_hashes.clear();
+			_text.reset();
+			std::fill(_slots.begin(), _slots.end(), 0);
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#include "tiny.hpp"
+#include "tiny_parser.hpp"
+#include "parse_driver.hpp"
+
+int main(int argc, const char *argv[])
+{
+	return cov::parse_main<tcc::lexer, tcc::parser>({"tinyparse", ".tny"}, argc, argv);
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "tiny.hpp"
+#include "tiny_parser.hpp"
+#include "tiny_vm.hpp"
+#include "tiny_jit.hpp"
+#include "corpus_gen.hpp"
+#include "parse_driver.hpp"
+#include <iterator>
+#include <fstream>
+
+/*
+ * Runs a TINY program on the bytecode virtual machine, read statements take integers from the input file or stdin.
+ * With -j the program is translated to machine code where the platform allows it.
+ * With -b the program runs repeatedly on the virtual machine, the JIT and the syntax tree walker instead, all of
+ * them have to give the same output, and the fastest run of each is reported.
+ * With -g the JIT is checked against the virtual machine on generated programs.
+ */
+
+// Programs which do not parse or run longer than the step limit on the virtual machine are skipped
+static int check_jit(std::size_t count)
+{
+	std::size_t checked = 0, invalid = 0, skipped = 0, failed = 0;
+	for (std::uint32_t seed = 1; seed <= count; ++seed) {
+		std::string src = cov::tiny_corpus(cov::corpus_shapes[seed % std::size(cov::corpus_shapes)], seed).generate(2048);
+		std::string input;
+		std::mt19937 rng(seed);
+		for (int i = 0; i < 64; ++i)
+			input += std::to_string(static_cast<int>(rng() % 2001) - 1000) + ' ';
+		tcc::lexer lex;
+		tcc::parser parser;
+		lex.lex(src);
+		// Random identifiers may turn out to be keywords
+		if (!parser.parse(lex) || !lex.get_errors().empty()) {
+			++invalid;
+			continue;
+		}
+		tcc::compiler compiler;
+		const tcc::program &prog = compiler.compile(parser.get_root(), lex.get_symbols().size());
+		tcc::vm vm;
+		tcc::io_buffer io(input);
+		vm.set_limit(1000000);
+		tcc::run_status vm_status = vm.run(prog, io, true);
+		if (vm_status == tcc::run_status::step_limit) {
+			++skipped;
+			continue;
+		}
+		std::string vm_output = io.get_output();
+		io.rewind();
+		tcc::jit jit;
+		if (!jit.compile(prog)) {
+			std::cout << "JIT unavailable on this platform" << std::endl;
+			return -1;
+		}
+		tcc::run_status jit_status = jit.run(io);
+		if (jit_status != vm_status || io.get_output() != vm_output || jit.get_registers() != vm.get_registers()) {
+			std::cout << "JIT differs from the VM on generated program " << seed << std::endl;
+			++failed;
+		}
+		++checked;
+	}
+	std::cout << count << " programs, " << checked << " checked, " << invalid << " invalid, " << skipped << " over the step limit, " << failed << " failed" << std::endl;
+	return failed == 0 ? 0 : -1;
+}
+
+int main(int argc, const char *argv[])
+{
+	bool dump = false, native = false, bench = false, usage = false;
+	std::size_t repeat = 1, generate = 0;
+	std::string path, input_path;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg(argv[i]);
+		if (arg == "-d")
+			dump = true;
+		else if (arg == "-j")
+			native = true;
+		else if (arg == "-b")
+			bench = true;
+		else if (arg == "-g" && i + 1 < argc)
+			generate = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "-n" && i + 1 < argc)
+			repeat = std::max<std::size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+		else if (arg == "-i" && i + 1 < argc)
+			input_path = argv[++i];
+		else if ((arg.size() > 1 && arg[0] == '-') || !path.empty())
+			usage = true;
+		else
+			path = arg;
+	}
+	// Checking CLI input
+	if (generate > 0 && !usage && path.empty())
+		return check_jit(generate);
+	if (usage || path.empty()) {
+		std::cout << "Usage: tinyrun [-d] [-j] [-b] [-n <REPEAT>] [-i <INPUT>] <PROGRAM>.tny" << std::endl;
+		std::cout << "       tinyrun -g <COUNT>" << std::endl;
+		return -1;
+	}
+	tcc::lexer lex;
+	if (!lex.lex_file(path)) {
+		std::cout << "Cannot open input file: " << path << std::endl;
+		return -1;
+	}
+	tcc::parser parser;
+	if (!parser.parse(lex) || !lex.get_errors().empty()) {
+		cov::print_errors(std::cout, lex, parser);
+		return -1;
+	}
+	tcc::compiler compiler;
+	const tcc::program &prog = compiler.compile(parser.get_root(), lex.get_symbols().size());
+	if (dump)
+		tcc::print_program(std::cout, prog, lex.get_symbols());
+	std::string input;
+	// A benchmark reruns the program on the same input, which is then read up front
+	if (input_path.empty() && bench)
+		input.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+	else if (!input_path.empty()) {
+		std::ifstream ifs(input_path, std::ios::binary);
+		if (!ifs) {
+			std::cout << "Cannot open input file: " << input_path << std::endl;
+			return -1;
+		}
+		input.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	}
+	tcc::vm vm;
+	tcc::jit jit;
+	if (!bench) {
+		// Stdin is only read once the program reads
+		tcc::io_buffer io = input_path.empty() ? tcc::io_buffer(stdin, stdout) : tcc::io_buffer(input, stdout);
+		tcc::run_status status;
+		if (native) {
+			jit.compile(prog);
+			status = jit.run(io);
+		}
+		else
+			status = vm.run(prog, io);
+		io.flush();
+		if (status != tcc::run_status::ok) {
+			std::cout << "Runtime Error: " << tcc::get_run_error(status) << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+	tcc::io_buffer io(input);
+	tcc::run_status vm_status = vm.run(prog, io, true);
+	std::string vm_output = io.get_output();
+	std::uint64_t steps = vm.get_steps();
+	bool same = true;
+	double vm_time = cov::best_time(repeat, [&] {
+		io.rewind();
+		vm.run(prog, io);
+	});
+	double jit_time = 0;
+	if (jit.compile(prog)) {
+		io.rewind();
+		tcc::run_status jit_status = jit.run(io);
+		same = jit_status == vm_status && io.get_output() == vm_output;
+		jit_time = cov::best_time(repeat, [&] {
+			io.rewind();
+			jit.run(io);
+		});
+	}
+	tcc::tree_walker walker;
+	io.rewind();
+	tcc::run_status walker_status = walker.run(parser.get_root(), lex.get_symbols().size(), io);
+	same = same && walker_status == vm_status && io.get_output() == vm_output;
+	double walker_time = cov::best_time(repeat, [&] {
+		io.rewind();
+		walker.run(parser.get_root(), lex.get_symbols().size(), io);
+	});
+	io.rewind();
+	std::cout << prog.code.size() << " instructions, " << prog.registers.size() << " registers, " << steps << " steps" << std::endl;
+	std::cout << "VM Time: " << vm_time * 1e3 << " ms, " << steps / vm_time / 1e6 << " M steps/s" << std::endl;
+	if (jit.is_native())
+		std::cout << "JIT Time: " << jit_time * 1e3 << " ms, " << vm_time / jit_time << " times as fast as the VM" << std::endl;
+	else
+		std::cout << "JIT unavailable on this platform" << std::endl;
+	std::cout << "Tree Walker Time: " << walker_time * 1e3 << " ms, " << walker_time / vm_time << " times the VM" << std::endl;
+	if (vm_status != tcc::run_status::ok)
+		std::cout << "Runtime Error: " << tcc::get_run_error(vm_status) << std::endl;
+	if (!same) {
+		std::cout << "Output of the VM differs from the JIT or the tree walker" << std::endl;
+		return -1;
+	}
+	return vm_status == tcc::run_status::ok ? 0 : -1;
+}
\ No newline at end of file
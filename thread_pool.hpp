@@ -0,0 +1,125 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace cov {
+	/*
+	 * Fixed set of worker threads running batches of indexed jobs.
+	 * Each worker is dealt a contiguous share of the indices and takes them from the front,
+	 * a worker which runs dry steals from the back of the other shares.
+	 */
+	class thread_pool final {
+		struct worker_queue {
+			std::mutex lock;
+			std::deque<std::size_t> jobs;
+		};
+		std::size_t _size;
+		std::unique_ptr<worker_queue[]> _queues;
+		std::vector<std::thread> _threads;
+		std::mutex _lock;
+		std::condition_variable _wake, _done;
+		const std::function<void(std::size_t, std::size_t)> *_job = nullptr;
+		std::size_t _generation = 0, _busy = 0;
+		bool _stop = false;
+		bool next(std::size_t worker, std::size_t &index)
+		{
+			{
+				worker_queue &q = _queues[worker];
+				std::lock_guard<std::mutex> guard(q.lock);
+				if (!q.jobs.empty()) {
+					index = q.jobs.front();
+					q.jobs.pop_front();
+					return true;
+				}
+			}
+			for (std::size_t i = 1; i < _size; ++i) {
+				worker_queue &q = _queues[(worker + i) % _size];
+				std::lock_guard<std::mutex> guard(q.lock);
+				if (!q.jobs.empty()) {
+					index = q.jobs.back();
+					q.jobs.pop_back();
+					return true;
+				}
+			}
+			return false;
+		}
+		void drain(std::size_t worker)
+		{
+			std::size_t index;
+			while (next(worker, index))
+				(*_job)(worker, index);
+		}
+		void work(std::size_t worker)
+		{
+			std::size_t seen = 0;
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> guard(_lock);
+					_wake.wait(guard, [&] { return _stop || _generation != seen; });
+					if (_stop)
+						return;
+					seen = _generation;
+				}
+				drain(worker);
+				std::lock_guard<std::mutex> guard(_lock);
+				if (--_busy == 0)
+					_done.notify_one();
+			}
+		}
+	public:
+		// The calling thread of parallel_for() counts as worker 0
+		explicit thread_pool(std::size_t workers = std::thread::hardware_concurrency()) : _size(workers > 0 ? workers : 1), _queues(new worker_queue[_size])
+		{
+			for (std::size_t i = 1; i < _size; ++i)
+				_threads.emplace_back(&thread_pool::work, this, i);
+		}
+		thread_pool(const thread_pool &) = delete;
+		thread_pool &operator=(const thread_pool &) = delete;
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (auto &t : _threads)
+				t.join();
+		}
+		inline std::size_t size() const noexcept
+		{
+			return _size;
+		}
+		/*
+		 * Call fn(worker, index) for every index in [0, n) and wait for all of them.
+		 * fn must not throw, calls with the same worker id never overlap.
+		 */
+		template<typename F>
+		void parallel_for(std::size_t n, F &&fn)
+		{
+			const std::function<void(std::size_t, std::size_t)> job(std::forward<F>(fn));
+			for (std::size_t w = 0; w < _size; ++w) {
+				std::lock_guard<std::mutex> guard(_queues[w].lock);
+				for (std::size_t i = n * w / _size; i < n * (w + 1) / _size; ++i)
+					_queues[w].jobs.push_back(i);
+			}
+			{
+				std::lock_guard<std::mutex> guard(_lock);
+				_job = &job;
+				_busy = _size - 1;
+				++_generation;
+			}
+			_wake.notify_all();
+			drain(0);
+			std::unique_lock<std::mutex> guard(_lock);
+			_done.wait(guard, [this] { return _busy == 0; });
+			_job = nullptr;
+		}
+	};
+}
\ No newline at end of file
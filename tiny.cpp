@@ -1,12 +1,14 @@
 #include "tiny.hpp"
+#include "static_tables.hpp"
+#include "simd_scan.hpp"
+#include <algorithm>
+#include <iterator>
 #include <unordered_map>
-#include <unordered_set>
-#include <cctype>
 
 namespace tcc {
 	template<typename _kT, typename _vT> using map_t = std::unordered_map<_kT, _vT>;
 
-	map_t<std::string, action_type> action_map = {
+	constexpr auto action_map = cov::make_perfect_map<action_type>({
 		{"if", action_type::_if},
 		{"then", action_type::_then},
 		{"else", action_type::_else},
@@ -15,9 +17,9 @@ namespace tcc {
 		{"end", action_type::_end},
 		{"read", action_type::_read},
 		{"write", action_type::_write}
-	};
+	}, action_type::_null);
 
-	map_t<std::string, signal_type> signal_map = {
+	constexpr auto signal_map = cov::make_perfect_map<signal_type>({
 		{"+", signal_type::_add},
 		{"-", signal_type::_sub},
 		{"*", signal_type::_mul},
@@ -28,37 +30,90 @@ namespace tcc {
 		{")", signal_type::_rbr},
 		{";", signal_type::_sem},
 		{":", signal_type::_expect},
-		{":=", signal_type::_asi},
-	};
+		{":=", signal_type::_asi}
+	}, signal_type::_null);
 
-	action_type get_action(const std::string &token)
+	static_assert(action_map.valid() && signal_map.valid(), "No perfect hash for the reserved words or signals");
+
+	action_type get_action(std::string_view token)
 	{
-		if (action_map.count(token) > 0)
-			return action_map.at(token);
-		else
-			return action_type::_null;
+		return action_map.find(token);
 	}
 
-	signal_type get_signal(const std::string &token)
+	signal_type get_signal(std::string_view token)
 	{
-		if (signal_map.count(token) > 0)
-			return signal_map.at(token);
-		else
-			return signal_type::_null;
+		return signal_map.find(token);
+	}
+
+	constexpr cov::char_table char_class = cov::make_char_table("+-*/=<();:");
+
+	inline bool is_blank(char c)
+	{
+		return char_class[static_cast<unsigned char>(c)] & cov::cc_blank;
+	}
+
+	inline bool is_digit(char c)
+	{
+		return char_class[static_cast<unsigned char>(c)] & cov::cc_digit;
+	}
+
+	inline bool is_signal(char c)
+	{
+		return char_class[static_cast<unsigned char>(c)] & cov::cc_signal;
+	}
+
+	inline bool is_identifer(char c)
+	{
+		return char_class[static_cast<unsigned char>(c)] & cov::cc_ident;
 	}
 
-	std::unordered_set<char> signal_set = {
-		'+', '-', '*', '/', '=', '<', '(', ')', ';', ':'
+	// Texts of the listing indexed by action_type and signal_type
+	constexpr std::string_view action_label[] = {
+		"",
+		"reserved word: if",
+		"reserved word: then",
+		"reserved word: else",
+		"reserved word: repeat",
+		"reserved word: until",
+		"reserved word: end",
+		"reserved word: read",
+		"reserved word: write"
+	};
+
+	constexpr std::string_view signal_label[] = {
+		"", "", "+", "-", "*", "/", "=", "<", "(", ")", ";", ":="
 	};
 
-	bool is_signal(char c)
+	static_assert(std::size(action_label) == static_cast<std::size_t>(action_type::_write) + 1 && std::size(signal_label) == static_cast<std::size_t>(signal_type::_asi) + 1, "Label tables out of sync with the token enums");
+
+	template<std::size_t N>
+	inline std::string_view label_at(const std::string_view (&table)[N], unsigned char i)
+	{
+		return i < N ? table[i] : std::string_view();
+	}
+
+	std::string_view token_view::get_label() const noexcept
 	{
-		return signal_set.count(c) > 0;
+		switch (get_type()) {
+		case token_type::_action:
+			return label_at(action_label, _tok->subtype);
+		case token_type::_signal:
+			return label_at(signal_label, _tok->subtype);
+		case token_type::_literal:
+			return "NUM, val = ";
+		case token_type::_identifier:
+			return "ID, name = ";
+		default:
+			return std::string_view();
+		}
 	}
 
-	bool is_identifer(char c)
+	std::string token_view::to_string() const
 	{
-		return std::isalnum(c) || c == '_';
+		std::string str(get_label());
+		if (has_symbol())
+			str.append(_sym->get(_tok->symbol));
+		return str;
 	}
 
 	map_t<lexer::state, std::string> error_map = {
@@ -67,32 +122,29 @@ namespace tcc {
 		{lexer::state::unexpected_signal, "未知符号"}
 	};
 
-	const char *lexer::get_error() const noexcept
+	const char *lexer::get_error(state s) noexcept
 	{
-		if (error_map.count(_s) > 0)
-			return error_map.at(_s).c_str();
+		if (error_map.count(s) > 0)
+			return error_map.at(s).c_str();
 		else
 			return "无错误";
 	}
 
 	lexer::state lexer::read_next(char c, bool next)
 	{
-		if (next)
-			++pos;
+		if (next) {
+			++offset;
+			feed += c;
+			source = feed;
+			lines.extend(feed);
+		}
 		switch (_s) {
 		case state::ready: {
-			if (c == '\0')
-				return _s;
-			else if (c == '\n') {
-				++line;
-				pos = 0;
-				return _s;
-			}
-			else if (std::isspace(c))
+			if (c == '\0' || is_blank(c))
 				return _s;
 			else if (c == '{')
 				return _s = state::incom;
-			else if (std::isdigit(c)) {
+			else if (is_digit(c)) {
 				buffer += c;
 				return _s = state::inlit;
 			}
@@ -109,12 +161,7 @@ namespace tcc {
 			return _s = state::unexpected_character;
 		}
 		case state::incom: {
-			if (c == '\n') {
-				++line;
-				pos = 0;
-				return _s;
-			}
-			else if (c == '}')
+			if (c == '}')
 				return _s = state::ready;
 			else
 				return _s;
@@ -128,7 +175,7 @@ namespace tcc {
 					return _s = state::incomplete_signal;
 				else if (sig == signal_type::_null)
 					return _s = state::unexpected_signal;
-				results.emplace_back(new token_signal(sig, line, pos - 1));
+				push(token_type::_signal, static_cast<unsigned char>(sig), offset - 1 - last_buffer.size(), last_buffer.size());
 				return _s = state::output;
 			}
 			else {
@@ -137,8 +184,8 @@ namespace tcc {
 			}
 		}
 		case state::inlit: {
-			if (!std::isdigit(c)) {
-				results.emplace_back(new token_literal(literal_type::_number, buffer, line, pos - 1));
+			if (!is_digit(c)) {
+				push(token_type::_literal, static_cast<unsigned char>(literal_type::_number), offset - 1 - buffer.size(), buffer.size(), symbols.intern(buffer));
 				last_buffer = buffer;
 				buffer.clear();
 				return _s = state::output;
@@ -152,9 +199,9 @@ namespace tcc {
 			if (!is_identifer(c)) {
 				auto act = get_action(buffer);
 				if (act == action_type::_null)
-					results.emplace_back(new token_identifier(buffer, line, pos - 1));
+					push(token_type::_identifier, 0, offset - 1 - buffer.size(), buffer.size(), symbols.intern(buffer));
 				else
-					results.emplace_back(new token_action(act, line, pos - 1));
+					push(token_type::_action, static_cast<unsigned char>(act), offset - 1 - buffer.size(), buffer.size());
 				last_buffer = buffer;
 				buffer.clear();
 				return _s = state::output;
@@ -166,4 +213,434 @@ namespace tcc {
 		}
 		}
 	}
+
+	void lexer::push(token_type type, unsigned char subtype, std::size_t off, std::size_t len, std::uint32_t sym)
+	{
+		results.push_back({type, subtype, sym, static_cast<std::uint32_t>(off), static_cast<std::uint32_t>(len)});
+	}
+
+	// The position is filled in by locate_errors() once lexing stops
+	void lexer::error(state s, std::string text, std::size_t off)
+	{
+		errors.push_back({s, std::move(text), 0, 0, off, results.size()});
+	}
+
+	// The offending character is reported at its own column counting from 1
+	void lexer::locate_errors()
+	{
+		for (auto &e : errors) {
+			lines.locate(e.offset, e.line, e.pos);
+			++e.pos;
+		}
+	}
+
+	bool lexer::flush(std::size_t end)
+	{
+		std::string_view text = source.substr(start, end - start);
+		switch (_s) {
+		case state::insig: {
+			auto sig = get_signal(text);
+			if (sig == signal_type::_expect || sig == signal_type::_null) {
+				// Same as read_next: the terminating character is consumed by the error
+				error(sig == signal_type::_expect ? state::incomplete_signal : state::unexpected_signal, std::string(text), end);
+				_s = state::ready;
+				return true;
+			}
+			push(token_type::_signal, static_cast<unsigned char>(sig), start, text.size());
+			break;
+		}
+		case state::inlit:
+			push(token_type::_literal, static_cast<unsigned char>(literal_type::_number), start, text.size(), symbols.intern(text));
+			break;
+		case state::inidn: {
+			auto act = get_action(text);
+			if (act == action_type::_null)
+				push(token_type::_identifier, 0, start, text.size(), symbols.intern(text));
+			else
+				push(token_type::_action, static_cast<unsigned char>(act), start, text.size());
+			break;
+		}
+		default:
+			break;
+		}
+		_s = state::ready;
+		return false;
+	}
+
+	void lexer::run(std::size_t first, std::size_t last)
+	{
+		const char *base = source.data(), *p = base + first, *end = base + last;
+		while (p != end) {
+			switch (_s) {
+			default: {
+				while (p != end && _s == state::ready) {
+					if (is_blank(*p)) {
+						p = cov::skip_blank(p, end);
+						continue;
+					}
+					char c = *p++;
+					if (c == '{')
+						_s = state::incom;
+					else if (is_digit(c)) {
+						start = p - 1 - base;
+						_s = state::inlit;
+					}
+					else if (is_signal(c)) {
+						start = p - 1 - base;
+						_s = state::insig;
+					}
+					else if (is_identifer(c)) {
+						start = p - 1 - base;
+						_s = state::inidn;
+					}
+					else
+						error(state::unexpected_character, std::string(1, c), p - 1 - base);
+				}
+				break;
+			}
+			case state::incom: {
+				p = cov::find_char(p, end, '}');
+				if (p != end) {
+					++p;
+					_s = state::ready;
+				}
+				break;
+			}
+			case state::insig: {
+				while (p != end && is_signal(*p))
+					++p;
+				if (p != end && flush(p - base))
+					++p;
+				break;
+			}
+			case state::inlit: {
+				p = cov::skip_digit(p, end);
+				if (p != end)
+					flush(p - base);
+				break;
+			}
+			case state::inidn: {
+				p = cov::skip_ident(p, end);
+				if (p != end)
+					flush(p - base);
+				break;
+			}
+			}
+		}
+	}
+
+	void lexer::finish()
+	{
+		// The end of input terminates a pending token like a trailing newline does
+		if (_s == state::insig || _s == state::inlit || _s == state::inidn)
+			flush(source.size());
+		offset = source.size();
+	}
+
+	void lexer::reset(std::string_view src)
+	{
+		clear_output();
+		buffer.clear();
+		last_buffer.clear();
+		feed.clear();
+		symbols.clear();
+		offset = 0;
+		_s = state::ready;
+		source = src;
+		lines.reset(src);
+		stream = nullptr;
+		cursor = 0;
+		base = 0;
+	}
+
+	void lexer::lex(std::string_view src)
+	{
+		reset(src);
+		// One token per eight bytes is a cheap lower estimate for real programs
+		results.reserve(src.size() / 8);
+		run(0, source.size());
+		finish();
+		locate_errors();
+	}
+
+	void lexer::lex_begin(std::string_view src)
+	{
+		reset(src);
+		results.reserve(src.size() / 8);
+	}
+
+	bool lexer::lex_more(std::size_t bytes)
+	{
+		// offset marks the end of the part lexed so far
+		std::size_t last = std::min(source.size(), offset + std::max<std::size_t>(bytes, 1));
+		run(offset, last);
+		offset = last;
+		if (last < source.size())
+			return true;
+		finish();
+		locate_errors();
+		return false;
+	}
+
+	void lexer::lex(std::string_view src, cov::thread_pool &pool, std::size_t chunk_size)
+	{
+		if (chunk_size == 0)
+			chunk_size = std::max<std::size_t>(64 * 1024, src.size() / (pool.size() * 4));
+		// Chunks end right after a newline, where the sequential lexer can only be ready or inside a comment
+		std::vector<std::size_t> bounds{0};
+		for (std::size_t b = chunk_size; b < src.size(); b = bounds.back() + chunk_size) {
+			b = src.find('\n', b);
+			if (b == std::string_view::npos || b + 1 == src.size())
+				break;
+			bounds.push_back(b + 1);
+		}
+		bounds.push_back(src.size());
+		std::size_t chunks = bounds.size() - 1;
+		if (pool.size() < 2 || chunks < 2) {
+			lex(src);
+			return;
+		}
+		// Run 2k lexes chunk k from the ready state, run 2k + 1 from inside a comment
+		std::vector<lexer> runs(chunks * 2);
+		pool.parallel_for(chunks * 2 - 1, [&](std::size_t, std::size_t job) {
+			std::size_t id = job == 0 ? 0 : job + 1, k = id / 2;
+			lexer &r = runs[id];
+			r.reset(src);
+			r._s = id % 2 == 0 ? state::ready : state::incom;
+			r.run(bounds[k], bounds[k + 1]);
+			if (k + 1 == chunks)
+				r.finish();
+		});
+		// Follow the actual entry state from chunk to chunk and rebase the speculative results
+		reset(src);
+		std::vector<std::uint32_t> ids;
+		for (std::size_t k = 0; k < chunks; ++k) {
+			lexer &r = runs[k * 2 + (_s == state::incom ? 1 : 0)];
+			ids.resize(r.symbols.size());
+			for (std::size_t i = 0; i < ids.size(); ++i)
+				ids[i] = symbols.intern(r.symbols.get(i));
+			std::size_t index = results.size();
+			for (token t : r.results) {
+				if (t.type == token_type::_literal || t.type == token_type::_identifier)
+					t.symbol = ids[t.symbol];
+				results.push_back(t);
+			}
+			for (auto &e : r.errors) {
+				e.index += index;
+				errors.push_back(std::move(e));
+			}
+			_s = r._s;
+		}
+		offset = source.size();
+		locate_errors();
+	}
+
+	bool lexer::lex_file(const std::string &path)
+	{
+		if (!file.open(path))
+			return false;
+		lex(file.view());
+		return true;
+	}
+
+	bool lexer::lex_file(const std::string &path, cov::thread_pool &pool)
+	{
+		if (!file.open(path))
+			return false;
+		lex(file.view(), pool);
+		return true;
+	}
+
+	// Revision of the lexing rules, bump it whenever the same input would produce different results
+	constexpr const char *cache_language = "tcc/2";
+
+	bool lexer::lex_cached(const std::string &path)
+	{
+		if (!file.open(path))
+			return false;
+		std::string cache_path = path + ".tkc";
+		reset(file.view());
+		auto has_symbol = [](const token &t) {
+			return t.type == token_type::_literal || t.type == token_type::_identifier;
+		};
+		// A damaged cache whose hash still matches is lexed again like a stale one
+		if (cache.open(cache_path, cache_language, sizeof(token), source) && cache.check_tokens<token>(has_symbol)) {
+			auto &head = cache.header();
+			cached = cache.tokens<token>();
+			symbols.reserve(head.symbol_count);
+			for (std::uint32_t i = 0; i < head.symbol_count; ++i)
+				symbols.intern(cache.symbol(i));
+			bool intact = cache.for_each_error([this](std::uint32_t type, std::uint32_t l, std::uint32_t p, std::uint32_t off, std::uint32_t index, std::string_view text) {
+				errors.push_back({static_cast<state>(type), std::string(text), l, p, off, index});
+			});
+			if (intact && symbols.size() == head.symbol_count) {
+				_s = static_cast<state>(head.state);
+				offset = source.size();
+				return true;
+			}
+		}
+		lex(source);
+		cov::write_token_cache(cache_path, cache_language, source, get_results(), errors, symbols, static_cast<std::uint32_t>(_s));
+		return true;
+	}
+
+	lexer::token_change lexer::edit(std::size_t at, std::size_t removed, std::string_view inserted)
+	{
+		if (cache.is_open()) {
+			results.assign(cached.begin(), cached.end());
+			cache.close();
+		}
+		if (source.data() != edited.data())
+			edited.assign(source);
+		at = std::min(at, edited.size());
+		removed = std::min(removed, edited.size() - at);
+		edited.replace(at, removed, inserted);
+		source = edited;
+		std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(inserted.size()) - static_cast<std::ptrdiff_t>(removed);
+		state old_state = _s;
+		// Restart at the last token which began strictly before the edit, its terminator is not touched.
+		// Every TINY token begins in the ready state, signal runs are never split
+		auto before = [](const token &t, std::size_t off) {
+			return t.offset < off;
+		};
+		std::size_t first = std::lower_bound(results.begin(), results.end(), at, before) - results.begin();
+		std::size_t restart = 0;
+		if (first > 0)
+			restart = results[--first].offset;
+		lines.reset(source);
+		_s = state::ready;
+		// Candidates to get back in step with: old tokens behind the edit
+		std::size_t j = std::lower_bound(results.begin() + first, results.end(), at + removed, before) - results.begin();
+		// The old stream stays in place, new tokens and errors are collected aside with indices relative to first
+		std::vector<token> old;
+		std::vector<error_info> old_errors;
+		old.swap(results);
+		old_errors.swap(errors);
+		bool in_step = false;
+		for (std::size_t p = restart;; ++j) {
+			while (j < old.size() && static_cast<std::size_t>(old[j].offset + delta) < p)
+				++j;
+			if (j == old.size()) {
+				// Never back in step, lex to the end
+				run(p, source.size());
+				finish();
+				break;
+			}
+			std::size_t c = old[j].offset + delta;
+			run(p, c);
+			p = c;
+			// Same state at the same character: everything from here on only moves
+			if (_s == state::ready) {
+				in_step = true;
+				break;
+			}
+		}
+		std::size_t inserted_tokens = results.size();
+		// Errors before the restart are kept, errors behind the resync point move with their tokens
+		std::vector<error_info> fresh_errors;
+		fresh_errors.swap(errors);
+		for (auto &e : old_errors) {
+			if (e.offset < restart)
+				errors.push_back(std::move(e));
+		}
+		for (auto &e : fresh_errors) {
+			e.index += first;
+			errors.push_back(std::move(e));
+		}
+		if (in_step) {
+			for (auto &e : old_errors) {
+				if (e.offset >= old[j].offset) {
+					e.offset += delta;
+					e.index = e.index - j + first + inserted_tokens;
+					errors.push_back(std::move(e));
+				}
+			}
+		}
+		else
+			j = old.size();
+		// Splice the new tokens over the old [first, j) with at most one move of the tail
+		std::size_t common = std::min(j - first, inserted_tokens);
+		std::copy(results.begin(), results.begin() + common, old.begin() + first);
+		if (inserted_tokens > common)
+			old.insert(old.begin() + j, results.begin() + common, results.end());
+		else
+			old.erase(old.begin() + first + common, old.begin() + j);
+		results.swap(old);
+		if (in_step) {
+			if (delta != 0) {
+				for (auto it = results.begin() + first + inserted_tokens; it != results.end(); ++it)
+					it->offset = static_cast<std::uint32_t>(it->offset + delta);
+			}
+			_s = old_state;
+			offset = source.size();
+		}
+		// Lines behind the edit moved, the positions of all errors are looked up again
+		locate_errors();
+		return {first, j - first, inserted_tokens};
+	}
+
+	bool lexer::open_stream(const std::string &path, std::size_t size)
+	{
+		stream_file.close();
+		stream_file.clear();
+		stream_file.open(path, std::ios::binary);
+		if (!stream_file)
+			return false;
+		open_stream(stream_file, size);
+		return true;
+	}
+
+	void lexer::open_stream(std::istream &in, std::size_t size)
+	{
+		reset(std::string_view());
+		stream = &in;
+		block_size = std::max<std::size_t>(size, 1);
+		window.clear();
+		window.reserve(block_size);
+		results.reserve(block_size / 8);
+	}
+
+	// Next block of the stream, false once the end of input has been lexed
+	bool lexer::refill()
+	{
+		if (stream == nullptr)
+			return false;
+		results.clear();
+		errors.clear();
+		cursor = 0;
+		// Only the text of a pending token is carried over, the line index of the block continues where it starts
+		std::size_t keep = _s == state::insig || _s == state::inlit || _s == state::inidn ? start : window.size();
+		std::size_t line, column;
+		lines.locate(keep, line, column);
+		window.erase(0, keep);
+		base += keep;
+		start = 0;
+		std::size_t first = window.size();
+		window.resize(first + block_size);
+		stream->read(&window[first], block_size);
+		window.resize(first + stream->gcount());
+		source = window;
+		lines.reset(source, line, column);
+		if (window.size() > first)
+			run(first, window.size());
+		else {
+			finish();
+			if (stream == &stream_file)
+				stream_file.close();
+			stream = nullptr;
+		}
+		locate_errors();
+		return true;
+	}
+
+	const token *lexer::next_token()
+	{
+		for (;;) {
+			cov::span<const token> toks = get_results();
+			if (cursor < toks.size())
+				return &toks[cursor++];
+			if (!refill())
+				return nullptr;
+		}
+	}
 }
\ No newline at end of file
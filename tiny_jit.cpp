@@ -0,0 +1,335 @@
+#include "tiny_jit.hpp"
+#include <initializer_list>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define TCC_JIT_X64
+#include <sys/mman.h>
+#endif
+
+namespace tcc {
+#ifdef TCC_JIT_X64
+	// Entry points of the generated code, results are int as the upper bits of narrower ones are undefined
+	static int jit_read(io_buffer *io, std::int32_t *dst)
+	{
+		return static_cast<int>(read_error(io->read(*dst)));
+	}
+
+	static void jit_write(io_buffer *io, std::int32_t value)
+	{
+		io->write(value);
+	}
+
+	/*
+	 * Machine code of one program. The generated function is int(std::int32_t *frame, io_buffer *io)
+	 * returning a run_status, rbx holds the frame and the io_buffer is kept at [rsp].
+	 */
+	class x64_assembler final {
+	public:
+		static constexpr unsigned eax = 0, ecx = 1, ebx = 3, ebp = 5, esi = 6, r12 = 12, r13 = 13, r14 = 14, r15 = 15, frame = 16;
+		static constexpr unsigned callee_saved[] = {ebp, r12, r13, r14, r15};
+		// Targets of jumps out of the bytecode
+		static constexpr std::size_t epilogue = SIZE_MAX, div_zero = SIZE_MAX - 1;
+		std::vector<unsigned char> buf;
+		// Machine register of every bytecode register, or frame
+		std::vector<unsigned> home;
+		// Start of every instruction and the rel32 fields waiting for their target
+		std::vector<std::size_t> offsets;
+		std::vector<std::pair<std::size_t, std::size_t>> fixups;
+		void byte(unsigned b)
+		{
+			buf.push_back(static_cast<unsigned char>(b));
+		}
+		void bytes(std::initializer_list<unsigned> bs)
+		{
+			for (unsigned b : bs)
+				byte(b);
+		}
+		void dword(std::uint32_t v)
+		{
+			for (int i = 0; i < 32; i += 8)
+				byte(v >> i);
+		}
+		void qword(std::uint64_t v)
+		{
+			for (int i = 0; i < 64; i += 8)
+				byte(v >> i);
+		}
+		// ops reg, rm or ops rm, reg with both in machine registers
+		void direct(std::initializer_list<unsigned> ops, unsigned reg, unsigned rm)
+		{
+			unsigned rex = (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0);
+			if (rex != 0)
+				byte(0x40 | rex);
+			bytes(ops);
+			byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+		}
+		// Same with rm the frame slot [rbx + 4 * vreg]
+		void slot(std::initializer_list<unsigned> ops, unsigned reg, std::uint32_t vreg)
+		{
+			if (reg >= 8)
+				byte(0x44);
+			bytes(ops);
+			byte(0x80 | (reg & 7) << 3 | ebx);
+			dword(vreg * 4);
+		}
+		void operand(std::initializer_list<unsigned> ops, unsigned reg, std::uint32_t vreg)
+		{
+			if (home[vreg] != frame)
+				direct(ops, reg, home[vreg]);
+			else
+				slot(ops, reg, vreg);
+		}
+		void load(unsigned reg, std::uint32_t vreg)
+		{
+			if (home[vreg] != reg)
+				operand({0x8B}, reg, vreg);
+		}
+		void store(std::uint32_t vreg, unsigned reg)
+		{
+			if (home[vreg] != reg)
+				operand({0x89}, reg, vreg);
+		}
+		// Machine register holding vreg, scratch is loaded if it lives in the frame
+		unsigned use(std::uint32_t vreg, unsigned scratch)
+		{
+			if (home[vreg] != frame)
+				return home[vreg];
+			slot({0x8B}, scratch, vreg);
+			return scratch;
+		}
+		void jump(std::initializer_list<unsigned> ops, std::size_t target)
+		{
+			bytes(ops);
+			fixups.emplace_back(buf.size(), target);
+			dword(0);
+		}
+		// mov rax, imm64; call rax
+		void call(const void *func)
+		{
+			bytes({0x48, 0xB8});
+			qword(reinterpret_cast<std::uintptr_t>(func));
+			bytes({0xFF, 0xD0});
+		}
+		void allocate(const program &);
+		bool translate(const instruction &);
+		bool assemble(const program &);
+	};
+
+	constexpr unsigned x64_assembler::callee_saved[];
+
+	// Uses of every register, an instruction inside n loops counts 8^n times
+	void x64_assembler::allocate(const program &prog)
+	{
+		std::size_t n = prog.code.size();
+		std::vector<long> depth(n + 1, 0);
+		for (std::size_t i = 0; i < n; ++i) {
+			const instruction &ins = prog.code[i];
+			if (ins.op >= opcode::_jmp && ins.op <= opcode::_jne && ins.c <= i) {
+				++depth[ins.c];
+				--depth[i + 1];
+			}
+		}
+		std::vector<std::uint64_t> uses(prog.registers.size(), 0);
+		long d = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			d += depth[i];
+			std::uint64_t weight = std::uint64_t(1) << std::min<long>(3 * d, 60);
+			const instruction &ins = prog.code[i];
+			switch (ins.op) {
+			case opcode::_halt:
+			case opcode::_jmp:
+				break;
+			case opcode::_jz:
+			case opcode::_jnz:
+			case opcode::_in:
+			case opcode::_out:
+				uses[ins.a] += weight;
+				break;
+			case opcode::_mov:
+			case opcode::_jlt:
+			case opcode::_jge:
+			case opcode::_jeq:
+			case opcode::_jne:
+				uses[ins.a] += weight;
+				uses[ins.b] += weight;
+				break;
+			default:
+				uses[ins.a] += weight;
+				uses[ins.b] += weight;
+				uses[ins.c] += weight;
+				break;
+			}
+		}
+		std::vector<std::uint32_t> order(uses.size());
+		for (std::uint32_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::size_t count = std::min(order.size(), std::size(callee_saved));
+		std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](std::uint32_t a, std::uint32_t b) {
+			return uses[a] > uses[b];
+		});
+		home.assign(uses.size(), frame);
+		for (std::size_t i = 0; i < count && uses[order[i]] > 0; ++i)
+			home[order[i]] = callee_saved[i];
+	}
+
+	bool x64_assembler::translate(const instruction &ins)
+	{
+		std::uint32_t a = ins.a, b = ins.b, c = ins.c;
+		switch (ins.op) {
+		case opcode::_halt:
+			bytes({0x31, 0xC0});
+			jump({0xE9}, epilogue);
+			return true;
+		case opcode::_mov: {
+			unsigned dst = home[a] != frame ? home[a] : eax;
+			load(dst, b);
+			store(a, dst);
+			return true;
+		}
+		case opcode::_add:
+		case opcode::_sub:
+		case opcode::_mul: {
+			// Straight into the machine register of the result unless that would clobber the right operand
+			unsigned dst = home[a] != frame && a != c ? home[a] : eax;
+			load(dst, b);
+			if (ins.op == opcode::_add)
+				operand({0x03}, dst, c);
+			else if (ins.op == opcode::_sub)
+				operand({0x2B}, dst, c);
+			else
+				operand({0x0F, 0xAF}, dst, c);
+			store(a, dst);
+			return true;
+		}
+		case opcode::_div:
+			// Zero stops the program, -1 negates so that INT32_MIN wraps instead of trapping
+			load(ecx, c);
+			bytes({0x85, 0xC9});
+			jump({0x0F, 0x84}, div_zero);
+			load(eax, b);
+			bytes({0x83, 0xF9, 0xFF, 0x75, 0x04, 0xF7, 0xD8, 0xEB, 0x03, 0x99, 0xF7, 0xF9});
+			store(a, eax);
+			return true;
+		case opcode::_les:
+		case opcode::_cmp:
+			load(eax, b);
+			operand({0x3B}, eax, c);
+			bytes({0x0F, ins.op == opcode::_les ? 0x9Cu : 0x94u, 0xC0, 0x0F, 0xB6, 0xC0});
+			store(a, eax);
+			return true;
+		case opcode::_jmp:
+			jump({0xE9}, c);
+			return true;
+		case opcode::_jz:
+		case opcode::_jnz:
+			operand({0x83}, 7, a);
+			byte(0);
+			jump({0x0F, ins.op == opcode::_jz ? 0x84u : 0x85u}, c);
+			return true;
+		case opcode::_jlt:
+		case opcode::_jge:
+		case opcode::_jeq:
+		case opcode::_jne: {
+			static constexpr unsigned cc[] = {0x8C, 0x8D, 0x84, 0x85};
+			operand({0x3B}, use(a, eax), b);
+			jump({0x0F, cc[static_cast<unsigned>(ins.op) - static_cast<unsigned>(opcode::_jlt)]}, c);
+			return true;
+		}
+		case opcode::_in:
+			// mov rdi, [rsp]; lea rsi, [rbx + 4 * a], a failed read leaves through the epilogue with its status
+			bytes({0x48, 0x8B, 0x3C, 0x24, 0x48, 0x8D, 0xB3});
+			dword(a * 4);
+			call(reinterpret_cast<const void *>(&jit_read));
+			bytes({0x85, 0xC0});
+			jump({0x0F, 0x85}, epilogue);
+			if (home[a] != frame)
+				slot({0x8B}, home[a], a);
+			return true;
+		case opcode::_out:
+			bytes({0x48, 0x8B, 0x3C, 0x24});
+			load(esi, a);
+			call(reinterpret_cast<const void *>(&jit_write));
+			return true;
+		}
+		return false;
+	}
+
+	bool x64_assembler::assemble(const program &prog)
+	{
+		allocate(prog);
+		// push rbx, rbp, r12-r15; sub rsp, 8; mov rbx, rdi; mov [rsp], rsi
+		bytes({0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});
+		bytes({0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB, 0x48, 0x89, 0x34, 0x24});
+		for (std::uint32_t v = 0; v < home.size(); ++v)
+			if (home[v] != frame)
+				slot({0x8B}, home[v], v);
+		offsets.reserve(prog.code.size());
+		for (const instruction &ins : prog.code) {
+			offsets.push_back(buf.size());
+			if (!translate(ins))
+				return false;
+		}
+		std::size_t div_zero_at = buf.size();
+		byte(0xB8);
+		dword(static_cast<std::uint32_t>(run_status::divide_by_zero));
+		std::size_t epilogue_at = buf.size();
+		for (std::uint32_t v = 0; v < home.size(); ++v)
+			if (home[v] != frame)
+				slot({0x89}, home[v], v);
+		// add rsp, 8; pop r15-r12, rbp, rbx; ret
+		bytes({0x48, 0x83, 0xC4, 0x08, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3});
+		for (auto &fix : fixups) {
+			std::size_t target = fix.second == epilogue ? epilogue_at : fix.second == div_zero ? div_zero_at : offsets[fix.second];
+			auto rel = static_cast<std::uint32_t>(target - (fix.first + 4));
+			std::memcpy(buf.data() + fix.first, &rel, 4);
+		}
+		return true;
+	}
+#endif
+
+	void jit::release() noexcept
+	{
+#ifdef TCC_JIT_X64
+		if (code != nullptr)
+			munmap(code, code_size);
+#endif
+		code = nullptr;
+		code_size = 0;
+	}
+
+	bool jit::compile(const program &p)
+	{
+		release();
+		prog = &p;
+#ifdef TCC_JIT_X64
+		x64_assembler as;
+		if (!as.assemble(p))
+			return false;
+		// Written while still writable, then turned executable, never both at once
+		void *mem = mmap(nullptr, as.buf.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+			return false;
+		std::memcpy(mem, as.buf.data(), as.buf.size());
+		if (mprotect(mem, as.buf.size(), PROT_READ | PROT_EXEC) != 0) {
+			munmap(mem, as.buf.size());
+			return false;
+		}
+		code = mem;
+		code_size = as.buf.size();
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	run_status jit::run(io_buffer &io)
+	{
+		if (code == nullptr)
+			return interp.run(*prog, io);
+		regs = prog->registers;
+		auto func = reinterpret_cast<int (*)(std::int32_t *, io_buffer *)>(code);
+		return static_cast<run_status>(func(regs.data(), &io));
+	}
+}
\ No newline at end of file
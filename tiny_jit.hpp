@@ -0,0 +1,40 @@
+#pragma once
+
+#include "tiny_vm.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace tcc {
+	/*
+	 * Translates the bytecode to x86-64 machine code in an executable mapping, on Linux only.
+	 * The registers of the bytecode live in a frame addressed by rbx, the five most used ones, weighted
+	 * by loop nesting, stay in callee-saved machine registers. read and write call into io_buffer.
+	 * Programs which cannot be translated run on the virtual machine instead.
+	 */
+	class jit final {
+		void *code = nullptr;
+		std::size_t code_size = 0;
+		const program *prog = nullptr;
+		std::vector<std::int32_t> regs;
+		vm interp;
+		void release() noexcept;
+	public:
+		jit() = default;
+		jit(const jit &) = delete;
+		~jit()
+		{
+			release();
+		}
+		// The program has to outlive the translation, false if run() falls back to the virtual machine
+		bool compile(const program &);
+		inline bool is_native() const noexcept
+		{
+			return code != nullptr;
+		}
+		run_status run(io_buffer &);
+		inline const std::vector<std::int32_t> &get_registers() const noexcept
+		{
+			return is_native() ? regs : interp.get_registers();
+		}
+	};
+}
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "tiny_parser.hpp"
+
+namespace tcc {
+	template<typename enum_t>
+	constexpr unsigned char sub(enum_t e)
+	{
+		return static_cast<unsigned char>(e);
+	}
+
+	const char *parser::get_error(error_type type) noexcept
+	{
+		switch (type) {
+		case error_type::missing_token:
+			return "缺少记号";
+		case error_type::unexpected_token:
+			return "多余的记号";
+		case error_type::expect_statement:
+			return "应为语句";
+		case error_type::expect_factor:
+			return "应为表达式";
+		case error_type::too_deep:
+			return "嵌套过深";
+		}
+		return "无错误";
+	}
+
+	syntax_node *parser::make(node_kind kind)
+	{
+		syntax_node *n = nodes.make<syntax_node>();
+		n->kind = kind;
+		n->token = static_cast<std::uint32_t>(cur);
+		++node_count;
+		return n;
+	}
+
+	void parser::error(error_type type, std::string_view expected)
+	{
+		// Errors caused by the last one are dropped until the parser is back in step
+		if (panic)
+			return;
+		panic = true;
+		error_info e{type, std::string(), 0, 1, 0, cur};
+		if (more()) {
+			const token &t = tokens[cur];
+			lines.locate(t.offset + t.length, e.line, e.pos);
+			e.offset = t.offset + t.length - 1;
+			e.text = source.substr(t.offset, t.length);
+		}
+		else {
+			if (!tokens.empty()) {
+				const token &t = tokens[tokens.size() - 1];
+				lines.locate(t.offset + t.length, e.line, e.pos);
+				++e.pos;
+				e.offset = t.offset + t.length;
+			}
+			e.text = "EOF";
+		}
+		if (type == error_type::missing_token)
+			e.text = expected;
+		errors.push_back(std::move(e));
+	}
+
+	bool parser::check(token_type type, unsigned char subtype)
+	{
+		return more() && tokens[cur].type == type && tokens[cur].subtype == subtype;
+	}
+
+	bool parser::match(token_type type, unsigned char subtype, std::string_view text)
+	{
+		if (check(type, subtype)) {
+			++cur;
+			panic = false;
+			return true;
+		}
+		// A single stray token in front of the expected one is dropped
+		if (more(1) && tokens[cur + 1].type == type && tokens[cur + 1].subtype == subtype) {
+			error(error_type::unexpected_token);
+			cur += 2;
+			panic = false;
+			return true;
+		}
+		error(error_type::missing_token, text);
+		return false;
+	}
+
+	// Skip to the end of the broken statement, where a sequence or an enclosing statement can go on
+	void parser::synchronize()
+	{
+		for (; more(); ++cur) {
+			const token &t = tokens[cur];
+			if (t.type == token_type::_signal && t.subtype == sub(signal_type::_sem))
+				return;
+			if (t.type == token_type::_action) {
+				auto act = static_cast<action_type>(t.subtype);
+				if (act == action_type::_end || act == action_type::_else || act == action_type::_until)
+					return;
+			}
+		}
+	}
+
+	// One more level of nesting, past max_depth the rest of the input is dropped and parsing ends
+	bool parser::enter()
+	{
+		if (depth < max_depth) {
+			++depth;
+			return true;
+		}
+		panic = false;
+		error(error_type::too_deep);
+		while (more())
+			++cur;
+		return false;
+	}
+
+	// stmts : statement {";" statement}
+	syntax_node *parser::stmt_sequence()
+	{
+		if (!enter())
+			return nullptr;
+		syntax_node *first = statement(), *last = first;
+		while (check(token_type::_signal, sub(signal_type::_sem))) {
+			++cur;
+			panic = false;
+			syntax_node *s = statement();
+			if (s == nullptr)
+				continue;
+			if (last == nullptr)
+				first = s;
+			else
+				last->sibling = s;
+			last = s;
+		}
+		--depth;
+		return first;
+	}
+
+	syntax_node *parser::statement()
+	{
+		if (more()) {
+			const token &t = tokens[cur];
+			if (t.type == token_type::_identifier)
+				return assign_stmt();
+			if (t.type == token_type::_action) {
+				switch (static_cast<action_type>(t.subtype)) {
+				case action_type::_if:
+					return if_stmt();
+				case action_type::_repeat:
+					return repeat_stmt();
+				case action_type::_read:
+					return read_stmt();
+				case action_type::_write:
+					return write_stmt();
+				default:
+					break;
+				}
+			}
+		}
+		error(error_type::expect_statement);
+		synchronize();
+		return nullptr;
+	}
+
+	// if-stmt : "if" expr "then" stmts ["else" stmts] "end"
+	syntax_node *parser::if_stmt()
+	{
+		syntax_node *n = make(node_kind::_if);
+		++cur;
+		n->child[0] = exp();
+		match(token_type::_action, sub(action_type::_then), "then");
+		n->child[1] = stmt_sequence();
+		if (check(token_type::_action, sub(action_type::_else))) {
+			++cur;
+			n->child[2] = stmt_sequence();
+		}
+		match(token_type::_action, sub(action_type::_end), "end");
+		return n;
+	}
+
+	// repeat-stmt : "repeat" stmts "until" expr
+	syntax_node *parser::repeat_stmt()
+	{
+		syntax_node *n = make(node_kind::_repeat);
+		++cur;
+		n->child[0] = stmt_sequence();
+		match(token_type::_action, sub(action_type::_until), "until");
+		n->child[1] = exp();
+		return n;
+	}
+
+	// assign-stmt : id ":=" expr
+	syntax_node *parser::assign_stmt()
+	{
+		syntax_node *n = make(node_kind::_assign);
+		n->symbol = tokens[cur++].symbol;
+		match(token_type::_signal, sub(signal_type::_asi), ":=");
+		n->child[0] = exp();
+		return n;
+	}
+
+	// read-stmt : "read" id
+	syntax_node *parser::read_stmt()
+	{
+		syntax_node *n = make(node_kind::_read);
+		++cur;
+		if (more() && tokens[cur].type == token_type::_identifier)
+			n->symbol = tokens[cur++].symbol;
+		else {
+			n->symbol = cov::symbol_pool::npos;
+			error(error_type::missing_token, "ID");
+		}
+		return n;
+	}
+
+	// write-stmt : "write" expr
+	syntax_node *parser::write_stmt()
+	{
+		syntax_node *n = make(node_kind::_write);
+		++cur;
+		n->child[0] = exp();
+		return n;
+	}
+
+	// expr : sexp [("<" | "=") sexp]
+	syntax_node *parser::exp()
+	{
+		syntax_node *lhs = simple_exp();
+		if (check(token_type::_signal, sub(signal_type::_les)) || check(token_type::_signal, sub(signal_type::_cmp))) {
+			syntax_node *n = make(node_kind::_op);
+			n->op = static_cast<signal_type>(tokens[cur++].subtype);
+			n->child[0] = lhs;
+			n->child[1] = simple_exp();
+			return n;
+		}
+		return lhs;
+	}
+
+	// sexp : term {("+" | "-") term}
+	syntax_node *parser::simple_exp()
+	{
+		syntax_node *lhs = term();
+		while (check(token_type::_signal, sub(signal_type::_add)) || check(token_type::_signal, sub(signal_type::_sub))) {
+			syntax_node *n = make(node_kind::_op);
+			n->op = static_cast<signal_type>(tokens[cur++].subtype);
+			n->child[0] = lhs;
+			n->child[1] = term();
+			lhs = n;
+		}
+		return lhs;
+	}
+
+	// term : fact {("*" | "/") fact}
+	syntax_node *parser::term()
+	{
+		syntax_node *lhs = factor();
+		while (check(token_type::_signal, sub(signal_type::_mul)) || check(token_type::_signal, sub(signal_type::_div))) {
+			syntax_node *n = make(node_kind::_op);
+			n->op = static_cast<signal_type>(tokens[cur++].subtype);
+			n->child[0] = lhs;
+			n->child[1] = factor();
+			lhs = n;
+		}
+		return lhs;
+	}
+
+	// fact : "(" expr ")" | num | id
+	syntax_node *parser::factor()
+	{
+		if (more()) {
+			const token &t = tokens[cur];
+			switch (t.type) {
+			case token_type::_literal: {
+				syntax_node *n = make(node_kind::_const);
+				n->symbol = t.symbol;
+				// Wraps around like the integers of the TM machine
+				std::uint32_t value = 0;
+				// Read from the source, the symbols may still be growing on the lexer thread
+				for (char c : source.substr(t.offset, t.length))
+					value = value * 10 + (c - '0');
+				n->value = static_cast<std::int32_t>(value);
+				++cur;
+				return n;
+			}
+			case token_type::_identifier: {
+				syntax_node *n = make(node_kind::_id);
+				n->symbol = t.symbol;
+				++cur;
+				return n;
+			}
+			case token_type::_signal:
+				if (t.subtype == sub(signal_type::_lbr)) {
+					if (!enter())
+						return nullptr;
+					++cur;
+					syntax_node *n = exp();
+					--depth;
+					match(token_type::_signal, sub(signal_type::_rbr), ")");
+					return n;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		error(error_type::expect_factor);
+		return nullptr;
+	}
+
+	bool parser::receive(std::size_t k)
+	{
+		while (cur + k >= tokens.size()) {
+			if (ring->pop(received) == 0) {
+				// The lexer is done, everything is in received
+				ring = nullptr;
+				return false;
+			}
+			tokens = received;
+		}
+		return true;
+	}
+
+	bool parser::program()
+	{
+		nodes.reset();
+		node_count = 0;
+		cur = 0;
+		depth = 0;
+		panic = false;
+		errors.clear();
+		root = stmt_sequence();
+		// Tokens left over, e.g. an "end" without "if", are skipped up to the next ";" and parsing goes on behind it
+		syntax_node **tail = &root;
+		for (;;) {
+			while (*tail != nullptr)
+				tail = &(*tail)->sibling;
+			if (!more())
+				break;
+			error(error_type::unexpected_token);
+			while (more() && !check(token_type::_signal, sub(signal_type::_sem)))
+				++cur;
+			if (more()) {
+				++cur;
+				panic = false;
+				*tail = stmt_sequence();
+			}
+		}
+		return errors.empty();
+	}
+
+	bool parser::parse(cov::span<const token> toks, std::string_view src, const cov::symbol_pool &syms)
+	{
+		tokens = toks;
+		source = src;
+		lines.reset(src);
+		symbols = &syms;
+		ring = nullptr;
+		return program();
+	}
+
+	bool parser::parse(cov::spsc_ring<token> &r, std::string_view src, const cov::symbol_pool &syms)
+	{
+		// The lexer's estimate of one token per eight bytes
+		received.clear();
+		received.reserve(src.size() / 8);
+		tokens = received;
+		source = src;
+		lines.reset(src);
+		symbols = &syms;
+		ring = &r;
+		return program();
+	}
+
+	constexpr std::string_view op_text(signal_type op)
+	{
+		switch (op) {
+		case signal_type::_add:
+			return "+";
+		case signal_type::_sub:
+			return "-";
+		case signal_type::_mul:
+			return "*";
+		case signal_type::_div:
+			return "/";
+		case signal_type::_cmp:
+			return "=";
+		case signal_type::_les:
+			return "<";
+		default:
+			return "?";
+		}
+	}
+
+	void parser::print_tree(std::ostream &out, const syntax_node *n, std::size_t indent) const
+	{
+		for (; n != nullptr; n = n->sibling) {
+			out << std::string(indent, ' ');
+			switch (n->kind) {
+			case node_kind::_if:
+				out << "If\n";
+				break;
+			case node_kind::_repeat:
+				out << "Repeat\n";
+				break;
+			case node_kind::_assign:
+				out << "Assign to: " << get_name(n) << '\n';
+				break;
+			case node_kind::_read:
+				out << "Read: " << get_name(n) << '\n';
+				break;
+			case node_kind::_write:
+				out << "Write\n";
+				break;
+			case node_kind::_op:
+				out << "Op: " << op_text(n->op) << '\n';
+				break;
+			case node_kind::_const:
+				out << "Const: " << n->value << '\n';
+				break;
+			case node_kind::_id:
+				out << "Id: " << get_name(n) << '\n';
+				break;
+			}
+			for (const syntax_node *c : n->child)
+				print_tree(out, c, indent + 2);
+		}
+	}
+
+	void parser::print_tree(std::ostream &out) const
+	{
+		print_tree(out, root, 2);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "tiny.hpp"
+#include "arena.hpp"
+#include "span.hpp"
+#include "spsc_ring.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace tcc {
+	enum class node_kind : unsigned char {
+		_if, _repeat, _assign, _read, _write, _op, _const, _id
+	};
+
+	/*
+	 * Node of the syntax tree, laid out like the TreeNode of the TINY reference compiler:
+	 *   if:     child[0] test, child[1] then part, child[2] else part
+	 *   repeat: child[0] body, child[1] test
+	 *   assign, write: child[0] expression, assign and read name symbol
+	 *   op:     child[0] and child[1] operands of op
+	 *   const:  value, id: symbol
+	 * Statements of a sequence are linked by sibling. Nodes live in the arena of the parser.
+	 */
+	struct syntax_node {
+		node_kind kind;
+		signal_type op = signal_type::_null;
+		// Interned name of ids, assign and read, text of constants
+		std::uint32_t symbol = 0;
+		std::int32_t value = 0;
+		// Index of the token the node starts with
+		std::uint32_t token = 0;
+		syntax_node *child[3] = {nullptr, nullptr, nullptr};
+		syntax_node *sibling = nullptr;
+	};
+
+	// Recursive descent over tokens of lexer or static_lexer, following tiny_syntax of covci.csc
+	class parser final {
+	public:
+		enum class error_type : unsigned char {
+			missing_token, unexpected_token, expect_statement, expect_factor, too_deep
+		};
+		// Nested parentheses and statements are parsed by recursion, deeper input is rejected before the stack runs out
+		static constexpr std::size_t max_depth = 10000;
+		struct error_info {
+			error_type type;
+			// Expected token of missing_token, the offending token otherwise
+			std::string text;
+			// Position of the offending token in the convention of lexer, the end of input follows the last token
+			std::size_t line, pos;
+			std::size_t offset;
+			// Index of the offending token
+			std::size_t index;
+		};
+	private:
+		cov::arena nodes;
+		std::size_t node_count = 0;
+		cov::span<const token> tokens;
+		std::string_view source;
+		// Line starts of source, only scanned once an error is reported
+		cov::line_index lines;
+		const cov::symbol_pool *symbols = nullptr;
+		std::size_t cur = 0, depth = 0;
+		// Set by an error, cleared once an expected token or a ";" is consumed
+		bool panic = false;
+		std::vector<error_info> errors;
+		syntax_node *root = nullptr;
+		// Pipelined parsing: tokens arrive from the lexer thread through the ring and are kept in received
+		cov::spsc_ring<token> *ring = nullptr;
+		std::vector<token> received;
+		bool receive(std::size_t);
+		// Token cur + k exists, pipelined parsing waits for the lexer until it is published or the input ended
+		inline bool more(std::size_t k = 0)
+		{
+			return cur + k < tokens.size() || (ring != nullptr && receive(k));
+		}
+		syntax_node *make(node_kind);
+		void error(error_type, std::string_view = std::string_view());
+		bool check(token_type, unsigned char);
+		bool match(token_type, unsigned char, std::string_view);
+		void synchronize();
+		bool enter();
+		syntax_node *stmt_sequence();
+		syntax_node *statement();
+		syntax_node *if_stmt();
+		syntax_node *repeat_stmt();
+		syntax_node *assign_stmt();
+		syntax_node *read_stmt();
+		syntax_node *write_stmt();
+		syntax_node *exp();
+		syntax_node *simple_exp();
+		syntax_node *term();
+		syntax_node *factor();
+		bool program();
+		void print_tree(std::ostream &, const syntax_node *, std::size_t) const;
+	public:
+		static const char *get_error(error_type) noexcept;
+		// The tokens, source and symbols have to outlive the tree, true if there was no syntax error
+		bool parse(cov::span<const token>, std::string_view, const cov::symbol_pool &);
+		template<typename lexer_t>
+		bool parse(const lexer_t &lex)
+		{
+			return parse(lex.get_results(), lex.get_source(), lex.get_symbols());
+		}
+		// Pipelined parsing of the tokens a lexer on another thread pushes into the ring, the symbols are not used before it closes the ring
+		bool parse(cov::spsc_ring<token> &, std::string_view, const cov::symbol_pool &);
+		inline const syntax_node *get_root() const noexcept
+		{
+			return root;
+		}
+		inline const std::vector<error_info> &get_errors() const noexcept
+		{
+			return errors;
+		}
+		inline std::size_t get_node_count() const noexcept
+		{
+			return node_count;
+		}
+		inline std::size_t get_memory() const noexcept
+		{
+			return nodes.capacity();
+		}
+		// Empty for a name which was missing
+		inline std::string_view get_name(const syntax_node *n) const noexcept
+		{
+			return n->symbol < symbols->size() ? symbols->get(n->symbol) : std::string_view();
+		}
+		// Same layout as printTree of the TINY reference compiler
+		void print_tree(std::ostream &) const;
+	};
+}
\ No newline at end of file
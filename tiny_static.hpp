@@ -0,0 +1,191 @@
+#pragma once
+
+#include "tiny.hpp"
+#include "static_lexer.hpp"
+#include "static_tables.hpp"
+#include "simd_scan.hpp"
+#include <algorithm>
+
+namespace tcc {
+	// What a rule of static_rules produces
+	enum class static_kind : unsigned char {
+		blank, comment, action, signal, identifier, number, incomplete_signal, unexpected_signal, unexpected_character
+	};
+
+	constexpr cov::static_rule make_rule(std::string_view regex, static_kind kind)
+	{
+		return {regex, static_cast<unsigned char>(kind), 0};
+	}
+
+	constexpr cov::static_rule make_rule(std::string_view regex, action_type act)
+	{
+		return {regex, static_cast<unsigned char>(static_kind::action), static_cast<unsigned char>(act)};
+	}
+
+	constexpr cov::static_rule make_rule(std::string_view regex, signal_type sig)
+	{
+		return {regex, static_cast<unsigned char>(static_kind::signal), static_cast<unsigned char>(sig)};
+	}
+
+	/*
+	 * The rules of lexer in priority order. A run of signal characters is one token, so a run which
+	 * is not a signal as a whole is longer than any signal and becomes an error.
+	 */
+	struct static_rules {
+		static constexpr cov::static_rule rules[] = {
+			make_rule("if", action_type::_if),
+			make_rule("then", action_type::_then),
+			make_rule("else", action_type::_else),
+			make_rule("repeat", action_type::_repeat),
+			make_rule("until", action_type::_until),
+			make_rule("end", action_type::_end),
+			make_rule("read", action_type::_read),
+			make_rule("write", action_type::_write),
+			make_rule(R"([A-Za-z_]\w*)", static_kind::identifier),
+			make_rule(R"([0-9]+)", static_kind::number),
+			make_rule(R"(\+)", signal_type::_add),
+			make_rule(R"(-)", signal_type::_sub),
+			make_rule(R"(\*)", signal_type::_mul),
+			make_rule(R"(/)", signal_type::_div),
+			make_rule(R"(=)", signal_type::_cmp),
+			make_rule(R"(<)", signal_type::_les),
+			make_rule(R"(\()", signal_type::_lbr),
+			make_rule(R"(\))", signal_type::_rbr),
+			make_rule(R"(;)", signal_type::_sem),
+			make_rule(R"(:=)", signal_type::_asi),
+			make_rule(R"(:)", static_kind::incomplete_signal),
+			make_rule(R"([-+*/=<();:]+)", static_kind::unexpected_signal),
+			make_rule(R"(\{[^}]*\}?)", static_kind::comment),
+			make_rule(R"([\s\x00]+)", static_kind::blank),
+			make_rule(R"([\x00-\xff])", static_kind::unexpected_character)
+		};
+	};
+
+	/*
+	 * Whole-buffer TINY lexer on a transition table built at compile time from static_rules.
+	 * Produces the same tokens, symbols and errors as lexer::lex(), without any startup cost.
+	 */
+	class static_lexer final {
+		static constexpr cov::char_table blank_chars = cov::make_char_table("");
+	public:
+		using state = lexer::state;
+		using error_info = lexer::error_info;
+		using scanner = cov::static_scanner<static_rules>;
+	private:
+		std::vector<token> results;
+		std::vector<error_info> errors;
+		cov::symbol_pool symbols;
+		cov::mapped_file file;
+		std::string_view source;
+		cov::line_index lines;
+		void push(token_type type, unsigned char subtype, std::size_t off, std::size_t len, std::uint32_t sym = 0)
+		{
+			results.push_back({type, subtype, sym, static_cast<std::uint32_t>(off), static_cast<std::uint32_t>(len)});
+		}
+		// Positions are filled in once the whole buffer is lexed, as lexer::lex() does
+		void error(state s, std::string text, std::size_t off)
+		{
+			errors.push_back({s, std::move(text), 0, 0, off, results.size()});
+		}
+	public:
+		static const char *get_error(state s) noexcept
+		{
+			return lexer::get_error(s);
+		}
+		inline token_view view(const token &t) const noexcept
+		{
+			return token_view(t, source, symbols, lines);
+		}
+		inline const cov::line_index &get_lines() const noexcept
+		{
+			return lines;
+		}
+		inline cov::span<const token> get_results() const noexcept
+		{
+			return results;
+		}
+		inline const std::vector<error_info> &get_errors() const noexcept
+		{
+			return errors;
+		}
+		inline const cov::symbol_pool &get_symbols() const noexcept
+		{
+			return symbols;
+		}
+		inline std::string_view get_source() const noexcept
+		{
+			return source;
+		}
+		// Lex a whole buffer, the buffer must outlive the tokens
+		void lex(std::string_view src)
+		{
+			results.clear();
+			errors.clear();
+			symbols.clear();
+			source = src;
+			lines.reset(src);
+			results.reserve(src.size() / 8);
+			const char *base = src.data(), *p = base, *end = base + src.size();
+			while (p != end) {
+				// Blanks and comments take the vectorized paths of lexer::run, a single separator is stepped over
+				// here since most runs between tokens are one byte long and not worth a call into the kernel
+				if (blank_chars[static_cast<unsigned char>(*p)] & cov::cc_blank) {
+					if (++p != end && (blank_chars[static_cast<unsigned char>(*p)] & cov::cc_blank))
+						p = cov::skip_blank(p, end);
+					continue;
+				}
+				if (*p == '{') {
+					p = cov::find_char(p, end, '}');
+					if (p != end)
+						++p;
+					continue;
+				}
+				int rule;
+				// Any single character matches the last rule
+				const char *q = scanner::match(p, end, rule);
+				const cov::static_rule &r = static_rules::rules[rule];
+				std::size_t off = p - base, len = q - p;
+				std::string_view text(p, len);
+				switch (static_cast<static_kind>(r.kind)) {
+				case static_kind::blank:
+				case static_kind::comment:
+					break;
+				case static_kind::action:
+					push(token_type::_action, r.subtype, off, len);
+					break;
+				case static_kind::signal:
+					push(token_type::_signal, r.subtype, off, len);
+					break;
+				case static_kind::identifier:
+					push(token_type::_identifier, 0, off, len, symbols.intern(text));
+					break;
+				case static_kind::number:
+					push(token_type::_literal, static_cast<unsigned char>(literal_type::_number), off, len, symbols.intern(text));
+					break;
+				case static_kind::incomplete_signal:
+				case static_kind::unexpected_signal:
+					// The character after the run is consumed by the error, even a newline
+					error(static_cast<static_kind>(r.kind) == static_kind::incomplete_signal ? state::incomplete_signal : state::unexpected_signal, std::string(text), q - base);
+					if (q != end)
+						++q;
+					break;
+				case static_kind::unexpected_character:
+					error(state::unexpected_character, std::string(text), off);
+					break;
+				}
+				p = q;
+			}
+			for (auto &e : errors) {
+				lines.locate(e.offset, e.line, e.pos);
+				++e.pos;
+			}
+		}
+		bool lex_file(const std::string &path)
+		{
+			if (!file.open(path))
+				return false;
+			lex(file.view());
+			return true;
+		}
+	};
+}
\ No newline at end of file
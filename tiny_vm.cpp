@@ -0,0 +1,473 @@
+#include "tiny_vm.hpp"
+
+// Labels as values of GCC and Clang give every instruction its own indirect jump
+#if defined(__GNUC__)
+#define TCC_THREADED
+#endif
+
+namespace tcc {
+	// Arithmetic of the virtual machine, wrapping around instead of overflowing
+	inline std::int32_t wrap_add(std::int32_t a, std::int32_t b) noexcept
+	{
+		return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) + static_cast<std::uint32_t>(b));
+	}
+
+	inline std::int32_t wrap_sub(std::int32_t a, std::int32_t b) noexcept
+	{
+		return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) - static_cast<std::uint32_t>(b));
+	}
+
+	inline std::int32_t wrap_mul(std::int32_t a, std::int32_t b) noexcept
+	{
+		return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) * static_cast<std::uint32_t>(b));
+	}
+
+	// The divisor is not zero, INT32_MIN / -1 wraps to INT32_MIN
+	inline std::int32_t wrap_div(std::int32_t a, std::int32_t b) noexcept
+	{
+		return b == -1 ? wrap_sub(0, a) : a / b;
+	}
+
+	void compiler::collect(const syntax_node *n)
+	{
+		for (; n != nullptr; n = n->sibling) {
+			switch (n->kind) {
+			case node_kind::_assign:
+			case node_kind::_read:
+			case node_kind::_id:
+				if (var_regs[n->symbol] == npos) {
+					var_regs[n->symbol] = static_cast<std::uint32_t>(prog.variables.size());
+					prog.variables.push_back(n->symbol);
+				}
+				break;
+			case node_kind::_const:
+				const_regs.emplace(n->value, static_cast<std::uint32_t>(const_regs.size()));
+				break;
+			default:
+				break;
+			}
+			for (const syntax_node *c : n->child)
+				collect(c);
+		}
+	}
+
+	std::uint32_t compiler::constant(std::int32_t value) const
+	{
+		return static_cast<std::uint32_t>(prog.variables.size()) + const_regs.at(value);
+	}
+
+	std::uint32_t compiler::temp()
+	{
+		if (temp_top == prog.registers.size())
+			prog.registers.push_back(0);
+		return temp_top++;
+	}
+
+	std::size_t compiler::emit(opcode op, std::uint32_t a, std::uint32_t b, std::uint32_t c)
+	{
+		instruction i;
+		i.op = op;
+		i.a = a;
+		i.b = b;
+		i.c = c;
+		prog.code.push_back(i);
+		return prog.code.size() - 1;
+	}
+
+	// Register holding the value of the expression, an operation stores its result in dst if there is one
+	std::uint32_t compiler::exp(const syntax_node *n, std::uint32_t dst)
+	{
+		switch (n->kind) {
+		case node_kind::_const:
+			return constant(n->value);
+		case node_kind::_id:
+			return var_regs[n->symbol];
+		default:
+			break;
+		}
+		// Temporaries of the operands are free again once the operation has read them
+		std::uint32_t mark = temp_top;
+		std::uint32_t lhs = exp(n->child[0]), rhs = exp(n->child[1]);
+		temp_top = mark;
+		if (dst == npos)
+			dst = temp();
+		opcode op = opcode::_halt;
+		switch (n->op) {
+		case signal_type::_add:
+			op = opcode::_add;
+			break;
+		case signal_type::_sub:
+			op = opcode::_sub;
+			break;
+		case signal_type::_mul:
+			op = opcode::_mul;
+			break;
+		case signal_type::_div:
+			op = opcode::_div;
+			break;
+		case signal_type::_les:
+			op = opcode::_les;
+			break;
+		case signal_type::_cmp:
+			op = opcode::_cmp;
+			break;
+		default:
+			break;
+		}
+		emit(op, dst, lhs, rhs);
+		return dst;
+	}
+
+	// Jump taken when the test equals cond, its target is left to the caller
+	std::size_t compiler::branch(const syntax_node *test, bool cond)
+	{
+		std::uint32_t mark = temp_top;
+		std::size_t at;
+		// Comparisons jump on their operands directly
+		if (test->kind == node_kind::_op && (test->op == signal_type::_les || test->op == signal_type::_cmp)) {
+			std::uint32_t lhs = exp(test->child[0]), rhs = exp(test->child[1]);
+			if (test->op == signal_type::_les)
+				at = emit(cond ? opcode::_jlt : opcode::_jge, lhs, rhs);
+			else
+				at = emit(cond ? opcode::_jeq : opcode::_jne, lhs, rhs);
+		}
+		else
+			at = emit(cond ? opcode::_jnz : opcode::_jz, exp(test));
+		temp_top = mark;
+		return at;
+	}
+
+	void compiler::stmt_sequence(const syntax_node *n)
+	{
+		for (; n != nullptr; n = n->sibling) {
+			temp_top = temp_base;
+			switch (n->kind) {
+			case node_kind::_if: {
+				std::size_t skip = branch(n->child[0], false);
+				stmt_sequence(n->child[1]);
+				if (n->child[2] != nullptr) {
+					std::size_t end = emit(opcode::_jmp);
+					prog.code[skip].c = static_cast<std::uint32_t>(prog.code.size());
+					stmt_sequence(n->child[2]);
+					prog.code[end].c = static_cast<std::uint32_t>(prog.code.size());
+				}
+				else
+					prog.code[skip].c = static_cast<std::uint32_t>(prog.code.size());
+				break;
+			}
+			case node_kind::_repeat: {
+				auto top = static_cast<std::uint32_t>(prog.code.size());
+				stmt_sequence(n->child[0]);
+				prog.code[branch(n->child[1], false)].c = top;
+				break;
+			}
+			case node_kind::_assign: {
+				std::uint32_t var = var_regs[n->symbol], value = exp(n->child[0], var);
+				if (value != var)
+					emit(opcode::_mov, var, value);
+				break;
+			}
+			case node_kind::_read:
+				emit(opcode::_in, var_regs[n->symbol]);
+				break;
+			case node_kind::_write:
+				emit(opcode::_out, exp(n->child[0]));
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	const program &compiler::compile(const syntax_node *root, std::size_t symbol_count)
+	{
+		prog = program();
+		var_regs.assign(symbol_count, npos);
+		const_regs.clear();
+		collect(root);
+		prog.constants = const_regs.size();
+		prog.registers.assign(prog.variables.size() + prog.constants, 0);
+		for (auto &it : const_regs)
+			prog.registers[prog.variables.size() + it.second] = it.first;
+		temp_base = temp_top = static_cast<std::uint32_t>(prog.registers.size());
+		stmt_sequence(root);
+		emit(opcode::_halt);
+		return prog;
+	}
+
+	void print_program(std::ostream &out, const program &prog, const cov::symbol_pool &symbols)
+	{
+		static const char *names[] = {
+			"halt", "mov", "add", "sub", "mul", "div", "les", "cmp",
+			"jmp", "jz", "jnz", "jlt", "jge", "jeq", "jne", "in", "out"
+		};
+		// Variables by name, constants by value and temporaries numbered
+		auto reg = [&](std::uint32_t r) -> std::string {
+			if (r < prog.variables.size())
+				return std::string(symbols.get(prog.variables[r]));
+			if (r < prog.variables.size() + prog.constants)
+				return std::to_string(prog.registers[r]);
+			return "t" + std::to_string(r - prog.variables.size() - prog.constants);
+		};
+		for (std::size_t i = 0; i < prog.code.size(); ++i) {
+			const instruction &ins = prog.code[i];
+			out << i << ":\t" << names[static_cast<unsigned char>(ins.op)];
+			switch (ins.op) {
+			case opcode::_halt:
+				break;
+			case opcode::_mov:
+				out << '\t' << reg(ins.a) << ", " << reg(ins.b);
+				break;
+			case opcode::_jmp:
+				out << '\t' << ins.c;
+				break;
+			case opcode::_jz:
+			case opcode::_jnz:
+				out << '\t' << reg(ins.a) << ", " << ins.c;
+				break;
+			case opcode::_jlt:
+			case opcode::_jge:
+			case opcode::_jeq:
+			case opcode::_jne:
+				out << '\t' << reg(ins.a) << ", " << reg(ins.b) << ", " << ins.c;
+				break;
+			case opcode::_in:
+			case opcode::_out:
+				out << '\t' << reg(ins.a);
+				break;
+			default:
+				out << '\t' << reg(ins.a) << ", " << reg(ins.b) << ", " << reg(ins.c);
+				break;
+			}
+			out << '\n';
+		}
+	}
+
+	const char *get_run_error(run_status status) noexcept
+	{
+		switch (status) {
+		case run_status::ok:
+			return "无错误";
+		case run_status::divide_by_zero:
+			return "除数为零";
+		case run_status::end_of_input:
+			return "输入不足";
+		case run_status::invalid_input:
+			return "输入不是整数";
+		case run_status::step_limit:
+			return "超出步数限制";
+		}
+		return "无错误";
+	}
+
+	run_status read_error(io_buffer::result res) noexcept
+	{
+		switch (res) {
+		case io_buffer::result::ok:
+			return run_status::ok;
+		case io_buffer::result::end_of_input:
+			return run_status::end_of_input;
+		case io_buffer::result::invalid_input:
+			return run_status::invalid_input;
+		}
+		return run_status::ok;
+	}
+
+	template<bool count>
+	run_status vm::execute(const program &prog, io_buffer &io)
+	{
+		regs = prog.registers;
+		std::int32_t *r = regs.data();
+		const instruction *code = prog.code.data(), *ip = code;
+		std::uint64_t n = 0;
+		run_status status = run_status::ok;
+#ifdef TCC_THREADED
+		static void *const labels[] = {
+			&&op_halt, &&op_mov, &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_les, &&op_cmp,
+			&&op_jmp, &&op_jz, &&op_jnz, &&op_jlt, &&op_jge, &&op_jeq, &&op_jne, &&op_in, &&op_out
+		};
+#define TCC_CASE(name) op##name:
+#define TCC_NEXT() do { if (count && ++n > limit) goto stop; goto *labels[static_cast<unsigned char>(ip->op)]; } while (false)
+		TCC_NEXT();
+#else
+#define TCC_CASE(name) case opcode::name:
+#define TCC_NEXT() continue
+		for (;; ) {
+			if (count && ++n > limit)
+				goto stop;
+			switch (ip->op) {
+#endif
+			TCC_CASE(_halt)
+				goto done;
+			TCC_CASE(_mov)
+				r[ip->a] = r[ip->b];
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_add)
+				r[ip->a] = wrap_add(r[ip->b], r[ip->c]);
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_sub)
+				r[ip->a] = wrap_sub(r[ip->b], r[ip->c]);
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_mul)
+				r[ip->a] = wrap_mul(r[ip->b], r[ip->c]);
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_div)
+				if (r[ip->c] == 0) {
+					status = run_status::divide_by_zero;
+					goto done;
+				}
+				r[ip->a] = wrap_div(r[ip->b], r[ip->c]);
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_les)
+				r[ip->a] = r[ip->b] < r[ip->c];
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_cmp)
+				r[ip->a] = r[ip->b] == r[ip->c];
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_jmp)
+				ip = code + ip->c;
+				TCC_NEXT();
+			TCC_CASE(_jz)
+				ip = r[ip->a] == 0 ? code + ip->c : ip + 1;
+				TCC_NEXT();
+			TCC_CASE(_jnz)
+				ip = r[ip->a] != 0 ? code + ip->c : ip + 1;
+				TCC_NEXT();
+			TCC_CASE(_jlt)
+				ip = r[ip->a] < r[ip->b] ? code + ip->c : ip + 1;
+				TCC_NEXT();
+			TCC_CASE(_jge)
+				ip = r[ip->a] >= r[ip->b] ? code + ip->c : ip + 1;
+				TCC_NEXT();
+			TCC_CASE(_jeq)
+				ip = r[ip->a] == r[ip->b] ? code + ip->c : ip + 1;
+				TCC_NEXT();
+			TCC_CASE(_jne)
+				ip = r[ip->a] != r[ip->b] ? code + ip->c : ip + 1;
+				TCC_NEXT();
+			TCC_CASE(_in)
+				status = read_error(io.read(r[ip->a]));
+				if (status != run_status::ok)
+					goto done;
+				++ip;
+				TCC_NEXT();
+			TCC_CASE(_out)
+				io.write(r[ip->a]);
+				++ip;
+				TCC_NEXT();
+#ifndef TCC_THREADED
+			}
+		}
+#endif
+#undef TCC_CASE
+#undef TCC_NEXT
+	stop:
+		status = run_status::step_limit;
+		n = limit;
+	done:
+		steps = n;
+		return status;
+	}
+
+	run_status vm::run(const program &prog, io_buffer &io, bool count)
+	{
+		return count ? execute<true>(prog, io) : execute<false>(prog, io);
+	}
+
+	std::int32_t tree_walker::eval(const syntax_node *n)
+	{
+		switch (n->kind) {
+		case node_kind::_const:
+			return n->value;
+		case node_kind::_id:
+			return vars[n->symbol];
+		default:
+			break;
+		}
+		std::int32_t lhs = eval(n->child[0]), rhs = eval(n->child[1]);
+		switch (n->op) {
+		case signal_type::_add:
+			return wrap_add(lhs, rhs);
+		case signal_type::_sub:
+			return wrap_sub(lhs, rhs);
+		case signal_type::_mul:
+			return wrap_mul(lhs, rhs);
+		case signal_type::_div:
+			if (rhs == 0) {
+				status = run_status::divide_by_zero;
+				return 0;
+			}
+			return wrap_div(lhs, rhs);
+		case signal_type::_les:
+			return lhs < rhs;
+		case signal_type::_cmp:
+			return lhs == rhs;
+		default:
+			return 0;
+		}
+	}
+
+	bool tree_walker::exec(const syntax_node *n)
+	{
+		for (; n != nullptr; n = n->sibling) {
+			switch (n->kind) {
+			case node_kind::_if: {
+				std::int32_t test = eval(n->child[0]);
+				if (status != run_status::ok || !exec(test != 0 ? n->child[1] : n->child[2]))
+					return false;
+				break;
+			}
+			case node_kind::_repeat: {
+				std::int32_t test = 0;
+				do {
+					if (!exec(n->child[0]))
+						return false;
+					test = eval(n->child[1]);
+					if (status != run_status::ok)
+						return false;
+				}
+				while (test == 0);
+				break;
+			}
+			case node_kind::_assign: {
+				std::int32_t value = eval(n->child[0]);
+				if (status != run_status::ok)
+					return false;
+				vars[n->symbol] = value;
+				break;
+			}
+			case node_kind::_read:
+				status = read_error(io->read(vars[n->symbol]));
+				if (status != run_status::ok)
+					return false;
+				break;
+			case node_kind::_write: {
+				std::int32_t value = eval(n->child[0]);
+				if (status != run_status::ok)
+					return false;
+				io->write(value);
+				break;
+			}
+			default:
+				break;
+			}
+		}
+		return true;
+	}
+
+	run_status tree_walker::run(const syntax_node *root, std::size_t symbol_count, io_buffer &buff)
+	{
+		vars.assign(symbol_count, 0);
+		io = &buff;
+		status = run_status::ok;
+		exec(root);
+		return status;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "tiny_parser.hpp"
+#include "io_buffer.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tcc {
+	/*
+	 * Register bytecode of TINY, every operand is a register:
+	 *   mov a, b          r[a] = r[b]
+	 *   add..div a, b, c  r[a] = r[b] op r[c], arithmetic wraps around like 32-bit two's complement
+	 *   les, cmp a, b, c  r[a] = r[b] < r[c], r[b] == r[c]
+	 *   jmp c             jump to instruction c
+	 *   jz, jnz a, c      jump if r[a] is zero, not zero
+	 *   jlt..jne a, b, c  jump if r[a] < r[b], >=, ==, !=
+	 *   in a, out a       read r[a], write r[a]
+	 */
+	enum class opcode : unsigned char {
+		_halt, _mov, _add, _sub, _mul, _div, _les, _cmp,
+		_jmp, _jz, _jnz, _jlt, _jge, _jeq, _jne, _in, _out
+	};
+
+	// 12 bytes, up to 16M registers
+	struct instruction {
+		opcode op : 8;
+		std::uint32_t a : 24;
+		std::uint32_t b, c;
+	};
+
+	/*
+	 * Registers are laid out as variables, constants, then temporaries. The initial register file holds
+	 * zero for the variables, as TINY has no declarations, and the value of every constant.
+	 */
+	struct program {
+		std::vector<instruction> code;
+		std::vector<std::int32_t> registers;
+		// Symbol of every variable register
+		std::vector<std::uint32_t> variables;
+		std::size_t constants = 0;
+	};
+
+	// Compiles the syntax tree of a parse without errors
+	class compiler final {
+		static constexpr std::uint32_t npos = UINT32_MAX;
+		program prog;
+		// Register of every symbol used as a variable
+		std::vector<std::uint32_t> var_regs;
+		// Constants in order of first appearance
+		std::unordered_map<std::int32_t, std::uint32_t> const_regs;
+		std::uint32_t temp_base = 0, temp_top = 0;
+		void collect(const syntax_node *);
+		std::uint32_t constant(std::int32_t) const;
+		std::uint32_t temp();
+		std::size_t emit(opcode, std::uint32_t = 0, std::uint32_t = 0, std::uint32_t = 0);
+		std::uint32_t exp(const syntax_node *, std::uint32_t = npos);
+		std::size_t branch(const syntax_node *, bool);
+		void stmt_sequence(const syntax_node *);
+	public:
+		const program &compile(const syntax_node *, std::size_t);
+		inline const program &get_program() const noexcept
+		{
+			return prog;
+		}
+	};
+
+	void print_program(std::ostream &, const program &, const cov::symbol_pool &);
+
+	enum class run_status : unsigned char {
+		ok, divide_by_zero, end_of_input, invalid_input, step_limit
+	};
+
+	const char *get_run_error(run_status) noexcept;
+
+	using cov::io_buffer;
+
+	// Status of a failed read
+	run_status read_error(io_buffer::result) noexcept;
+
+	// Threaded interpreter of the bytecode
+	class vm final {
+		std::vector<std::int32_t> regs;
+		std::uint64_t steps = 0, limit = UINT64_MAX;
+		template<bool count>
+		run_status execute(const program &, io_buffer &);
+	public:
+		// Counting the executed instructions makes the dispatch slower
+		run_status run(const program &, io_buffer &, bool count = false);
+		// Counted runs stop with step_limit after executing this many instructions
+		inline void set_limit(std::uint64_t n) noexcept
+		{
+			limit = n;
+		}
+		inline const std::vector<std::int32_t> &get_registers() const noexcept
+		{
+			return regs;
+		}
+		inline std::uint64_t get_steps() const noexcept
+		{
+			return steps;
+		}
+	};
+
+	// Straightforward interpreter of the syntax tree, the baseline of the virtual machine
+	class tree_walker final {
+		std::vector<std::int32_t> vars;
+		io_buffer *io = nullptr;
+		run_status status = run_status::ok;
+		bool exec(const syntax_node *);
+		std::int32_t eval(const syntax_node *);
+	public:
+		run_status run(const syntax_node *, std::size_t, io_buffer &);
+		inline const std::vector<std::int32_t> &get_variables() const noexcept
+		{
+			return vars;
+		}
+	};
+}
\ No newline at end of file
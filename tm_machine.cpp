@@ -0,0 +1,475 @@
+#include "tm_machine.hpp"
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <cctype>
+#include <cstdio>
+
+#if defined(__GNUC__)
+#define TM_THREADED
+#endif
+
+namespace cov {
+	enum class tm_machine::handler : unsigned char {
+		_halt, _in, _out, _add, _sub, _mul, _div,
+		_ld, _st, _lda, _ldc, _jlt, _jle, _jgt, _jge, _jeq, _jne,
+		// Writes to the program counter, anything else touching it runs the instruction as written
+		_ld_pc, _lda_pc, _ldc_pc, _slow
+	};
+
+	static constexpr const char *op_names[] = {
+		"HALT", "IN", "OUT", "ADD", "SUB", "MUL", "DIV",
+		"LD", "ST", "LDA", "LDC", "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE"
+	};
+
+	const char *tm_op_name(tm_op op) noexcept
+	{
+		return op_names[static_cast<unsigned char>(op)];
+	}
+
+	void tm_write(std::ostream &out, const std::vector<tm_instruction> &code, const std::vector<const char *> *comments)
+	{
+		char line[64];
+		for (std::size_t i = 0; i < code.size(); ++i) {
+			const tm_instruction &in = code[i];
+			if (tm_is_ro(in.op))
+				std::snprintf(line, sizeof(line), "%3zu:  %5s  %d,%d,%d ", i, tm_op_name(in.op), in.r, in.s, in.t);
+			else
+				std::snprintf(line, sizeof(line), "%3zu:  %5s  %d,%d(%d) ", i, tm_op_name(in.op), in.r, in.d, in.s);
+			out << line;
+			if (comments != nullptr && i < comments->size() && (*comments)[i] != nullptr)
+				out << '\t' << (*comments)[i];
+			out << '\n';
+		}
+	}
+
+	// Reader of one line, skipping blanks before every item
+	class tm_line final {
+		std::string_view text;
+		std::size_t pos = 0;
+	public:
+		explicit tm_line(std::string_view t) : text(t) {}
+		void skip()
+		{
+			while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r'))
+				++pos;
+		}
+		bool at_end()
+		{
+			skip();
+			return pos == text.size();
+		}
+		bool number(long &value)
+		{
+			skip();
+			std::size_t start = pos;
+			if (pos < text.size() && (text[pos] == '-' || text[pos] == '+'))
+				++pos;
+			if (pos == text.size() || text[pos] < '0' || text[pos] > '9')
+				return false;
+			value = std::strtol(std::string(text.substr(start, 16)).c_str(), nullptr, 10);
+			while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9')
+				++pos;
+			return true;
+		}
+		bool word(std::string &value)
+		{
+			skip();
+			value.clear();
+			for (; pos < text.size() && std::isalpha(static_cast<unsigned char>(text[pos])); ++pos)
+				value += static_cast<char>(std::toupper(static_cast<unsigned char>(text[pos])));
+			return !value.empty();
+		}
+		bool expect(char c)
+		{
+			skip();
+			if (pos == text.size() || text[pos] != c)
+				return false;
+			++pos;
+			return true;
+		}
+	};
+
+	bool tm_read(std::string_view text, std::vector<tm_instruction> &code, std::string &error)
+	{
+		code.clear();
+		std::size_t line_no = 0;
+		for (std::size_t begin = 0; begin < text.size(); ++line_no) {
+			std::size_t end = text.find('\n', begin);
+			if (end == std::string_view::npos)
+				end = text.size();
+			tm_line line(text.substr(begin, end - begin));
+			begin = end + 1;
+			if (line.at_end() || line.expect('*'))
+				continue;
+			long loc = 0, r = 0, s = 0, t = 0;
+			std::string name;
+			auto fail = [&](const char *msg) {
+				error = "Line " + std::to_string(line_no + 1) + ": " + msg;
+				return false;
+			};
+			if (!line.number(loc) || loc < 0 || loc >= (1 << 24) || !line.expect(':'))
+				return fail("Bad location");
+			if (!line.word(name))
+				return fail("Missing opcode");
+			tm_instruction in;
+			std::size_t op = 0;
+			while (op < std::size(op_names) && name != op_names[op])
+				++op;
+			if (op == std::size(op_names))
+				return fail("Illegal opcode");
+			in.op = static_cast<tm_op>(op);
+			if (!line.number(r) || r < 0 || r > 7 || !line.expect(','))
+				return fail("Bad first register");
+			if (tm_is_ro(in.op)) {
+				if (!line.number(s) || s < 0 || s > 7 || !line.expect(','))
+					return fail("Bad second register");
+				if (!line.number(t) || t < 0 || t > 7)
+					return fail("Bad third register");
+			}
+			else {
+				if (!line.number(t) || !line.expect('('))
+					return fail("Bad displacement");
+				if (!line.number(s) || s < 0 || s > 7 || !line.expect(')'))
+					return fail("Bad second register");
+				in.d = static_cast<std::int32_t>(t);
+				t = 0;
+			}
+			in.r = static_cast<unsigned char>(r);
+			in.s = static_cast<unsigned char>(s);
+			in.t = static_cast<unsigned char>(t);
+			// Locations may come in any order, the gaps hold HALT like the empty memory of the simulator
+			if (static_cast<std::size_t>(loc) >= code.size())
+				code.resize(loc + 1, tm_instruction{tm_op::_halt});
+			code[loc] = in;
+		}
+		return true;
+	}
+
+	const char *tm_machine::get_error(status s) noexcept
+	{
+		switch (s) {
+		case status::halted:
+			return "无错误";
+		case status::imem_error:
+			return "指令内存越界";
+		case status::dmem_error:
+			return "数据内存越界";
+		case status::divide_by_zero:
+			return "除数为零";
+		case status::end_of_input:
+			return "输入不足";
+		case status::invalid_input:
+			return "输入不是整数";
+		case status::step_limit:
+			return "超出步数限制";
+		}
+		return "无错误";
+	}
+
+	unsigned tm_machine::get_cost(tm_op op) noexcept
+	{
+		switch (op) {
+		case tm_op::_ld:
+		case tm_op::_st:
+			return 2;
+		case tm_op::_mul:
+			return 3;
+		case tm_op::_div:
+			return 20;
+		default:
+			return 1;
+		}
+	}
+
+	void tm_machine::load(const std::vector<tm_instruction> &prog)
+	{
+		source = prog;
+		code.clear();
+		code.reserve(prog.size() + 1);
+		for (std::size_t i = 0; i < prog.size(); ++i) {
+			const tm_instruction &in = prog[i];
+			decoded dec{static_cast<handler>(in.op), in.r, in.s, in.t, in.d};
+			bool reads_pc = false, writes_pc = false;
+			switch (in.op) {
+			case tm_op::_halt:
+				break;
+			case tm_op::_in:
+				writes_pc = in.r == 7;
+				break;
+			case tm_op::_out:
+				reads_pc = in.r == 7;
+				break;
+			case tm_op::_add:
+			case tm_op::_sub:
+			case tm_op::_mul:
+			case tm_op::_div:
+				reads_pc = in.s == 7 || in.t == 7;
+				writes_pc = in.r == 7;
+				break;
+			case tm_op::_ldc:
+				writes_pc = in.r == 7;
+				break;
+			default:
+				// The value of pc during an instruction is the address of the next one
+				if (in.s == 7) {
+					dec.s = 8;
+					dec.d = static_cast<std::int32_t>(static_cast<std::uint32_t>(in.d) + static_cast<std::uint32_t>(i + 1));
+				}
+				if (in.op == tm_op::_ld || in.op == tm_op::_lda)
+					writes_pc = in.r == 7;
+				else
+					reads_pc = in.r == 7;
+				break;
+			}
+			if (reads_pc)
+				dec.op = handler::_slow;
+			else if (writes_pc) {
+				switch (in.op) {
+				case tm_op::_ld:
+					dec.op = handler::_ld_pc;
+					break;
+				case tm_op::_lda:
+					dec.op = handler::_lda_pc;
+					break;
+				case tm_op::_ldc:
+					dec.op = handler::_ldc_pc;
+					break;
+				default:
+					dec.op = handler::_slow;
+					break;
+				}
+			}
+			code.push_back(dec);
+		}
+		code.push_back(decoded{handler::_halt, 0, 0, 0, 0});
+	}
+
+	static inline std::int32_t wrap(std::int64_t v) noexcept
+	{
+		return static_cast<std::int32_t>(static_cast<std::uint32_t>(v));
+	}
+
+	template<bool count>
+	tm_machine::status tm_machine::execute(io_buffer &io)
+	{
+		const decoded *base = code.data(), *ip = base;
+		auto size = static_cast<std::uint32_t>(code.size() - 1), words = static_cast<std::uint32_t>(dmem.size());
+		std::int32_t *r = reg, *mem = dmem.data();
+		std::uint64_t *hits = counts.data(), n = 0;
+		status result = status::halted;
+		std::int32_t target = 0;
+		std::uint32_t addr = 0;
+#ifdef TM_THREADED
+		static void *const labels[] = {
+			&&op_halt, &&op_in, &&op_out, &&op_add, &&op_sub, &&op_mul, &&op_div,
+			&&op_ld, &&op_st, &&op_lda, &&op_ldc, &&op_jlt, &&op_jle, &&op_jgt, &&op_jge, &&op_jeq, &&op_jne,
+			&&op_ld_pc, &&op_lda_pc, &&op_ldc_pc, &&op_slow
+		};
+#define TM_CASE(name) op##name:
+#define TM_NEXT() do { if (count) { if (++n > limit) goto stop; ++hits[ip - base]; } goto *labels[static_cast<unsigned char>(ip->op)]; } while (false)
+		TM_NEXT();
+#else
+#define TM_CASE(name) case handler::name:
+#define TM_NEXT() goto dispatch
+	dispatch:
+		if (count) {
+			if (++n > limit)
+				goto stop;
+			++hits[ip - base];
+		}
+		switch (ip->op) {
+#endif
+			TM_CASE(_halt)
+				goto done;
+			TM_CASE(_in) {
+				io_buffer::result res = io.read(r[ip->r]);
+				if (res != io_buffer::result::ok) {
+					result = res == io_buffer::result::end_of_input ? status::end_of_input : status::invalid_input;
+					goto done;
+				}
+				++ip;
+				TM_NEXT();
+			}
+			TM_CASE(_out)
+				io.write(r[ip->r]);
+				++ip;
+				TM_NEXT();
+			TM_CASE(_add)
+				r[ip->r] = wrap(std::int64_t(r[ip->s]) + r[ip->t]);
+				++ip;
+				TM_NEXT();
+			TM_CASE(_sub)
+				r[ip->r] = wrap(std::int64_t(r[ip->s]) - r[ip->t]);
+				++ip;
+				TM_NEXT();
+			TM_CASE(_mul)
+				r[ip->r] = wrap(std::int64_t(r[ip->s]) * r[ip->t]);
+				++ip;
+				TM_NEXT();
+			TM_CASE(_div)
+				if (r[ip->t] == 0) {
+					result = status::divide_by_zero;
+					goto done;
+				}
+				r[ip->r] = wrap(std::int64_t(r[ip->s]) / r[ip->t]);
+				++ip;
+				TM_NEXT();
+			TM_CASE(_ld)
+				addr = static_cast<std::uint32_t>(ip->d) + static_cast<std::uint32_t>(r[ip->s]);
+				if (addr >= words)
+					goto dmem_fault;
+				r[ip->r] = mem[addr];
+				++ip;
+				TM_NEXT();
+			TM_CASE(_st)
+				addr = static_cast<std::uint32_t>(ip->d) + static_cast<std::uint32_t>(r[ip->s]);
+				if (addr >= words)
+					goto dmem_fault;
+				mem[addr] = r[ip->r];
+				++ip;
+				TM_NEXT();
+			TM_CASE(_lda)
+				r[ip->r] = wrap(std::int64_t(ip->d) + r[ip->s]);
+				++ip;
+				TM_NEXT();
+			TM_CASE(_ldc)
+				r[ip->r] = ip->d;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_jlt)
+				if (r[ip->r] < 0)
+					goto jump;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_jle)
+				if (r[ip->r] <= 0)
+					goto jump;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_jgt)
+				if (r[ip->r] > 0)
+					goto jump;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_jge)
+				if (r[ip->r] >= 0)
+					goto jump;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_jeq)
+				if (r[ip->r] == 0)
+					goto jump;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_jne)
+				if (r[ip->r] != 0)
+					goto jump;
+				++ip;
+				TM_NEXT();
+			TM_CASE(_ld_pc)
+				addr = static_cast<std::uint32_t>(ip->d) + static_cast<std::uint32_t>(r[ip->s]);
+				if (addr >= words)
+					goto dmem_fault;
+				target = mem[addr];
+				goto go;
+			TM_CASE(_lda_pc)
+				goto jump;
+			TM_CASE(_ldc_pc)
+				target = ip->d;
+				goto go;
+			TM_CASE(_slow) {
+				// Reference semantics with register 7 holding the address of the next instruction
+				const tm_instruction &in = source[ip - base];
+				r[7] = static_cast<std::int32_t>(ip - base + 1);
+				std::int32_t a = wrap(std::int64_t(in.d) + r[in.s]);
+				switch (in.op) {
+				case tm_op::_in: {
+					io_buffer::result res = io.read(r[in.r]);
+					if (res != io_buffer::result::ok) {
+						result = res == io_buffer::result::end_of_input ? status::end_of_input : status::invalid_input;
+						goto done;
+					}
+					break;
+				}
+				case tm_op::_out:
+					io.write(r[in.r]);
+					break;
+				case tm_op::_add:
+					r[in.r] = wrap(std::int64_t(r[in.s]) + r[in.t]);
+					break;
+				case tm_op::_sub:
+					r[in.r] = wrap(std::int64_t(r[in.s]) - r[in.t]);
+					break;
+				case tm_op::_mul:
+					r[in.r] = wrap(std::int64_t(r[in.s]) * r[in.t]);
+					break;
+				case tm_op::_div:
+					if (r[in.t] == 0) {
+						result = status::divide_by_zero;
+						goto done;
+					}
+					r[in.r] = wrap(std::int64_t(r[in.s]) / r[in.t]);
+					break;
+				case tm_op::_st:
+					if (static_cast<std::uint32_t>(a) >= words)
+						goto dmem_fault;
+					mem[a] = r[in.r];
+					break;
+				case tm_op::_jlt:
+				case tm_op::_jle:
+				case tm_op::_jgt:
+				case tm_op::_jge:
+				case tm_op::_jeq:
+				case tm_op::_jne: {
+					std::int32_t v = r[in.r];
+					bool taken = in.op == tm_op::_jlt ? v < 0 : in.op == tm_op::_jle ? v <= 0 : in.op == tm_op::_jgt ? v > 0 : in.op == tm_op::_jge ? v >= 0 : in.op == tm_op::_jeq ? v == 0 : v != 0;
+					if (taken)
+						r[7] = a;
+					break;
+				}
+				default:
+					break;
+				}
+				target = r[7];
+				goto go;
+			}
+#ifndef TM_THREADED
+		}
+#endif
+	jump:
+		target = wrap(std::int64_t(ip->d) + r[ip->s]);
+	go:
+		if (static_cast<std::uint32_t>(target) > size) {
+			result = status::imem_error;
+			goto done;
+		}
+		ip = base + target;
+		TM_NEXT();
+#undef TM_CASE
+#undef TM_NEXT
+	dmem_fault:
+		result = status::dmem_error;
+		goto done;
+	stop:
+		result = status::step_limit;
+		n = limit;
+	done:
+		r[7] = static_cast<std::int32_t>(ip - base);
+		steps = n;
+		return result;
+	}
+
+	tm_machine::status tm_machine::run(io_buffer &io, bool count)
+	{
+		std::fill(dmem.begin(), dmem.end(), 0);
+		std::fill(std::begin(reg), std::end(reg), 0);
+		// The highest address is stored at location 0, like the reference simulator does
+		if (!dmem.empty())
+			dmem[0] = static_cast<std::int32_t>(dmem.size() - 1);
+		steps = 0;
+		if (count)
+			counts.assign(code.size(), 0);
+		return count ? execute<true>(io) : execute<false>(io);
+	}
+}
\ No newline at end of file
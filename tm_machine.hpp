@@ -0,0 +1,102 @@
+#pragma once
+
+#include "io_buffer.hpp"
+#include <string_view>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cov {
+	/*
+	 * Instruction set of TM, the Tiny Machine of the TINY reference compiler, with 8 registers where
+	 * register 7 is the program counter:
+	 *   RO  halt, in r, out r, add..div r = s op t
+	 *   RM  ld r = mem[d + reg[s]], st mem[d + reg[s]] = r
+	 *   RA  lda r = d + reg[s], ldc r = d, jlt..jne pc = d + reg[s] if reg[r] compares to 0
+	 */
+	enum class tm_op : unsigned char {
+		_halt, _in, _out, _add, _sub, _mul, _div,
+		_ld, _st, _lda, _ldc, _jlt, _jle, _jgt, _jge, _jeq, _jne
+	};
+
+	struct tm_instruction {
+		tm_op op;
+		unsigned char r = 0, s = 0, t = 0;
+		std::int32_t d = 0;
+	};
+
+	const char *tm_op_name(tm_op) noexcept;
+
+	inline bool tm_is_ro(tm_op op) noexcept
+	{
+		return op <= tm_op::_div;
+	}
+
+	// Text format of the reference simulator, "loc: op r,s,t" or "loc: op r,d(s)" with an optional comment
+	void tm_write(std::ostream &, const std::vector<tm_instruction> &, const std::vector<const char *> * = nullptr);
+
+	// Lines starting with "*" are comments, false with a message on the first malformed line
+	bool tm_read(std::string_view, std::vector<tm_instruction> &, std::string &);
+
+	/*
+	 * Simulator over pre-decoded instructions: pc-relative operands become absolute and writes to the
+	 * program counter get their own handlers, so ordinary instructions never look at register 7.
+	 * Running off the end of the code halts, a jump outside of it is an instruction memory error.
+	 */
+	class tm_machine final {
+	public:
+		enum class status : unsigned char {
+			halted, imem_error, dmem_error, divide_by_zero, end_of_input, invalid_input, step_limit
+		};
+	private:
+		enum class handler : unsigned char;
+		struct decoded {
+			handler op;
+			unsigned char r, s, t;
+			std::int32_t d;
+		};
+		std::vector<tm_instruction> source;
+		std::vector<decoded> code;
+		std::vector<std::int32_t> dmem;
+		// Register 8 stays zero, the base of pc-relative operands turned absolute
+		std::int32_t reg[9] = {};
+		std::vector<std::uint64_t> counts;
+		std::uint64_t steps = 0, limit = UINT64_MAX;
+		template<bool count>
+		status execute(io_buffer &);
+	public:
+		explicit tm_machine(std::size_t words = 1 << 20) : dmem(words) {}
+		static const char *get_error(status) noexcept;
+		// Nominal cost in cycles, loads and stores take 2, mul 3 and div 20
+		static unsigned get_cost(tm_op) noexcept;
+		void load(const std::vector<tm_instruction> &);
+		// Memory and registers are reset first, counting fills the execution count of every instruction
+		status run(io_buffer &, bool count = false);
+		// Counted runs stop with step_limit after executing this many instructions
+		inline void set_limit(std::uint64_t n) noexcept
+		{
+			limit = n;
+		}
+		inline std::uint64_t get_steps() const noexcept
+		{
+			return steps;
+		}
+		inline const std::vector<std::uint64_t> &get_counts() const noexcept
+		{
+			return counts;
+		}
+		inline const std::vector<tm_instruction> &get_code() const noexcept
+		{
+			return source;
+		}
+		inline const std::int32_t *get_registers() const noexcept
+		{
+			return reg;
+		}
+		inline const std::vector<std::int32_t> &get_memory() const noexcept
+		{
+			return dmem;
+		}
+	};
+}
\ No newline at end of file
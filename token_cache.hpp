@@ -0,0 +1,237 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "symbol_pool.hpp"
+#include "token_writer.hpp"
+#include "span.hpp"
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace cov {
+	// XXH64 of a buffer, a few GB/s, used to key caches by content
+	inline std::uint64_t hash_content(std::string_view data, std::uint64_t seed = 0) noexcept
+	{
+		constexpr std::uint64_t p1 = 11400714785074694791ull, p2 = 14029467366897019727ull, p3 = 1609587929392839161ull,
+		                        p4 = 9650029242287828579ull, p5 = 2870177450012600261ull;
+		auto rotl = [](std::uint64_t x, int r) {
+			return (x << r) | (x >> (64 - r));
+		};
+		auto read64 = [](const char *p) {
+			std::uint64_t v;
+			std::memcpy(&v, p, 8);
+			return v;
+		};
+		auto round = [&](std::uint64_t acc, std::uint64_t input) {
+			return rotl(acc + input * p2, 31) * p1;
+		};
+		auto merge = [&](std::uint64_t acc, std::uint64_t val) {
+			return (acc ^ round(0, val)) * p1 + p4;
+		};
+		const char *p = data.data(), *end = p + data.size();
+		std::uint64_t h;
+		if (data.size() >= 32) {
+			std::uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+			for (; end - p >= 32; p += 32) {
+				v1 = round(v1, read64(p));
+				v2 = round(v2, read64(p + 8));
+				v3 = round(v3, read64(p + 16));
+				v4 = round(v4, read64(p + 24));
+			}
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+		}
+		else
+			h = seed + p5;
+		h += data.size();
+		for (; end - p >= 8; p += 8)
+			h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+		if (end - p >= 4) {
+			std::uint32_t v;
+			std::memcpy(&v, p, 4);
+			h = rotl(h ^ (v * p1), 23) * p2 + p3;
+			p += 4;
+		}
+		for (; p != end; ++p)
+			h = rotl(h ^ (static_cast<unsigned char>(*p) * p5), 11) * p1;
+		h ^= h >> 33;
+		h *= p2;
+		h ^= h >> 29;
+		h *= p3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	/*
+	 * Token cache file, in native byte order since it never leaves the machine:
+	 *   header
+	 *   tokens   token_count raw token records, 8-byte aligned, used in place
+	 *   symbols  symbol_count (offset, length) u32 pairs into the text that follows them
+	 *   errors   type, line, pos, offset, index, text length as u32, then the text, padded to 4 bytes
+	 * A cache is only valid for the exact source it was written for (size and hash) and the lexer revision in language.
+	 */
+	struct token_cache_header {
+		char magic[8];
+		std::uint32_t version, endian;
+		char language[16];
+		std::uint32_t token_size, token_count, symbol_count, error_count;
+		std::uint64_t source_size, source_hash;
+		// Lexer state after the last character
+		std::uint32_t state, reserved;
+		std::uint64_t tokens_offset, symbols_offset, errors_offset, file_size;
+	};
+
+	constexpr char token_cache_magic[8] = {'C', 'O', 'V', 'T', 'K', 'C', 0, 0};
+	constexpr std::uint32_t token_cache_version = 2, token_cache_endian = 0x01020304;
+
+	// Read-only mapping of a validated cache file
+	class token_cache final {
+		mapped_file _file;
+		const token_cache_header *_head = nullptr;
+		const char *at(std::uint64_t offset) const noexcept
+		{
+			return _file.data() + offset;
+		}
+		bool fail() noexcept
+		{
+			close();
+			return false;
+		}
+	public:
+		token_cache() = default;
+		token_cache(const token_cache &) = delete;
+		token_cache &operator=(const token_cache &) = delete;
+		// Fails unless the file exists and matches this lexer and this exact source
+		bool open(const std::string &path, const char *language, std::size_t token_size, std::string_view source)
+		{
+			close();
+			if (!_file.open(path) || _file.size() < sizeof(token_cache_header))
+				return fail();
+			auto head = reinterpret_cast<const token_cache_header *>(_file.data());
+			if (std::memcmp(head->magic, token_cache_magic, 8) != 0 || head->version != token_cache_version || head->endian != token_cache_endian)
+				return fail();
+			if (std::strncmp(head->language, language, sizeof(head->language)) != 0 || head->token_size != token_size)
+				return fail();
+			if (head->file_size != _file.size() || head->tokens_offset % 8 != 0 || head->tokens_offset + std::uint64_t(head->token_count) * token_size > head->symbols_offset
+			        || head->symbols_offset + std::uint64_t(head->symbol_count) * 8 > head->errors_offset || head->errors_offset > head->file_size)
+				return fail();
+			if (head->source_size != source.size() || head->source_hash != hash_content(source))
+				return fail();
+			_head = head;
+			return true;
+		}
+		void close() noexcept
+		{
+			_file.close();
+			_head = nullptr;
+		}
+		inline bool is_open() const noexcept
+		{
+			return _head != nullptr;
+		}
+		inline const token_cache_header &header() const noexcept
+		{
+			return *_head;
+		}
+		template<typename token_t>
+		span<const token_t> tokens() const noexcept
+		{
+			return span<const token_t>(reinterpret_cast<const token_t *>(at(_head->tokens_offset)), _head->token_count);
+		}
+		// Every token has to lie inside the source, those has_symbol tells to carry a symbol need one of the cache
+		template<typename token_t, typename F>
+		bool check_tokens(F &&has_symbol) const
+		{
+			for (auto &t : tokens<token_t>()) {
+				if (std::uint64_t(t.offset) + t.length > _head->source_size || (has_symbol(t) && t.symbol >= _head->symbol_count))
+					return false;
+			}
+			return true;
+		}
+		std::string_view symbol(std::uint32_t id) const noexcept
+		{
+			std::uint32_t span[2];
+			std::memcpy(span, at(_head->symbols_offset + std::uint64_t(id) * 8), 8);
+			std::uint64_t text = _head->symbols_offset + std::uint64_t(_head->symbol_count) * 8 + span[0];
+			if (text + span[1] > _head->errors_offset)
+				return std::string_view();
+			return std::string_view(at(text), span[1]);
+		}
+		// Call f(type, line, pos, offset, index, text) for every error, false if the section is damaged
+		template<typename F>
+		bool for_each_error(F &&f) const
+		{
+			std::uint64_t p = _head->errors_offset;
+			for (std::uint32_t i = 0; i < _head->error_count; ++i) {
+				std::uint32_t e[6];
+				if (p + sizeof(e) > _head->file_size)
+					return false;
+				std::memcpy(e, at(p), sizeof(e));
+				p += sizeof(e);
+				if (p + e[5] > _head->file_size)
+					return false;
+				f(e[0], e[1], e[2], e[3], e[4], std::string_view(at(p), e[5]));
+				p += (e[5] + 3) / 4 * 4;
+			}
+			return true;
+		}
+	};
+
+	// Write a cache file for source through a temporary file, so that readers never see a partial cache
+	template<typename token_t, typename error_t>
+	bool write_token_cache(const std::string &path, const char *language, std::string_view source, span<const token_t> tokens,
+	                       const std::vector<error_t> &errors, const symbol_pool &symbols, std::uint32_t state)
+	{
+		auto raw = [](const void *p, std::size_t n) {
+			return std::string_view(static_cast<const char *>(p), n);
+		};
+		token_cache_header head{};
+		std::memcpy(head.magic, token_cache_magic, 8);
+		head.version = token_cache_version;
+		head.endian = token_cache_endian;
+		std::strncpy(head.language, language, sizeof(head.language) - 1);
+		head.token_size = sizeof(token_t);
+		head.token_count = tokens.size();
+		head.symbol_count = symbols.size();
+		head.error_count = errors.size();
+		head.source_size = source.size();
+		head.source_hash = hash_content(source);
+		head.state = state;
+		head.tokens_offset = (sizeof(head) + 7) / 8 * 8;
+		head.symbols_offset = head.tokens_offset + tokens.size() * sizeof(token_t);
+		std::uint64_t text_size = 0;
+		for (std::uint32_t i = 0; i < symbols.size(); ++i)
+			text_size += symbols.get(i).size();
+		head.errors_offset = head.symbols_offset + symbols.size() * 8 + text_size;
+		head.file_size = head.errors_offset;
+		for (auto &e : errors)
+			head.file_size += 24 + (e.text.size() + 3) / 4 * 4;
+		std::string tmp = path + ".tmp";
+		output_buffer out;
+		if (!out.open(tmp))
+			return false;
+		out.write(raw(&head, sizeof(head))).write(std::string_view("\0\0\0\0\0\0\0\0", head.tokens_offset - sizeof(head)));
+		out.write(raw(tokens.data(), tokens.size() * sizeof(token_t)));
+		std::uint32_t offset = 0;
+		for (std::uint32_t i = 0; i < symbols.size(); ++i) {
+			std::uint32_t span[2] = {offset, static_cast<std::uint32_t>(symbols.get(i).size())};
+			out.write(raw(span, sizeof(span)));
+			offset += span[1];
+		}
+		for (std::uint32_t i = 0; i < symbols.size(); ++i)
+			out.write(symbols.get(i));
+		for (auto &e : errors) {
+			std::uint32_t rec[6] = {static_cast<std::uint32_t>(e.type), static_cast<std::uint32_t>(e.line), static_cast<std::uint32_t>(e.pos),
+			                        static_cast<std::uint32_t>(e.offset), static_cast<std::uint32_t>(e.index), static_cast<std::uint32_t>(e.text.size())};
+			out.write(raw(rec, sizeof(rec))).write(e.text).write(std::string_view("\0\0\0", (4 - e.text.size() % 4) % 4));
+		}
+		if (!out.close()) {
+			std::remove(tmp.c_str());
+			return false;
+		}
+		return std::rename(tmp.c_str(), path.c_str()) == 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <cmath>
+#include <type_traits>
+
+namespace cov {
+	/*
+	 * Output file behind one large reusable buffer, which is only written out when it is full or on flush().
+	 * Numbers are formatted in place with std::to_chars, nothing is allocated per write.
+	 */
+	class output_buffer final {
+		std::unique_ptr<char[]> _data;
+		std::size_t _capacity, _size = 0;
+		std::FILE *_file = nullptr;
+		bool _good = true;
+		inline char *reserve(std::size_t n)
+		{
+			if (_size + n > _capacity)
+				flush();
+			return _data.get() + _size;
+		}
+	public:
+		explicit output_buffer(std::size_t capacity = 1024 * 1024) : _data(new char[capacity]), _capacity(capacity) {}
+		output_buffer(const output_buffer &) = delete;
+		output_buffer &operator=(const output_buffer &) = delete;
+		~output_buffer()
+		{
+			close();
+		}
+		bool open(const std::string &path)
+		{
+			close();
+			_file = std::fopen(path.c_str(), "wb");
+			// The buffer of this class is the only one
+			if (_file != nullptr)
+				std::setvbuf(_file, nullptr, _IONBF, 0);
+			_good = _file != nullptr;
+			return _good;
+		}
+		bool close()
+		{
+			if (_file != nullptr) {
+				flush();
+				if (std::fclose(_file) != 0)
+					_good = false;
+				_file = nullptr;
+			}
+			_size = 0;
+			return _good;
+		}
+		inline bool is_open() const noexcept
+		{
+			return _file != nullptr;
+		}
+		inline bool good() const noexcept
+		{
+			return _good;
+		}
+		void flush()
+		{
+			if (_file != nullptr && _size > 0 && std::fwrite(_data.get(), 1, _size, _file) != _size)
+				_good = false;
+			_size = 0;
+		}
+		output_buffer &write(std::string_view str)
+		{
+			if (_size + str.size() > _capacity) {
+				flush();
+				// Too large to be buffered at all
+				if (str.size() > _capacity) {
+					if (_file != nullptr && std::fwrite(str.data(), 1, str.size(), _file) != str.size())
+						_good = false;
+					return *this;
+				}
+			}
+			std::memcpy(_data.get() + _size, str.data(), str.size());
+			_size += str.size();
+			return *this;
+		}
+		inline output_buffer &put(char c)
+		{
+			*reserve(1) = c;
+			++_size;
+			return *this;
+		}
+		template<typename T>
+		output_buffer &write_int(T value)
+		{
+			static_assert(std::is_integral_v<T>, "write_int: use write_double for floating point");
+			char *p = reserve(24);
+			_size = std::to_chars(p, p + 24, value).ptr - _data.get();
+			return *this;
+		}
+		// Shortest text which reads back the same, JSON has no inf or nan so they are written as 0
+		output_buffer &write_double(double value)
+		{
+			if (!std::isfinite(value))
+				value = 0;
+			char *p = reserve(32);
+			_size = std::to_chars(p, p + 32, value).ptr - _data.get();
+			return *this;
+		}
+		// Fixed width little-endian integers of the binary formats
+		output_buffer &write_u8(std::uint8_t value)
+		{
+			return put(static_cast<char>(value));
+		}
+		output_buffer &write_u32(std::uint32_t value)
+		{
+			char *p = reserve(4);
+			for (int i = 0; i < 4; ++i)
+				p[i] = static_cast<char>(value >> (i * 8));
+			_size += 4;
+			return *this;
+		}
+	};
+
+	enum class token_format {
+		listing, json, binary
+	};
+
+	// Extension of the output file written next to the source
+	inline const char *format_extension(token_format f) noexcept
+	{
+		switch (f) {
+		default:
+			return ".txt";
+		case token_format::json:
+			return ".jsonl";
+		case token_format::binary:
+			return ".tok";
+		}
+	}
+
+	// Length of the well-formed UTF-8 sequence of more than one byte str starts with, 0 if there is none
+	inline std::size_t utf8_length(std::string_view str) noexcept
+	{
+		auto at = [&](std::size_t i) -> unsigned char {
+			return i < str.size() ? static_cast<unsigned char>(str[i]) : 0;
+		};
+		unsigned char c = at(0), lo = 0x80, hi = 0xbf;
+		std::size_t n;
+		if (c >= 0xc2 && c <= 0xdf)
+			n = 2;
+		else if (c >= 0xe0 && c <= 0xef) {
+			n = 3;
+			// Overlong forms and surrogates
+			if (c == 0xe0)
+				lo = 0xa0;
+			else if (c == 0xed)
+				hi = 0x9f;
+		}
+		else if (c >= 0xf0 && c <= 0xf4) {
+			n = 4;
+			// Overlong forms and code points above U+10FFFF
+			if (c == 0xf0)
+				lo = 0x90;
+			else if (c == 0xf4)
+				hi = 0x8f;
+		}
+		else
+			return 0;
+		if (at(1) < lo || at(1) > hi)
+			return 0;
+		for (std::size_t i = 2; i < n; ++i) {
+			if (at(i) < 0x80 || at(i) > 0xbf)
+				return 0;
+		}
+		return n;
+	}
+
+	// Valid UTF-8 is written as it is, a byte of an invalid sequence, such as the text of an error, as \u00XX
+	inline void write_json_string(output_buffer &out, std::string_view str)
+	{
+		static constexpr char hex[] = "0123456789abcdef";
+		out.put('"');
+		for (std::size_t i = 0; i < str.size(); ++i) {
+			char c = str[i];
+			if (static_cast<unsigned char>(c) >= 0x80) {
+				std::size_t n = utf8_length(str.substr(i));
+				if (n == 0)
+					out.write("\\u00").put(hex[static_cast<unsigned char>(c) >> 4]).put(hex[c & 0xf]);
+				else {
+					out.write(str.substr(i, n));
+					i += n - 1;
+				}
+				continue;
+			}
+			switch (c) {
+			case '"':
+				out.write("\\\"");
+				break;
+			case '\\':
+				out.write("\\\\");
+				break;
+			case '\n':
+				out.write("\\n");
+				break;
+			case '\t':
+				out.write("\\t");
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					out.write("\\u00").put(hex[c >> 4]).put(hex[c & 0xf]);
+				else
+					out.put(c);
+			}
+		}
+		out.put('"');
+	}
+
+	/*
+	 * Classic listing: every source line followed by its tokens and errors.
+	 * Console diagnostics with a caret under the offending column go to diag.
+	 */
+	template<typename lexer_t>
+	void write_listing(const lexer_t &lex, const char *title, output_buffer &out, std::ostream &diag)
+	{
+		// Tokens and errors are grouped by the source line they were detected on
+		out.write(title).put('\n');
+		std::string_view src = lex.get_source();
+		auto tokens = lex.get_results();
+		auto &errors = lex.get_errors();
+		std::size_t count = 0, tok = 0, err = 0;
+		for (std::size_t begin = 0; begin < src.size();) {
+			std::size_t end = src.find('\n', begin);
+			// The last line is terminated by the end of input
+			std::size_t limit = end == std::string_view::npos ? src.size() + 1 : end + 1;
+			end = std::min(limit, src.size());
+			std::string_view line = src.substr(begin, end - begin);
+			bool terminated = !line.empty() && line.back() == '\n';
+			++count;
+			out.put('\t').write_int(count).write(": ").write(line);
+			if (!terminated)
+				out.put('\n');
+			for (;;) {
+				if (err < errors.size() && errors[err].index <= tok && errors[err].offset < limit) {
+					auto &e = errors[err++];
+					out.write("\t\t").write_int(count).write(": ERROR: ").write(e.text).put('\n');
+					std::string echo(line);
+					if (!terminated)
+						echo += '\n';
+					for (char &ch : echo) if (ch == '\t') ch = ' ';
+					diag << "In line " << e.line + 1 << ": " << lexer_t::get_error(e.type) << '\n';
+					diag << echo << std::string(e.pos > 0 ? e.pos - 1 : 0, ' ') << "^" << '\n' << '\n';
+				}
+				else if (tok < tokens.size() && tokens[tok].offset < limit) {
+					auto t = lex.view(tokens[tok++]);
+					out.write("\t\t").write_int(count).write(": ").write(t.get_label());
+					if (t.has_symbol())
+						out.write(t.get_id());
+					out.put('\n');
+				}
+				else
+					break;
+			}
+			begin = end;
+		}
+		out.put('\t').write_int(++count).write(": EOF");
+	}
+
+	/*
+	 * One JSON object per line for tools, errors are placed before the token they precede:
+	 * {"type":"identifier","text":"x","line":1,"pos":1,"offset":0,"length":1}
+	 * {"error":"...","text":"$","line":1,"pos":2,"offset":1}
+	 * Lines are 1-based, pos is the column of the last character as in the listing.
+	 */
+	template<typename lexer_t>
+	void write_json(const lexer_t &lex, output_buffer &out)
+	{
+		static constexpr std::string_view type_name[] = {"null", "action", "signal", "literal", "identifier"};
+		auto tokens = lex.get_results();
+		auto &errors = lex.get_errors();
+		std::size_t err = 0;
+		for (std::size_t tok = 0; tok <= tokens.size(); ++tok) {
+			for (; err < errors.size() && errors[err].index <= tok; ++err) {
+				auto &e = errors[err];
+				out.write("{\"error\":");
+				write_json_string(out, lexer_t::get_error(e.type));
+				out.write(",\"text\":");
+				write_json_string(out, e.text);
+				out.write(",\"line\":").write_int(e.line + 1).write(",\"pos\":").write_int(e.pos).write(",\"offset\":").write_int(e.offset).write("}\n");
+			}
+			if (tok == tokens.size())
+				break;
+			auto t = lex.view(tokens[tok]);
+			out.write("{\"type\":\"").write(type_name[static_cast<std::size_t>(t.get_type()) % std::size(type_name)]).write("\",\"text\":");
+			write_json_string(out, t.get_text());
+			out.write(",\"line\":").write_int(t.get_line() + 1).write(",\"pos\":").write_int(t.get_pos()).write(",\"offset\":").write_int(t.get_offset()).write(",\"length\":").write_int(t.get_length()).write("}\n");
+		}
+	}
+
+	/*
+	 * Compact binary token stream, all integers are little-endian u32 unless noted:
+	 *   "CTOK", version, token count, error count, symbol count
+	 *   symbols: length, bytes
+	 *   tokens:  type (u8), subtype (u8), symbol, offset, length, line, pos
+	 *   errors:  type (u8), line, pos, offset, index, text length, text bytes
+	 */
+	template<typename lexer_t>
+	void write_binary(const lexer_t &lex, output_buffer &out)
+	{
+		auto tokens = lex.get_results();
+		auto &errors = lex.get_errors();
+		auto &symbols = lex.get_symbols();
+		out.write("CTOK").write_u32(1).write_u32(tokens.size()).write_u32(errors.size()).write_u32(symbols.size());
+		for (std::uint32_t i = 0; i < symbols.size(); ++i) {
+			std::string_view sym = symbols.get(i);
+			out.write_u32(sym.size()).write(sym);
+		}
+		for (auto &t : tokens)
+			out.write_u8(static_cast<std::uint8_t>(t.type)).write_u8(t.subtype).write_u32(t.symbol).write_u32(t.offset).write_u32(t.length).write_u32(lex.view(t).get_line()).write_u32(lex.view(t).get_pos());
+		for (auto &e : errors)
+			out.write_u8(static_cast<std::uint8_t>(e.type)).write_u32(e.line).write_u32(e.pos).write_u32(e.offset).write_u32(e.index).write_u32(e.text.size()).write(e.text);
+	}
+}
\ No newline at end of file
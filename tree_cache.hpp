@@ -0,0 +1,262 @@
+#pragma once
+
+#include "parsergen.hpp"
+#include "token_cache.hpp"
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace parsergen {
+	// Hash of everything a parse depends on besides the source, rules are written out with their lengths
+	inline std::uint64_t grammar_hash(const lexical_rules &lex, const syntax_rules &stx)
+	{
+		std::string data;
+		auto put = [&data](std::string_view s) {
+			std::uint32_t n = s.size();
+			data.append(reinterpret_cast<const char *>(&n), sizeof(n)).append(s);
+		};
+		auto put_sequence = [&put](const syntax_sequence &seq, auto &self) -> void {
+			put(std::to_string(seq.size()));
+			for (auto &it : seq) {
+				put(std::string(1, static_cast<char>(it.type)));
+				put(it.data);
+				self(it.items, self);
+				put(std::to_string(it.alternatives.size()));
+				for (auto &alt : it.alternatives)
+					self(alt, self);
+			}
+		};
+		put(std::to_string(lex.size()));
+		for (auto &it : lex) {
+			put(it.name);
+			put(it.regex);
+		}
+		// syntax_rules is ordered by name
+		put(std::to_string(stx.size()));
+		for (auto &it : stx) {
+			put(it.first);
+			put_sequence(it.second, put_sequence);
+		}
+		return cov::hash_content(data);
+	}
+
+	/*
+	 * Parse tree cache file, in native byte order since it never leaves the machine:
+	 *   header
+	 *   tokens    token_count raw token records, 8-byte aligned, used in place
+	 *   trees     tree_count raw syntax_tree records, only those reachable from the root, which comes first
+	 *   children  child_count u32 nodes, trees have parser::tree_bit set
+	 *   errors    cursor, line, column, text length as u32, then the text, padded to 4 bytes
+	 * The file is named after key, the hash of the source seeded with the grammar hash,
+	 * and is only valid for that grammar and the exact source (size and key).
+	 */
+	struct tree_cache_header {
+		char magic[8];
+		std::uint32_t version, endian;
+		std::uint32_t token_size, tree_size;
+		std::uint32_t token_count, tree_count, child_count, error_count;
+		// Whether the source parsed up to the end of input, there are no trees otherwise
+		std::uint32_t accepted, reserved;
+		std::uint64_t grammar_hash, source_size, key;
+		std::uint64_t tokens_offset, trees_offset, children_offset, errors_offset, file_size;
+	};
+
+	constexpr char tree_cache_magic[8] = {'C', 'O', 'V', 'P', 'T', 'C', 0, 0};
+	constexpr std::uint32_t tree_cache_version = 1, tree_cache_endian = 0x01020304;
+
+	inline std::uint64_t tree_cache_key(std::uint64_t grammar, std::string_view source) noexcept
+	{
+		return cov::hash_content(source, grammar);
+	}
+
+	// Read-only mapping of a validated cache file
+	class tree_cache final {
+		cov::mapped_file _file;
+		const tree_cache_header *_head = nullptr;
+		const char *at(std::uint64_t offset) const noexcept
+		{
+			return _file.data() + offset;
+		}
+		bool fail() noexcept
+		{
+			close();
+			return false;
+		}
+		/*
+		 * Every node has to stay inside the arrays and name a rule of the grammar, a damaged file must not send
+		 * print_ast astray. Trees are written breadth first, so a tree only has children after it and there are no cycles.
+		 */
+		bool check_nodes(std::size_t rule_count) const noexcept
+		{
+			auto toks = tokens();
+			auto nodes = trees();
+			auto kids = children();
+			for (auto &t : toks) {
+				if (std::uint64_t(t.offset) + t.length > _head->source_size)
+					return false;
+			}
+			for (std::size_t i = 0; i < nodes.size(); ++i) {
+				auto &t = nodes[i];
+				if (t.rule >= rule_count || std::uint64_t(t.first) + t.count > kids.size())
+					return false;
+				for (std::uint32_t k = t.first; k < t.first + t.count; ++k) {
+					std::uint32_t node = kids[k];
+					if (node & parser::tree_bit ? (node & ~parser::tree_bit) <= i || (node & ~parser::tree_bit) >= nodes.size() : node >= toks.size())
+						return false;
+				}
+			}
+			return true;
+		}
+	public:
+		tree_cache() = default;
+		tree_cache(const tree_cache &) = delete;
+		tree_cache &operator=(const tree_cache &) = delete;
+		// Fails unless the file exists and matches this grammar, of rule_count rules, and this exact source
+		bool open(const std::string &path, std::uint64_t grammar, std::string_view source, std::size_t rule_count)
+		{
+			close();
+			if (!_file.open(path) || _file.size() < sizeof(tree_cache_header))
+				return fail();
+			auto head = reinterpret_cast<const tree_cache_header *>(_file.data());
+			if (std::memcmp(head->magic, tree_cache_magic, 8) != 0 || head->version != tree_cache_version || head->endian != tree_cache_endian)
+				return fail();
+			if (head->token_size != sizeof(token) || head->tree_size != sizeof(parser::syntax_tree) || head->grammar_hash != grammar)
+				return fail();
+			if (head->file_size != _file.size() || head->tokens_offset % 8 != 0 || head->trees_offset % 4 != 0
+			        || head->tokens_offset + std::uint64_t(head->token_count) * sizeof(token) > head->trees_offset
+			        || head->trees_offset + std::uint64_t(head->tree_count) * sizeof(parser::syntax_tree) > head->children_offset
+			        || head->children_offset + std::uint64_t(head->child_count) * 4 > head->errors_offset || head->errors_offset > head->file_size)
+				return fail();
+			if (head->source_size != source.size() || head->key != tree_cache_key(grammar, source))
+				return fail();
+			_head = head;
+			return check_nodes(rule_count) || fail();
+		}
+		void close() noexcept
+		{
+			_file.close();
+			_head = nullptr;
+		}
+		inline bool is_open() const noexcept
+		{
+			return _head != nullptr;
+		}
+		inline const tree_cache_header &header() const noexcept
+		{
+			return *_head;
+		}
+		cov::span<const token> tokens() const noexcept
+		{
+			return cov::span<const token>(reinterpret_cast<const token *>(at(_head->tokens_offset)), _head->token_count);
+		}
+		cov::span<const parser::syntax_tree> trees() const noexcept
+		{
+			return cov::span<const parser::syntax_tree>(reinterpret_cast<const parser::syntax_tree *>(at(_head->trees_offset)), _head->tree_count);
+		}
+		cov::span<const std::uint32_t> children() const noexcept
+		{
+			return cov::span<const std::uint32_t>(reinterpret_cast<const std::uint32_t *>(at(_head->children_offset)), _head->child_count);
+		}
+		// The tree in place over source, which has to be the source the cache was opened with
+		parse_tree result(std::string_view source) const noexcept
+		{
+			parse_tree t;
+			t.source = source;
+			t.tokens = tokens();
+			t.trees = trees();
+			t.children = children();
+			t.root = 0;
+			return t;
+		}
+		// Call f(cursor, line, column, text) for every error, false if the section is damaged
+		template<typename F>
+		bool for_each_error(F &&f) const
+		{
+			std::uint64_t p = _head->errors_offset;
+			for (std::uint32_t i = 0; i < _head->error_count; ++i) {
+				std::uint32_t e[4];
+				if (p + sizeof(e) > _head->file_size)
+					return false;
+				std::memcpy(e, at(p), sizeof(e));
+				p += sizeof(e);
+				if (p + e[3] > _head->file_size)
+					return false;
+				f(e[0], e[1], static_cast<std::int32_t>(e[2]), std::string_view(at(p), e[3]));
+				p += (e[3] + 3) / 4 * 4;
+			}
+			return true;
+		}
+	};
+
+	/*
+	 * Write a cache file for source through a temporary file, so that readers never see a partial cache.
+	 * The trees reachable from the root are renumbered breadth first, so the trees left over from
+	 * failed alternatives do not take any room and the root is tree 0.
+	 */
+	inline bool write_tree_cache(const std::string &path, std::uint64_t grammar, std::string_view source, const parse_tree &tree,
+	                             bool accepted, const std::vector<parse_error> &errors)
+	{
+		auto raw = [](const void *p, std::size_t n) {
+			return std::string_view(static_cast<const char *>(p), n);
+		};
+		std::vector<parser::syntax_tree> trees;
+		std::vector<std::uint32_t> children, order;
+		if (accepted && !tree.empty()) {
+			order.push_back(tree.root);
+			for (std::size_t i = 0; i < order.size(); ++i) {
+				const parser::syntax_tree &t = tree.trees[order[i]];
+				trees.push_back({t.rule, static_cast<std::uint32_t>(children.size()), t.count});
+				for (std::uint32_t c = t.first; c < t.first + t.count; ++c) {
+					std::uint32_t node = tree.children[c];
+					if (node & parser::tree_bit) {
+						children.push_back(order.size() | parser::tree_bit);
+						order.push_back(node & ~parser::tree_bit);
+					}
+					else
+						children.push_back(node);
+				}
+			}
+		}
+		tree_cache_header head{};
+		std::memcpy(head.magic, tree_cache_magic, 8);
+		head.version = tree_cache_version;
+		head.endian = tree_cache_endian;
+		head.token_size = sizeof(token);
+		head.tree_size = sizeof(parser::syntax_tree);
+		head.token_count = tree.tokens.size();
+		head.tree_count = trees.size();
+		head.child_count = children.size();
+		head.error_count = errors.size();
+		head.accepted = accepted;
+		head.grammar_hash = grammar;
+		head.source_size = source.size();
+		head.key = tree_cache_key(grammar, source);
+		head.tokens_offset = (sizeof(head) + 7) / 8 * 8;
+		head.trees_offset = head.tokens_offset + tree.tokens.size() * sizeof(token);
+		head.children_offset = head.trees_offset + trees.size() * sizeof(parser::syntax_tree);
+		head.errors_offset = head.children_offset + children.size() * 4;
+		head.file_size = head.errors_offset;
+		for (auto &e : errors)
+			head.file_size += 16 + (e.text.size() + 3) / 4 * 4;
+		std::string tmp = path + ".tmp";
+		cov::output_buffer out;
+		if (!out.open(tmp))
+			return false;
+		out.write(raw(&head, sizeof(head))).write(std::string_view("\0\0\0\0\0\0\0\0", head.tokens_offset - sizeof(head)));
+		out.write(raw(tree.tokens.data(), tree.tokens.size() * sizeof(token)));
+		out.write(raw(trees.data(), trees.size() * sizeof(parser::syntax_tree)));
+		out.write(raw(children.data(), children.size() * 4));
+		for (auto &e : errors) {
+			std::uint32_t rec[4] = {e.cursor, e.line, static_cast<std::uint32_t>(e.column), static_cast<std::uint32_t>(e.text.size())};
+			out.write(raw(rec, sizeof(rec))).write(e.text).write(std::string_view("\0\0\0", (4 - e.text.size() % 4) % 4));
+		}
+		if (!out.close()) {
+			std::remove(tmp.c_str());
+			return false;
+		}
+		return std::rename(tmp.c_str(), path.c_str()) == 0;
+	}
+}
\ No newline at end of file